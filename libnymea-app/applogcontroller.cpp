@@ -35,12 +35,302 @@
 #include <QSettings>
 #include <QGuiApplication>
 #include <QDir>
-#include <QMutexLocker>
+#include <QThread>
+#include <QSemaphore>
+#include <QElapsedTimer>
 
 #include "logging.h"
 
 QtMessageHandler AppLogController::s_oldLogMessageHandler = nullptr;
 
+// Bounded multi-producer queue after Dmitry Vyukov's design. Producers never block or lock,
+// if the consumer falls behind, push() fails and the message is counted as dropped.
+template <typename T>
+class LogRingBuffer
+{
+public:
+    explicit LogRingBuffer(size_t capacity): m_mask(capacity - 1), m_cells(new Cell[capacity])
+    {
+        Q_ASSERT((capacity & m_mask) == 0);
+        for (size_t i = 0; i < capacity; i++) {
+            m_cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+    ~LogRingBuffer() { delete[] m_cells; }
+
+    bool push(T &&value)
+    {
+        size_t pos = m_enqueuePos.load(std::memory_order_relaxed);
+        Cell *cell;
+        forever {
+            cell = &m_cells[pos & m_mask];
+            size_t seq = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+            if (diff == 0) {
+                if (m_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = m_enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+        cell->value = std::move(value);
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Single consumer only
+    bool isEmpty() const
+    {
+        return m_cells[m_dequeuePos & m_mask].sequence.load(std::memory_order_acquire) != m_dequeuePos + 1;
+    }
+
+    // Single consumer only
+    bool pop(T &value)
+    {
+        Cell *cell = &m_cells[m_dequeuePos & m_mask];
+        if (cell->sequence.load(std::memory_order_acquire) != m_dequeuePos + 1) {
+            return false;
+        }
+        value = std::move(cell->value);
+        cell->sequence.store(m_dequeuePos + m_mask + 1, std::memory_order_release);
+        m_dequeuePos++;
+        return true;
+    }
+
+private:
+    struct Cell {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+    const size_t m_mask;
+    Cell *m_cells;
+    std::atomic<size_t> m_enqueuePos{0};
+    size_t m_dequeuePos = 0;
+};
+
+struct LogEntry {
+    qint64 timestamp;
+    AppLogController::LogLevel level;
+    QString category;
+    QString message;
+};
+
+// Formats and writes queued messages on its own thread, in batches. Flushes periodically
+// and rotates the log file by size, compressing old segments.
+class LogWriter: public QThread
+{
+public:
+    LogWriter(AppLogController *controller, const QString &fileName):
+        QThread(controller), m_controller(controller), m_fileName(fileName), m_queue(8192) {}
+
+    bool push(LogEntry &&entry) {
+        if (!m_queue.push(std::move(entry))) {
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        // Only the first message after the writer went idle pays for waking it up
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (m_sleeping.exchange(false)) {
+            m_wakeup.release();
+        }
+        return true;
+    }
+    int dropped() const { return m_dropped.load(std::memory_order_relaxed); }
+
+    void setFileEnabled(bool enabled) {
+        m_fileEnabled.store(enabled);
+        m_wakeup.release();
+    }
+
+    // Blocks until everything queued so far is on disk (or a second passed)
+    void flush() {
+        if (!isRunning()) {
+            return;
+        }
+        // Forget about earlier flushes that timed out
+        m_flushed.tryAcquire(m_flushed.available());
+        m_flushRequested.store(true);
+        m_wakeup.release();
+        m_flushed.tryAcquire(1, 1000);
+    }
+
+    void stop() {
+        m_stop.store(true);
+        m_wakeup.release();
+        wait();
+    }
+
+protected:
+    void run() override;
+
+private:
+    int drain();
+    void openFile();
+    void rotate();
+
+    static QByteArray levelTag(AppLogController::LogLevel level) {
+        switch (level) {
+        case AppLogController::LogLevelDebug:
+            return "D";
+        case AppLogController::LogLevelInfo:
+            return "I";
+        case AppLogController::LogLevelWarning:
+            return "W";
+        default:
+            return "C";
+        }
+    }
+
+    AppLogController *m_controller = nullptr;
+    QString m_fileName;
+    QFile m_file;
+    LogRingBuffer<LogEntry> m_queue;
+
+    std::atomic<int> m_dropped{0};
+    int m_reportedDrops = 0;
+    std::atomic<bool> m_fileEnabled{false};
+    std::atomic<bool> m_flushRequested{false};
+    std::atomic<bool> m_stop{false};
+    QSemaphore m_flushed;
+    // The writer blocks on this while there is nothing to do, instead of polling
+    std::atomic<bool> m_sleeping{false};
+    QSemaphore m_wakeup;
+    // Written but not flushed yet
+    bool m_dirty = false;
+};
+
+static const qint64 maxLogFileSize = 4 * 1024 * 1024;
+static const int keptLogSegments = 5;
+static const int flushInterval = 1000;
+
+void LogWriter::run()
+{
+    QElapsedTimer flushTimer;
+    flushTimer.start();
+    while (!m_stop.load()) {
+        if (m_fileEnabled.load() != m_file.isOpen()) {
+            if (m_file.isOpen()) {
+                m_file.close();
+            } else {
+                openFile();
+            }
+        }
+
+        bool idle = drain() == 0;
+
+        if (m_flushRequested.exchange(false)) {
+            // The batch above may have been taken before the last messages were queued, and is bounded anyways
+            while (drain() > 0) { }
+            m_file.flush();
+            m_dirty = false;
+            flushTimer.restart();
+            m_flushed.release();
+        } else if (m_dirty && flushTimer.elapsed() >= flushInterval) {
+            m_file.flush();
+            m_dirty = false;
+            flushTimer.restart();
+        }
+
+        if (m_file.isOpen() && m_file.size() > maxLogFileSize) {
+            m_file.close();
+            openFile();
+        }
+
+        if (idle) {
+            // Sleep until a message comes in. Wake up for the periodic flush only if something is pending.
+            m_sleeping.store(true);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (m_queue.isEmpty()) {
+                if (m_dirty) {
+                    m_wakeup.tryAcquire(1, static_cast<int>(qMax<qint64>(1, flushInterval - flushTimer.elapsed())));
+                } else {
+                    m_wakeup.acquire();
+                }
+            }
+            m_sleeping.store(false);
+        }
+    }
+    drain();
+    m_file.close();
+}
+
+int LogWriter::drain()
+{
+    QByteArray batch;
+    LogEntry entry;
+    int count = 0;
+    // Bound the batch so messageAdded() and the file don't lag behind too much under load
+    while (count < 512 && m_queue.pop(entry)) {
+        count++;
+        QDateTime timestamp = QDateTime::fromMSecsSinceEpoch(entry.timestamp);
+        if (m_file.isOpen()) {
+            batch.append(timestamp.toString("yyyy-MM-dd hh:mm:ss.zzz").toUtf8());
+            batch.append(':');
+            batch.append(levelTag(entry.level));
+            batch.append(':');
+            batch.append(entry.category.toUtf8());
+            batch.append(": ");
+            batch.append(entry.message.toUtf8());
+            batch.append('\n');
+        }
+        emit m_controller->messageAdded(timestamp, entry.category, entry.message, entry.level);
+    }
+
+    int dropped = m_dropped.load(std::memory_order_relaxed);
+    if (dropped != m_reportedDrops && m_file.isOpen()) {
+        batch.append(QDateTime::currentDateTime().toString("yyyy-MM-dd hh:mm:ss.zzz").toUtf8());
+        batch.append(":W:AppLog: " + QByteArray::number(dropped - m_reportedDrops) + " log messages dropped\n");
+        m_reportedDrops = dropped;
+    }
+
+    if (!batch.isEmpty()) {
+        m_file.write(batch);
+        m_dirty = true;
+    }
+    return count;
+}
+
+void LogWriter::openFile()
+{
+    rotate();
+    m_file.setFileName(m_fileName);
+    if (!m_file.open(QFile::ReadWrite | QFile::Truncate)) {
+        qWarning() << "Cannot open logfile for writing.";
+    }
+}
+
+void LogWriter::rotate()
+{
+    // Older versions kept previous logs uncompressed
+    for (int i = 1; i <= keptLogSegments; i++) {
+        QFile legacy(m_fileName + "." + QString::number(i));
+        if (legacy.exists() && legacy.open(QFile::ReadOnly)) {
+            QFile compressed(legacy.fileName() + ".z");
+            if (compressed.open(QFile::WriteOnly | QFile::Truncate)) {
+                compressed.write(qCompress(legacy.readAll()));
+            }
+            legacy.remove();
+        }
+    }
+
+    QFile::remove(m_fileName + "." + QString::number(keptLogSegments) + ".z");
+    for (int i = keptLogSegments - 1; i > 0; i--) {
+        QFile::rename(m_fileName + "." + QString::number(i) + ".z", m_fileName + "." + QString::number(i + 1) + ".z");
+    }
+
+    QFile current(m_fileName);
+    if (current.exists() && current.open(QFile::ReadOnly)) {
+        QFile compressed(m_fileName + ".1.z");
+        if (compressed.open(QFile::WriteOnly | QFile::Truncate)) {
+            compressed.write(qCompress(current.readAll()));
+        }
+        current.remove();
+    }
+}
+
 
 AppLogController::LogLevel AppLogController::qtMsgTypeToLogLevel(QtMsgType msgType)
 {
@@ -96,14 +386,20 @@ AppLogController::AppLogController(QObject *parent) : QObject(parent)
         m_logLevels[category] = static_cast<LogLevel>(settings.value(category, LogLevelInfo).toInt());
     }
     settings.endGroup();
+    m_handlerLogLevels.store(nullptr);
     updateFilters();
 
+    QDir().mkpath(logPath());
+    m_writer = new LogWriter(this, currentLogFile());
+    m_writer->setFileEnabled(enabled());
+    m_writer->start(QThread::LowPriority);
+    qAddPostRoutine([](){
+        // Get the last messages on disk before the process goes away
+        instance()->m_writer->stop();
+    });
+
     // Finally, install the logMessageHandler
     s_oldLogMessageHandler = qInstallMessageHandler(&logMessageHandler);
-
-    if (enabled()) {
-        openLogFile();
-    }
 }
 
 bool AppLogController::enabled() const
@@ -118,11 +414,7 @@ void AppLogController::setEnabled(bool enabled)
         return;
     }
 
-    if (enabled) {
-        openLogFile();
-    } else {
-        m_logFile.close();
-    }
+    m_writer->setFileEnabled(enabled);
     QSettings settings;
     settings.setValue("AppLoggingEnabled", enabled);
     emit enabledChanged();
@@ -172,11 +464,14 @@ QStringList AppLogController::logFiles() const
     return files;
 }
 
+void AppLogController::flush()
+{
+    m_writer->flush();
+}
+
 QString AppLogController::exportLogs()
 {
-    if (m_logFile.isOpen()) {
-        m_logFile.flush();
-    }
+    flush();
     QFile f(logPath() + "/" + QGuiApplication::applicationName() + "-logs.txt");
     if (!f.open(QFile::WriteOnly)) {
         return QString();
@@ -189,43 +484,47 @@ QString AppLogController::exportLogs()
         l.seek(0);
         f.write("\n******** App start ********\n");
         f.write(logFile.toUtf8() + "\n");
-        f.write(l.readAll());
+        if (logFile.endsWith(".z")) {
+            f.write(qUncompress(l.readAll()));
+        } else {
+            f.write(l.readAll());
+        }
     }
     f.close();
     return f.fileName();
 }
 
-void AppLogController::logMessageHandler(QtMsgType type, const QMessageLogContext &context, const QString &message)
+int AppLogController::droppedMessages() const
 {
-    s_oldLogMessageHandler(type, context, message);
-    QMetaObject::invokeMethod(instance(), "append", Q_ARG(QString, context.category), Q_ARG(QString, message), Q_ARG(AppLogController::LogLevel, qtMsgTypeToLogLevel(type)));
+    return m_writer->dropped();
 }
 
-void AppLogController::append(const QString &category, const QString &message, LogLevel level)
+void AppLogController::logMessageHandler(QtMsgType type, const QMessageLogContext &context, const QString &message)
 {
-    if (m_logLevels.value(category) < level) {
-        return;
-    }
-
-    QDateTime timestamp = QDateTime::currentDateTime();
+    s_oldLogMessageHandler(type, context, message);
 
-    if (m_logFile.isOpen()) {
-        QHash<LogLevel, QString> t = {
-            {LogLevelDebug, "D"},
-            {LogLevelInfo, "I"},
-            {LogLevelWarning, "W"},
-            {LogLevelCritical, "C"}
-        };
-        QString line = QString("%0:%1:%2: %3\n").arg(timestamp.toString("yyyy-MM-dd hh:mm:ss.zzz"), t.value(level), category, message);
-        m_logFile.write(line.toUtf8());
-        m_logFile.flush();
+    // Called from any thread. Filter before doing anything else, then hand off without locking.
+    AppLogController *controller = instance();
+    LogLevel level = qtMsgTypeToLogLevel(type);
+    const char *category = context.category ? context.category : "";
+    const QHash<QByteArray, LogLevel> *levels = controller->m_handlerLogLevels.load(std::memory_order_acquire);
+    if (levels->value(QByteArray::fromRawData(category, static_cast<int>(qstrlen(category))), LogLevelCritical) < level) {
+        return;
     }
-
-    emit messageAdded(timestamp, category, message, level);
+    controller->m_writer->push({QDateTime::currentMSecsSinceEpoch(), level, QString::fromLatin1(category), message});
 }
 
 void AppLogController::updateFilters()
 {
+    QHash<QByteArray, LogLevel> *handlerLogLevels = new QHash<QByteArray, LogLevel>();
+    foreach (const QString &category, m_logLevels.keys()) {
+        handlerLogLevels->insert(category.toLatin1(), m_logLevels.value(category));
+    }
+    const QHash<QByteArray, LogLevel> *old = m_handlerLogLevels.exchange(handlerLogLevels, std::memory_order_acq_rel);
+    if (old) {
+        m_retiredLogLevels.append(const_cast<QHash<QByteArray, LogLevel>*>(old));
+    }
+
     QStringList loggingRules = {"*.warn=false", "*.info=false", "*.debug=false"};
 
     // Load the rules from nymead.conf file and append them to the rules
@@ -240,37 +539,11 @@ void AppLogController::updateFilters()
     QLoggingCategory::setFilterRules(loggingRules.join('\n'));
 }
 
-void AppLogController::openLogFile()
-{
-    // Make sure log dir exists
-    if (!QDir().mkpath(logPath())) {
-        qWarning() << "Cannot create cache location. Logging will not work.";
-    }
-
-    // Rotate old log files, keeping the last 5
-    for (int i = 4; i > 0; i--) {
-        if (QFile::exists(currentLogFile() + "." + QString::number(i))) {
-            if (QFile::exists(currentLogFile() + "." + QString::number(i + 1))) {
-                QFile::remove(currentLogFile() + "." + QString::number(i + 1));
-            }
-            QFile::rename(currentLogFile() + "." + QString::number(i), currentLogFile() + "." + QString::number(i + 1));
-        }
-    }
-    if (QFile::exists(currentLogFile())) {
-        QFile::rename(currentLogFile(), currentLogFile() + ".1");
-    }
-
-    m_logFile.setFileName(currentLogFile());
-    if (!m_logFile.open(QFile::ReadWrite | QFile::Truncate)) {
-        qWarning() << "Cannot open logfile for writing.";
-    } else {
-        qDebug() << "App log opened at" << m_logFile.fileName();
-    }
-}
-
 LogMessages::LogMessages(QObject *parent):
     QAbstractListModel(parent)
 {
+    // The writer lags behind by up to a second, get everything logged so far into the file
+    AppLogController::instance()->flush();
     QFile f(AppLogController::instance()->currentLogFile());
     if (!f.open(QFile::ReadOnly)) {
         return;
@@ -35,11 +35,13 @@
 #include <QFile>
 #include <QQmlEngine>
 #include <QAbstractListModel>
-#include <QMutex>
 #include <QDateTime>
 
+#include <atomic>
+
 class LogMessages;
 class LoggingCategories;
+class LogWriter;
 
 class AppLogController : public QObject
 {
@@ -76,6 +78,12 @@ public:
 
     Q_INVOKABLE QString exportLogs();
 
+    // Blocks until everything logged so far is written to the current log file
+    void flush();
+
+    // Messages lost because the writer could not keep up
+    Q_INVOKABLE int droppedMessages() const;
+
 signals:
     void enabledChanged();
     void logToModelChanged();
@@ -89,15 +97,15 @@ private:
     static QtMessageHandler s_oldLogMessageHandler;
     static void logMessageHandler(QtMsgType type, const QMessageLogContext &context, const QString &message);
 
-    Q_INVOKABLE void append(const QString &category, const QString &message, AppLogController::LogLevel level);
-
     void updateFilters();
-    void openLogFile();
 
     QHash<QString, LogLevel> m_logLevels;
+    // Read by the message handler from any thread. Replaced as a whole when a level changes,
+    // old copies are kept around as a handler might still be looking at one.
+    std::atomic<const QHash<QByteArray, LogLevel>*> m_handlerLogLevels;
+    QList<QHash<QByteArray, LogLevel>*> m_retiredLogLevels;
 
-    QMutex m_mutex;
-    QFile m_logFile;
+    LogWriter *m_writer = nullptr;
     LoggingCategories *m_loggingCategories = nullptr;
 };
 Q_DECLARE_METATYPE(AppLogController::LogLevel)
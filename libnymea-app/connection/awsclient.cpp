@@ -40,6 +40,8 @@
 #include <QTimer>
 #include <QPointer>
 
+#include <limits>
+
 #include "sigv4utils.h"
 #include "logging.h"
 #include "config.h"
@@ -48,6 +50,13 @@ AWSClient* AWSClient::s_instance = nullptr;
 
 NYMEA_LOGGING_CATEGORY(dcCloud, "Cloud")
 
+// Tokens are considered expired this many seconds before they actually expire
+static const int tokenExpiryMargin = 10;
+// Refresh tokens this long before they are considered expired so calls don't have to wait for Cognito
+static const int tokenRefreshMargin = 300;
+// Don't retry refreshing more often than this if the tokens we get are expired already
+static const int minimumRefreshInterval = 10000;
+
 // This is Symantec's root CA certificate and most platforms should
 // have this in their certificate storage already, but as we can't
 // be certain about the core's setup, let's deploy it ourselves.
@@ -153,6 +162,18 @@ AWSClient::AWSClient(QObject *parent) : QObject(parent),
     m_secretKey = settings.value("secretKey").toByteArray();
     m_sessionToken = settings.value("sessionToken").toByteArray();
     m_sessionTokenExpiry = settings.value("sessionTokenExpiry").toDateTime();
+    settings.endGroup();
+
+    m_endpointOverride = QUrl(QString::fromUtf8(qgetenv("NYMEA_AWS_ENDPOINT")));
+
+    m_refreshTimer.setSingleShot(true);
+    connect(&m_refreshTimer, &QTimer::timeout, this, [this](){
+        if (!isLoggedIn() || m_loginInProgress) {
+            return;
+        }
+        qCInfo(dcCloud()) << "Refreshing tokens ahead of their expiry";
+        refreshAccessToken();
+    });
 }
 
 AWSClient *AWSClient::instance()
@@ -215,7 +236,7 @@ bool AWSClient::login(const QString &username, const QString &password)
     query.addQueryItem("Version", "2016-04-18");
     url.setQuery(query);
 
-    QNetworkRequest request(url);
+    QNetworkRequest request = createRequest(url);
     request.setHeader(QNetworkRequest::ContentTypeHeader, "application/x-amz-json-1.0");
     request.setRawHeader("Host", host.toUtf8());
     request.setRawHeader("X-Amz-Target", "AWSCognitoIdentityProviderService.InitiateAuth");
@@ -290,6 +311,9 @@ bool AWSClient::login(const QString &username, const QString &password)
         QJsonDocument tokenPayloadJsonDoc = QJsonDocument::fromJson(QByteArray::fromBase64(jwtParts.at(1)));
         m_userId = tokenPayloadJsonDoc.toVariant().toMap().value("cognito:username").toByteArray();
 
+        // Calls to the API gateway only need the ID token, no need to hold them back until we have the credentials
+        releaseCallQueue(false);
+
 //        qDebug() << "Getting cognito ID";
         getId();
     });
@@ -298,6 +322,7 @@ bool AWSClient::login(const QString &username, const QString &password)
 
 void AWSClient::logout()
 {
+    m_refreshTimer.stop();
     m_userId.clear();
     m_username.clear();
     m_password.clear();
@@ -321,7 +346,7 @@ void AWSClient::signup(const QString &username, const QString &password)
     query.addQueryItem("Version", "2016-04-18");
     url.setQuery(query);
 
-    QNetworkRequest request(url);
+    QNetworkRequest request = createRequest(url);
     request.setHeader(QNetworkRequest::ContentTypeHeader, "application/x-amz-json-1.0");
     request.setRawHeader("Host", host.toUtf8());
     request.setRawHeader("X-Amz-Target", "AWSCognitoIdentityProviderService.SignUp");
@@ -380,7 +405,7 @@ void AWSClient::confirmRegistration(const QString &code)
     query.addQueryItem("Version", "2016-04-18");
     url.setQuery(query);
 
-    QNetworkRequest request(url);
+    QNetworkRequest request = createRequest(url);
     request.setHeader(QNetworkRequest::ContentTypeHeader, "application/x-amz-json-1.0");
     request.setRawHeader("Host", host.toUtf8());
     request.setRawHeader("X-Amz-Target", "AWSCognitoIdentityProviderService.ConfirmSignUp");
@@ -439,7 +464,7 @@ void AWSClient::forgotPassword(const QString &username)
     query.addQueryItem("Version", "2016-04-18");
     url.setQuery(query);
 
-    QNetworkRequest request(url);
+    QNetworkRequest request = createRequest(url);
     request.setHeader(QNetworkRequest::ContentTypeHeader, "application/x-amz-json-1.0");
     request.setRawHeader("Host", host.toUtf8());
     request.setRawHeader("X-Amz-Target", "AWSCognitoIdentityProviderService.ForgotPassword");
@@ -488,7 +513,7 @@ void AWSClient::confirmForgotPassword(const QString &username, const QString &co
     query.addQueryItem("Version", "2016-04-18");
     url.setQuery(query);
 
-    QNetworkRequest request(url);
+    QNetworkRequest request = createRequest(url);
     request.setHeader(QNetworkRequest::ContentTypeHeader, "application/x-amz-json-1.0");
     request.setRawHeader("Host", host.toUtf8());
     request.setRawHeader("X-Amz-Target", "AWSCognitoIdentityProviderService.ConfirmForgotPassword");
@@ -528,7 +553,7 @@ void AWSClient::deleteAccount()
         qCWarning(dcCloud()) << "Not logged in at AWS. Can't delete account";
         return;
     }
-    if (tokensExpired()) {
+    if (idTokenExpired()) {
         qCInfo(dcCloud()) << "Cannot unpair device. Need to refresh our tokens";
         refreshAccessToken();
         QueuedCall::enqueue(m_callQueue, QueuedCall("deleteAccount"));
@@ -537,7 +562,7 @@ void AWSClient::deleteAccount()
     qCInfo(dcCloud()) << "Deleting account";
 
     QUrl url(QString("https://%1/users/profiles/%2").arg(m_configs.value(m_usedConfig).apiEndpoint).arg(m_userId));
-    QNetworkRequest request(url);
+    QNetworkRequest request = createRequest(url);
     request.setHeader(QNetworkRequest::ContentTypeHeader, "application/json");
     request.setRawHeader("x-api-idToken", m_idToken);
 
@@ -575,7 +600,7 @@ void AWSClient::unpairDevice(const QString &coreId)
         qCWarning(dcCloud()) << "Not logged in at AWS. Can't unpair device";
         return;
     }
-    if (tokensExpired()) {
+    if (idTokenExpired()) {
         qCInfo(dcCloud()) << "Cannot unpair device. Need to refresh our tokens";
         refreshAccessToken();
         QueuedCall::enqueue(m_callQueue, QueuedCall("unpairDevice", coreId));
@@ -583,7 +608,7 @@ void AWSClient::unpairDevice(const QString &coreId)
     }
     qCInfo(dcCloud()) << "Unpairing device" << coreId << "from user" << m_username;
     QUrl url(QString("https://%1/users/devices/%2").arg(m_configs.value(m_usedConfig).apiEndpoint).arg(coreId));
-    QNetworkRequest request(url);
+    QNetworkRequest request = createRequest(url);
     request.setHeader(QNetworkRequest::ContentTypeHeader, "application/json");
     request.setRawHeader("x-api-idToken", m_idToken);
 
@@ -619,7 +644,7 @@ void AWSClient::getId()
     query.addQueryItem("Version", "2016-06-30");
     url.setQuery(query);
 
-    QNetworkRequest request(url);
+    QNetworkRequest request = createRequest(url);
     request.setHeader(QNetworkRequest::ContentTypeHeader, "application/x-amz-json-1.0");
     request.setRawHeader("Host", host.toUtf8());
     request.setRawHeader("X-Amz-Target", "AWSCognitoIdentityService.GetId");
@@ -666,7 +691,7 @@ void AWSClient::registerPushNotificationEndpoint(const QString &registrationId,
         qCWarning(dcCloud()) << "Not logged in at AWS. Can't register push endpoint";
         return;
     }
-    if (tokensExpired()) {
+    if (idTokenExpired()) {
         qCInfo(dcCloud()) << "Cannot register push endpoint. Need to refresh our tokens";
         QueuedCall::enqueue(m_callQueue, QueuedCall("registerPushNotificationEndpoint", registrationId, deviceDisplayName, mobileDeviceId, mobileDeviceManufacturer, mobileDeviceModel));
         refreshAccessToken();
@@ -674,7 +699,7 @@ void AWSClient::registerPushNotificationEndpoint(const QString &registrationId,
     }
 
     QUrl url(QString("https://%1/notifications/endpoints/%2").arg(m_configs.value(m_usedConfig).apiEndpoint).arg(m_userId));
-    QNetworkRequest request(url);
+    QNetworkRequest request = createRequest(url);
     request.setHeader(QNetworkRequest::ContentTypeHeader, "application/json");
     request.setRawHeader("x-api-idToken", m_idToken);
 
@@ -730,7 +755,7 @@ void AWSClient::fetchCertificate(const QString &uuid, std::function<void(const Q
 {
     QString fixedUuid = uuid;
     fixedUuid.remove(QRegExp("[{}]"));
-    QNetworkRequest request(m_configs.value(m_usedConfig).certificateEndpoint);
+    QNetworkRequest request = createRequest(QUrl(m_configs.value(m_usedConfig).certificateEndpoint));
     request.setRawHeader("X-api-key", m_configs.value(m_usedConfig).certificateApiKey.toUtf8());
     request.setRawHeader("X-api-vendorId", m_configs.value(m_usedConfig).certificateVendorId.toUtf8());
     request.setRawHeader("X-api-deviceId", fixedUuid.toUtf8());
@@ -789,9 +814,25 @@ void AWSClient::setConfig(const QString &config)
         qCInfo(dcCloud()) << "Setting AWS configuration to" << fixedConfig;
         m_usedConfig = fixedConfig;
         emit configChanged();
+
+        if (isLoggedIn()) {
+            scheduleTokenRefresh();
+            warmUpConnections();
+        }
     }
 }
 
+QUrl AWSClient::endpointOverride() const
+{
+    return m_endpointOverride;
+}
+
+void AWSClient::setEndpointOverride(const QUrl &endpointOverride)
+{
+    qCInfo(dcCloud()) << "Sending AWS requests to" << endpointOverride;
+    m_endpointOverride = endpointOverride;
+}
+
 void AWSClient::getCredentialsForIdentity(const QString &identityId)
 {
     QString host = QString("cognito-identity.%1.amazonaws.com").arg(m_configs.value(m_usedConfig).region);
@@ -802,7 +843,7 @@ void AWSClient::getCredentialsForIdentity(const QString &identityId)
     query.addQueryItem("Version", "2016-06-30");
     url.setQuery(query);
 
-    QNetworkRequest request(url);
+    QNetworkRequest request = createRequest(url);
     request.setHeader(QNetworkRequest::ContentTypeHeader, "application/x-amz-json-1.0");
     request.setRawHeader("Host", host.toUtf8());
     request.setRawHeader("X-Amz-Target", "AWSCognitoIdentityService.GetCredentialsForIdentity");
@@ -877,22 +918,35 @@ void AWSClient::getCredentialsForIdentity(const QString &identityId)
             emit isLoggedInChanged();
         }
 
-        while (!m_callQueue.isEmpty()) {
-            QueuedCall qc = m_callQueue.takeFirst();
-//            qDebug() << "Calling from queue:" << qc.method;
-            if (qc.method == "fetchDevices") {
-                fetchDevices();
-            } else if (qc.method == "postToMQTT") {
-                postToMQTT(qc.arg1, qc.arg2, qc.sender, qc.callback);
-            } else if (qc.method == "deleteAccount") {
-                deleteAccount();
-            } else if (qc.method == "registerPushNotificationEndpoint") {
-                registerPushNotificationEndpoint(qc.arg1, qc.arg2, qc.arg3, qc.arg4, qc.arg5);
-            } else if (qc.method == "unpairDevice") {
-                unpairDevice(qc.arg1);
+        releaseCallQueue(true);
+        scheduleTokenRefresh();
+    });
+}
+
+void AWSClient::releaseCallQueue(bool credentialsReady)
+{
+    // All calls are fired right away, the network access manager runs them in parallel. Anything
+    // that still can't go out queues itself up again, so take the queue before walking it.
+    QList<QueuedCall> calls;
+    calls.swap(m_callQueue);
+    foreach (const QueuedCall &qc, calls) {
+//        qDebug() << "Calling from queue:" << qc.method;
+        if (qc.method == "postToMQTT") {
+            if (!credentialsReady) {
+                m_callQueue.append(qc);
+                continue;
             }
+            postToMQTT(qc.arg1, qc.arg2, qc.sender, qc.callback);
+        } else if (qc.method == "fetchDevices") {
+            fetchDevices();
+        } else if (qc.method == "deleteAccount") {
+            deleteAccount();
+        } else if (qc.method == "registerPushNotificationEndpoint") {
+            registerPushNotificationEndpoint(qc.arg1, qc.arg2, qc.arg3, qc.arg4, qc.arg5);
+        } else if (qc.method == "unpairDevice") {
+            unpairDevice(qc.arg1);
         }
-    });
+    }
 }
 
 void AWSClient::cancelCallQueue()
@@ -910,7 +964,81 @@ void AWSClient::cancelCallQueue()
 
 bool AWSClient::tokensExpired() const
 {
-    return (m_accessTokenExpiry.addSecs(-10) < QDateTime::currentDateTime()) || (m_sessionTokenExpiry.addSecs(-10) < QDateTime::currentDateTime());
+    return idTokenExpired() || (m_sessionTokenExpiry.addSecs(-tokenExpiryMargin) < QDateTime::currentDateTime());
+}
+
+bool AWSClient::idTokenExpired() const
+{
+    return m_accessTokenExpiry.addSecs(-tokenExpiryMargin) < QDateTime::currentDateTime();
+}
+
+void AWSClient::scheduleTokenRefresh()
+{
+    if (!isLoggedIn() || m_usedConfig.isEmpty()) {
+        m_refreshTimer.stop();
+        return;
+    }
+
+    QDateTime expiry = qMin(m_accessTokenExpiry, m_sessionTokenExpiry).addSecs(-tokenExpiryMargin);
+    qint64 remaining = QDateTime::currentDateTime().msecsTo(expiry);
+    qint64 interval;
+    if (remaining <= 0) {
+        interval = minimumRefreshInterval;
+    } else {
+        // Short lived tokens are refreshed once 3/4 of their lifetime have passed
+        interval = qMax(remaining - tokenRefreshMargin * 1000, remaining * 3 / 4);
+    }
+    interval = qMin(interval, static_cast<qint64>(std::numeric_limits<int>::max()));
+    qCDebug(dcCloud()) << "Refreshing tokens in" << interval / 1000 << "seconds";
+    m_refreshTimer.start(static_cast<int>(interval));
+}
+
+void AWSClient::warmUpConnections()
+{
+#ifndef QT_NO_SSL
+    if (!m_endpointOverride.isEmpty()) {
+        return;
+    }
+    // Have the TLS sessions ready by the time the first calls go out. The network access
+    // manager keeps them alive and reuses them for all requests to those hosts.
+    m_nam->connectToHostEncrypted(m_configs.value(m_usedConfig).apiEndpoint);
+    m_nam->connectToHostEncrypted(m_configs.value(m_usedConfig).mqttEndpoint);
+#endif
+}
+
+QUrl AWSClient::endpointUrl(const QUrl &url) const
+{
+    if (m_endpointOverride.isEmpty()) {
+        return url;
+    }
+    QUrl overriddenUrl = url;
+    overriddenUrl.setScheme(m_endpointOverride.scheme());
+    overriddenUrl.setHost(m_endpointOverride.host());
+    overriddenUrl.setPort(m_endpointOverride.port());
+    return overriddenUrl;
+}
+
+QNetworkRequest AWSClient::createRequest(const QUrl &url) const
+{
+    QNetworkRequest request(endpointUrl(url));
+    // Lets parallel calls to the same endpoint share one connection
+    request.setAttribute(QNetworkRequest::Http2AllowedAttribute, true);
+    return request;
+}
+
+bool AWSClient::tokensExpiring(int seconds) const
+{
+    QDateTime deadline = QDateTime::currentDateTime().addSecs(seconds);
+    return m_accessTokenExpiry < deadline || m_sessionTokenExpiry < deadline;
+}
+
+void AWSClient::refreshTokensIfExpiring(int seconds)
+{
+    if (!isLoggedIn() || m_loginInProgress || !tokensExpiring(seconds)) {
+        return;
+    }
+    qCDebug(dcCloud()) << "Tokens expiring within" << seconds << "seconds. Refreshing ahead of time.";
+    refreshAccessToken();
 }
 
 bool AWSClient::postToMQTT(const QString &coreId, const QString &nonce, QPointer<QObject> sender, std::function<void (bool)> callback)
@@ -944,14 +1072,14 @@ bool AWSClient::postToMQTT(const QString &coreId, const QString &nonce, QPointer
     QByteArray payload = QJsonDocument::fromVariant(params).toJson(QJsonDocument::Compact);
 
 
-    QNetworkRequest request("https://" + m_configs.value(m_usedConfig).mqttEndpoint + path);
+    QNetworkRequest request = createRequest(QUrl("https://" + m_configs.value(m_usedConfig).mqttEndpoint + path));
     request.setRawHeader("content-type", "application/json");
     request.setRawHeader("host", m_configs.value(m_usedConfig).mqttEndpoint.toUtf8());
 
     SigV4Utils::signRequest(QNetworkAccessManager::PostOperation, request, m_configs.value(m_usedConfig).region, "iotdata", m_accessKeyId, m_secretKey, m_sessionToken, payload);
 
     // Workaround MQTT broker url weirdness as described above
-    request.setUrl("https://" + m_configs.value(m_usedConfig).mqttEndpoint + path1);
+    request.setUrl(endpointUrl(QUrl("https://" + m_configs.value(m_usedConfig).mqttEndpoint + path1)));
 
     qCInfo(dcCloud) << "Posting to MQTT:" << request.url().toString();
 //    qCDebug(dcCloud) << "HEADERS:";
@@ -1008,7 +1136,7 @@ void AWSClient::fetchDevices()
         qCWarning(dcCloud()) << "Not logged in at AWS. Can't fetch paired devices";
         return;
     }
-    if (tokensExpired()) {
+    if (idTokenExpired()) {
         qCDebug(dcCloud()) << "Cannot fetch devices. Need to refresh our tokens";
         refreshAccessToken();
         QueuedCall::enqueue(m_callQueue, QueuedCall("fetchDevices"));
@@ -1016,7 +1144,7 @@ void AWSClient::fetchDevices()
     }
     QUrl url(QString("https://%1/users/devices").arg(m_configs.value(m_usedConfig).apiEndpoint));
     qCDebug(dcCloud()) << "Fetching cloud devices" << url.toString();
-    QNetworkRequest request(url);
+    QNetworkRequest request = createRequest(url);
     request.setHeader(QNetworkRequest::ContentTypeHeader, "application/json");
     request.setRawHeader("x-api-idToken", m_idToken);
 
@@ -1096,7 +1224,7 @@ bool AWSClient::refreshAccessToken()
     query.addQueryItem("Version", "2016-04-18");
     url.setQuery(query);
 
-    QNetworkRequest request(url);
+    QNetworkRequest request = createRequest(url);
     request.setHeader(QNetworkRequest::ContentTypeHeader, "application/x-amz-json-1.0");
     request.setRawHeader("Host", host.toUtf8());
     request.setRawHeader("X-Amz-Target", "AWSCognitoIdentityProviderService.InitiateAuth");
@@ -36,6 +36,8 @@
 #include <QDate>
 #include <QAbstractListModel>
 #include <QPointer>
+#include <QTimer>
+#include <QUrl>
 
 class QNetworkAccessManager;
 
@@ -158,6 +160,8 @@ public:
 
 
     bool tokensExpired() const;
+    bool tokensExpiring(int seconds) const;
+    void refreshTokensIfExpiring(int seconds);
     QByteArray idToken() const;
     QString cognitoIdentityId() const;
 
@@ -167,6 +171,11 @@ public:
     QString config() const;
     void setConfig(const QString &config);
 
+    // Sends all requests to this scheme, host and port instead, e.g. a local stand-in for testing.
+    // Can also be set with the NYMEA_AWS_ENDPOINT environment variable.
+    QUrl endpointOverride() const;
+    void setEndpointOverride(const QUrl &endpointOverride);
+
 signals:
     void loginResult(LoginError error);
     void signupResult(LoginError error);
@@ -189,6 +198,13 @@ private:
     void getCredentialsForIdentity(const QString &identityId);
     void connectMQTT();
 
+    // The API gateway only needs the ID token, MQTT needs the credentials from the identity pool too
+    bool idTokenExpired() const;
+    void scheduleTokenRefresh();
+    void warmUpConnections();
+    QUrl endpointUrl(const QUrl &url) const;
+    QNetworkRequest createRequest(const QUrl &url) const;
+
 
 private:
     QNetworkAccessManager *m_nam = nullptr;
@@ -242,8 +258,11 @@ private:
         }
     };
     void cancelCallQueue();
+    void releaseCallQueue(bool credentialsReady);
 
     QList<QueuedCall> m_callQueue;
+    QTimer m_refreshTimer;
+    QUrl m_endpointOverride;
 
     QHash<QString, AWSConfiguration> m_configs;
     QString m_usedConfig = "";
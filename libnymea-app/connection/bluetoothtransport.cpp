@@ -34,15 +34,26 @@
 #include <QDebug>
 #include <QUrlQuery>
 
+#include "logging.h"
+
+NYMEA_LOGGING_CATEGORY(dcBluetoothTransport, "BluetoothTransport")
+
+// Messages up to this size are considered interactive commands
+static const int interactiveMessageSize = 2048;
+
 BluetoothTransport::BluetoothTransport(QObject *parent) :
     NymeaTransportInterface(parent)
 {
-    m_socket = new QBluetoothSocket(QBluetoothServiceInfo::RfcommProtocol);
+    m_socket = new QBluetoothSocket(QBluetoothServiceInfo::RfcommProtocol, this);
 
     QObject::connect(m_socket, &QBluetoothSocket::connected, this, &BluetoothTransport::onConnected);
     QObject::connect(m_socket, &QBluetoothSocket::disconnected, this, &BluetoothTransport::onDisconnected);
     QObject::connect(m_socket, &QBluetoothSocket::readyRead, this, &BluetoothTransport::onDataReady);
-    QObject::connect(m_socket, &QBluetoothSocket::stateChanged, this, &BluetoothTransport::onDataReady);
+    QObject::connect(m_socket, &QBluetoothSocket::stateChanged, this, &BluetoothTransport::onStateChanged);
+    QObject::connect(m_socket, &QBluetoothSocket::bytesWritten, this, &BluetoothTransport::onBytesWritten);
+
+    m_statsTimer.setInterval(1000);
+    QObject::connect(&m_statsTimer, &QTimer::timeout, this, &BluetoothTransport::updateStats);
 }
 
 bool BluetoothTransport::connect(const QUrl &url)
@@ -70,6 +81,10 @@ QUrl BluetoothTransport::url() const
 
 void BluetoothTransport::disconnect()
 {
+    m_interactiveQueue.clear();
+    m_bulkQueue.clear();
+    m_currentMessage.clear();
+    m_currentOffset = 0;
     m_socket->close();
 }
 
@@ -88,8 +103,124 @@ NymeaTransportInterface::ConnectionState BluetoothTransport::connectionState() c
 
 void BluetoothTransport::sendData(const QByteArray &data)
 {
-    qDebug() << "BluetoothInterface: send data:" << qUtf8Printable(data);
-    m_socket->write(data);
+    QElapsedTimer queuedTimer;
+    queuedTimer.start();
+    if (data.size() <= interactiveMessageSize) {
+        m_interactiveQueue.append(qMakePair(data, queuedTimer));
+    } else {
+        m_bulkQueue.append(qMakePair(data, queuedTimer));
+    }
+    writeFrames();
+}
+
+int BluetoothTransport::frameSize() const
+{
+    return m_frameSize;
+}
+
+void BluetoothTransport::setFrameSize(int frameSize)
+{
+    frameSize = qMax(64, frameSize);
+    if (m_frameSize != frameSize) {
+        m_frameSize = frameSize;
+        emit frameSizeChanged();
+    }
+}
+
+quint64 BluetoothTransport::bytesSent() const
+{
+    return m_bytesSent;
+}
+
+quint64 BluetoothTransport::bytesReceived() const
+{
+    return m_bytesReceived;
+}
+
+int BluetoothTransport::sendThroughput() const
+{
+    return m_sendThroughput;
+}
+
+int BluetoothTransport::receiveThroughput() const
+{
+    return m_receiveThroughput;
+}
+
+int BluetoothTransport::writeLatency() const
+{
+    return m_writeLatency;
+}
+
+int BluetoothTransport::queuedBytes() const
+{
+    int queued = m_currentMessage.size() - m_currentOffset + static_cast<int>(m_socket->bytesToWrite());
+    for (int i = 0; i < m_interactiveQueue.count(); i++) {
+        queued += m_interactiveQueue.at(i).first.size();
+    }
+    for (int i = 0; i < m_bulkQueue.count(); i++) {
+        queued += m_bulkQueue.at(i).first.size();
+    }
+    return queued;
+}
+
+void BluetoothTransport::writeFrames()
+{
+    if (m_socket->state() != QBluetoothSocket::ConnectedState) {
+        return;
+    }
+
+    // Keep at most two frames in the socket's buffer. Anything more only adds to the
+    // time a newly queued interactive command has to wait.
+    while (m_socket->bytesToWrite() < m_frameSize * 2) {
+        if (m_currentOffset >= m_currentMessage.size()) {
+            if (!m_interactiveQueue.isEmpty()) {
+                QPair<QByteArray, QElapsedTimer> next = m_interactiveQueue.takeFirst();
+                m_currentMessage = next.first;
+                m_currentMessageTimer = next.second;
+            } else if (!m_bulkQueue.isEmpty()) {
+                QPair<QByteArray, QElapsedTimer> next = m_bulkQueue.takeFirst();
+                m_currentMessage = next.first;
+                m_currentMessageTimer = next.second;
+            } else {
+                m_currentMessage.clear();
+                return;
+            }
+            m_currentOffset = 0;
+        }
+
+        qint64 written = m_socket->write(m_currentMessage.constData() + m_currentOffset, qMin(m_frameSize, m_currentMessage.size() - m_currentOffset));
+        if (written <= 0) {
+            qWarning() << "BluetoothInterface: Error writing to socket:" << m_socket->errorString();
+            return;
+        }
+        m_currentOffset += static_cast<int>(written);
+        if (m_currentOffset >= m_currentMessage.size()) {
+            m_flushingMessageTimer = m_currentMessageTimer;
+        }
+    }
+}
+
+void BluetoothTransport::onBytesWritten(qint64 bytes)
+{
+    m_bytesSent += static_cast<quint64>(bytes);
+    if (m_flushingMessageTimer.isValid() && m_socket->bytesToWrite() == 0) {
+        m_writeLatency = static_cast<int>(m_flushingMessageTimer.elapsed());
+        m_flushingMessageTimer.invalidate();
+    }
+    writeFrames();
+}
+
+void BluetoothTransport::updateStats()
+{
+    m_sendThroughput = static_cast<int>(m_bytesSent - m_lastBytesSent);
+    m_receiveThroughput = static_cast<int>(m_bytesReceived - m_lastBytesReceived);
+    m_lastBytesSent = m_bytesSent;
+    m_lastBytesReceived = m_bytesReceived;
+    if (m_sendThroughput > 0 || m_receiveThroughput > 0) {
+        qCDebug(dcBluetoothTransport()) << "Sending" << m_sendThroughput << "B/s, receiving" << m_receiveThroughput << "B/s, last write latency" << m_writeLatency << "ms, queued" << queuedBytes() << "B";
+    }
+    emit statsChanged();
 }
 
 void BluetoothTransport::onServiceFound(const QBluetoothServiceInfo &service)
@@ -105,12 +236,15 @@ void BluetoothTransport::onServiceFound(const QBluetoothServiceInfo &service)
 void BluetoothTransport::onConnected()
 {
     qDebug() << "BluetoothInterface: connected" << m_socket->peerName() << m_socket->peerAddress();
+    m_statsTimer.start();
     emit connected();
+    writeFrames();
 }
 
 void BluetoothTransport::onDisconnected()
 {
-    qDebug() << "BluetoothInterface: disconnected" << m_socket->peerName() << m_socket->peerAddress();
+    qDebug() << "BluetoothInterface: disconnected" << m_socket->peerName() << m_socket->peerAddress() << "Sent:" << m_bytesSent << "B, received:" << m_bytesReceived << "B";
+    m_statsTimer.stop();
     emit disconnected();
 }
 
@@ -122,8 +256,8 @@ void BluetoothTransport::onStateChanged(const QBluetoothSocket::SocketState &sta
 void BluetoothTransport::onDataReady()
 {
     QByteArray data = m_socket->readAll();
-    qDebug() << "BluetoothInterface: recived data:" << qUtf8Printable(data);
-    emit dataReady(data);
+    m_bytesReceived += static_cast<quint64>(data.size());
+    deliverData(data);
 }
 
 
@@ -34,6 +34,8 @@
 #include <QObject>
 #include <QUrl>
 #include <QBluetoothSocket>
+#include <QElapsedTimer>
+#include <QTimer>
 
 #include "nymeatransportinterface.h"
 
@@ -47,6 +49,14 @@ public:
 class BluetoothTransport: public NymeaTransportInterface
 {
     Q_OBJECT
+    Q_PROPERTY(int frameSize READ frameSize WRITE setFrameSize NOTIFY frameSizeChanged)
+    Q_PROPERTY(quint64 bytesSent READ bytesSent NOTIFY statsChanged)
+    Q_PROPERTY(quint64 bytesReceived READ bytesReceived NOTIFY statsChanged)
+    Q_PROPERTY(int sendThroughput READ sendThroughput NOTIFY statsChanged)
+    Q_PROPERTY(int receiveThroughput READ receiveThroughput NOTIFY statsChanged)
+    Q_PROPERTY(int writeLatency READ writeLatency NOTIFY statsChanged)
+    Q_PROPERTY(int queuedBytes READ queuedBytes NOTIFY statsChanged)
+
 public:
     explicit BluetoothTransport(QObject *parent = nullptr);
 
@@ -56,17 +66,58 @@ public:
     ConnectionState connectionState() const override;
     void sendData(const QByteArray &data) override;
 
+    // Qt doesn't tell us the RFCOMM MTU, so writes are split into frames of this size (bytes)
+    int frameSize() const;
+    void setFrameSize(int frameSize);
+
+    quint64 bytesSent() const;
+    quint64 bytesReceived() const;
+    // Bytes per second, averaged over the last second
+    int sendThroughput() const;
+    int receiveThroughput() const;
+    // ms from queuing the last message until the link accepted all of it
+    int writeLatency() const;
+    int queuedBytes() const;
+
+signals:
+    void frameSizeChanged();
+    void statsChanged();
+
+private:
+    void writeFrames();
+
 private:
     QUrl m_url;
     QBluetoothSocket *m_socket = nullptr;
     QBluetoothServiceInfo m_service;
 
+    // A message that has been started must be finished before the next one, as the stream has no
+    // multiplexing. Small (interactive) messages however skip ahead of bulk ones not started yet.
+    int m_frameSize = 512;
+    QList<QPair<QByteArray, QElapsedTimer>> m_interactiveQueue;
+    QList<QPair<QByteArray, QElapsedTimer>> m_bulkQueue;
+    QByteArray m_currentMessage;
+    QElapsedTimer m_currentMessageTimer;
+    int m_currentOffset = 0;
+    QElapsedTimer m_flushingMessageTimer;
+
+    QTimer m_statsTimer;
+    quint64 m_bytesSent = 0;
+    quint64 m_bytesReceived = 0;
+    quint64 m_lastBytesSent = 0;
+    quint64 m_lastBytesReceived = 0;
+    int m_sendThroughput = 0;
+    int m_receiveThroughput = 0;
+    int m_writeLatency = -1;
+
 private slots:
     void onServiceFound(const QBluetoothServiceInfo &service);
     void onConnected();
     void onDisconnected();
     void onStateChanged(const QBluetoothSocket::SocketState &state);
     void onDataReady();
+    void onBytesWritten(qint64 bytes);
+    void updateStats();
 };
 
 #endif // BLUETOOTHTRANSPROT_H
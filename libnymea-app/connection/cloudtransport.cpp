@@ -40,18 +40,109 @@
 
 using namespace remoteproxyclient;
 
-CloudTransport::CloudTransport(AWSClient *awsClient, QObject *parent):
+// Refresh tokens this long before they expire so a connect never has to wait for Cognito
+static const int tokenRefreshMargin = 300;
+
+// How long a reconnect is waited for. The proxy closes unauthenticated connections well
+// before that, in which case a new one is opened until this runs out.
+static const int warmRelayLifetime = 30000;
+
+WarmRelayConnection::WarmRelayConnection(QObject *parent):
+    QObject(parent)
+{
+    m_lifetimeTimer.setSingleShot(true);
+    m_lifetimeTimer.setInterval(warmRelayLifetime);
+    QObject::connect(&m_lifetimeTimer, &QTimer::timeout, this, [this]() {
+        qDebug() << "CloudTransport: No reconnect to" << m_host << "Closing warm relay connection.";
+        drop();
+    });
+}
+
+void WarmRelayConnection::prewarm(const QString &host)
+{
+    m_host = host;
+    m_lifetimeTimer.start();
+    if (m_connection.isNull()) {
+        qDebug() << "CloudTransport: Pre-warming relay connection for" << host;
+        open();
+    }
+}
+
+RemoteProxyConnection *WarmRelayConnection::take()
+{
+    m_lifetimeTimer.stop();
+    if (m_connection.isNull() || m_connection->state() == RemoteProxyConnection::StateDisconnected
+            || m_connection->state() == RemoteProxyConnection::StateDiconnecting) {
+        drop();
+        return nullptr;
+    }
+    RemoteProxyConnection *connection = m_connection.data();
+    QObject::disconnect(connection, nullptr, this, nullptr);
+    m_connection.clear();
+    return connection;
+}
+
+QString WarmRelayConnection::host() const
+{
+    return m_host;
+}
+
+void WarmRelayConnection::open()
+{
+    m_connection = new RemoteProxyConnection(QUuid::createUuid(), qApp->applicationName(), this);
+    QObject::connect(m_connection.data(), &RemoteProxyConnection::disconnected, this, [this]() {
+        qDebug() << "CloudTransport: Warm relay connection closed by the proxy.";
+        m_connection->deleteLater();
+        m_connection.clear();
+        if (m_lifetimeTimer.isActive()) {
+            open();
+        }
+    });
+    m_connection->connectServer(QUrl("wss://remoteproxy.nymea.io"));
+}
+
+void WarmRelayConnection::drop()
+{
+    m_lifetimeTimer.stop();
+    if (m_connection.isNull()) {
+        return;
+    }
+    QObject::disconnect(m_connection.data(), nullptr, this, nullptr);
+    m_connection->disconnectServer();
+    m_connection->deleteLater();
+    m_connection.clear();
+}
+
+CloudTransport::CloudTransport(AWSClient *awsClient, WarmRelayConnection *warmRelay, QObject *parent):
     NymeaTransportInterface(parent),
-    m_awsClient(awsClient)
+    m_awsClient(awsClient),
+    m_warmRelay(warmRelay)
 {
-    m_remoteproxyConnection = new RemoteProxyConnection(QUuid::createUuid(), qApp->applicationName(), this);
+}
 
+void CloudTransport::prewarm()
+{
+    if (m_warmRelay.isNull() || !m_awsClient->isLoggedIn()) {
+        return;
+    }
+    m_awsClient->refreshTokensIfExpiring(tokenRefreshMargin);
+    m_warmRelay->prewarm(m_url.host());
+}
+
+void CloudTransport::setupProxyConnection()
+{
     QObject::connect(m_remoteproxyConnection, &RemoteProxyConnection::remoteConnectionEstablished, this,[this]() {
         qDebug() << "CloudTransport: Remote connection established.";
+        m_remoteConnected = true;
         emit connected();
     });
     QObject::connect(m_remoteproxyConnection, &RemoteProxyConnection::disconnected, this,[this]() {
         qDebug() << "CloudTransport: Disconnected.";
+        if (m_remoteConnected) {
+            // Most likely we'll be asked to reconnect right away
+            prewarm();
+        }
+        m_remoteConnected = false;
         emit disconnected();
     });
 
@@ -60,11 +151,11 @@ CloudTransport::CloudTransport(AWSClient *awsClient, QObject *parent):
     });
 
     QObject::connect(m_remoteproxyConnection, &RemoteProxyConnection::ready, this,[this]() {
-        qDebug() << "Proxy ready. Authenticating channel.";
-        m_remoteproxyConnection->authenticate(m_awsClient->idToken(), m_nonce);
+        qDebug() << "Proxy ready.";
+        authenticateIfPossible();
     });
     QObject::connect(m_remoteproxyConnection, &RemoteProxyConnection::dataReady, this, [this](const QByteArray &data) {
-        emit dataReady(data);
+        deliverData(data);
     });
     QObject::connect(m_remoteproxyConnection, &RemoteProxyConnection::errorOccured, this, [] (QAbstractSocket::SocketError error) {
         qDebug() << "Remote proxy Error:" << error;
@@ -73,6 +164,33 @@ CloudTransport::CloudTransport(AWSClient *awsClient, QObject *parent):
     QObject::connect(m_remoteproxyConnection, &RemoteProxyConnection::sslErrors, this, &CloudTransport::sslErrors);
 }
 
+void CloudTransport::dropProxyConnection()
+{
+    if (!m_remoteproxyConnection) {
+        return;
+    }
+    QObject::disconnect(m_remoteproxyConnection, nullptr, this, nullptr);
+    m_remoteproxyConnection->disconnectServer();
+    m_remoteproxyConnection->deleteLater();
+    m_remoteproxyConnection = nullptr;
+}
+
+void CloudTransport::authenticateIfPossible()
+{
+    if (!m_remoteproxyConnection || m_authenticating || m_remoteproxyConnection->state() != RemoteProxyConnection::StateReady) {
+        return;
+    }
+    // The nonce is known up front, so there is no need to wait for the MQTT post to complete
+    // unless the post is busy refreshing the tokens we're about to authenticate with.
+    if (!m_mqttPosted && m_awsClient->tokensExpired()) {
+        qDebug() << "Proxy ready. Waiting for token refresh before authenticating.";
+        return;
+    }
+    qDebug() << "Authenticating channel.";
+    m_authenticating = true;
+    m_remoteproxyConnection->authenticate(m_awsClient->idToken(), m_nonce);
+}
+
 bool CloudTransport::connect(const QUrl &url)
 {
     if (!m_awsClient->isLoggedIn()) {
@@ -82,23 +200,46 @@ bool CloudTransport::connect(const QUrl &url)
 
     qDebug() << "Connecting to" << url;
     m_url = url;
+    m_mqttPosted = false;
+    m_authenticating = false;
+    m_remoteConnected = false;
+
+    dropProxyConnection();
+    if (m_warmRelay) {
+        m_remoteproxyConnection = m_warmRelay->take();
+    }
+    if (m_remoteproxyConnection) {
+        qDebug() << "CloudTransport: Using warm relay connection kept for" << m_warmRelay->host();
+        m_remoteproxyConnection->setParent(this);
+        setupProxyConnection();
+    } else {
+        m_remoteproxyConnection = new RemoteProxyConnection(QUuid::createUuid(), qApp->applicationName(), this);
+        setupProxyConnection();
+        // Connect to the proxy while the core is being woken up
+        m_remoteproxyConnection->connectServer(QUrl("wss://remoteproxy.nymea.io"));
+    }
 
     m_nonce = QUuid::createUuid().toString();
     bool postResult = m_awsClient->postToMQTT(url.host(), m_nonce, QPointer<QObject>(this), [this](bool success) {
         if (success) {
-            qDebug() << "MQTT Post done. Connecting to remote proxy";
-            m_remoteproxyConnection->connectServer(QUrl("wss://remoteproxy.nymea.io"));
+            qDebug() << "MQTT Post done.";
+            m_mqttPosted = true;
+            authenticateIfPossible();
         } else {
             qDebug() << "Posting to MQTT failed";
+            dropProxyConnection();
             emit error(QAbstractSocket::HostNotFoundError);
         }
     });
 
     if (!postResult) {
         qWarning() << "Failed to post to MQTT. Cannot continue";
+        dropProxyConnection();
         return false;
     }
 
+    // In case the warm connection is ready already
+    authenticateIfPossible();
     return true;
 }
 
@@ -110,11 +251,16 @@ QUrl CloudTransport::url() const
 void CloudTransport::disconnect()
 {
     qDebug() << "CloudTransport: Disconnecting from server.";
-    m_remoteproxyConnection->disconnectServer();
+    if (m_remoteproxyConnection) {
+        m_remoteproxyConnection->disconnectServer();
+    }
 }
 
 NymeaTransportInterface::ConnectionState CloudTransport::connectionState() const
 {
+    if (!m_remoteproxyConnection) {
+        return NymeaTransportInterface::ConnectionStateDisconnected;
+    }
     switch (m_remoteproxyConnection->state()) {
     case RemoteProxyConnection::StateRemoteConnected:
         return NymeaTransportInterface::ConnectionStateConnected;
@@ -136,23 +282,33 @@ NymeaTransportInterface::ConnectionState CloudTransport::connectionState() const
 void CloudTransport::sendData(const QByteArray &data)
 {
 //    qDebug() << "Cloud transport: Sending data:" << data;
-    m_remoteproxyConnection->sendData(data);
+    if (m_remoteproxyConnection) {
+        m_remoteproxyConnection->sendData(data);
+    }
 }
 
 void CloudTransport::ignoreSslErrors(const QList<QSslError> &errors)
 {
     qDebug() << "CloudTransport: Ignoring SSL errors" << errors;
-    m_remoteproxyConnection->ignoreSslErrors(errors);
+    if (m_remoteproxyConnection) {
+        m_remoteproxyConnection->ignoreSslErrors(errors);
+    }
 }
 
-CloudTransportFactory::CloudTransportFactory()
+CloudTransportFactory::CloudTransportFactory():
+    m_warmRelay(new WarmRelayConnection())
 {
 
 }
 
+CloudTransportFactory::~CloudTransportFactory()
+{
+    delete m_warmRelay;
+}
+
 NymeaTransportInterface *CloudTransportFactory::createTransport(QObject *parent) const
 {    
-    return new CloudTransport(AWSClient::instance(), parent);
+    return new CloudTransport(AWSClient::instance(), m_warmRelay, parent);
 }
 
 QStringList CloudTransportFactory::supportedSchemes() const
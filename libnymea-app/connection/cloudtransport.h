@@ -35,25 +35,54 @@
 
 #include <QObject>
 #include <QUrl>
+#include <QPointer>
+#include <QTimer>
 
 class AWSClient;
 namespace remoteproxyclient {
 class RemoteProxyConnection;
 }
 
+// Keeps an idle relay connection open for a while so the next connect can skip the
+// proxy connect and TLS handshake. The relay socket is not bound to a host until it
+// authenticates, so a single one, kept for the most recently used host, is enough.
+class WarmRelayConnection: public QObject
+{
+    Q_OBJECT
+public:
+    explicit WarmRelayConnection(QObject *parent = nullptr);
+
+    void prewarm(const QString &host);
+    remoteproxyclient::RemoteProxyConnection *take();
+    QString host() const;
+
+private:
+    void open();
+    void drop();
+
+    QPointer<remoteproxyclient::RemoteProxyConnection> m_connection;
+    QString m_host;
+    QTimer m_lifetimeTimer;
+};
+
 class CloudTransportFactory: public NymeaTransportInterfaceFactory
 {
 public:
     CloudTransportFactory();
+    ~CloudTransportFactory() override;
     NymeaTransportInterface* createTransport(QObject *parent = nullptr) const override;
     QStringList supportedSchemes() const override;
+
+private:
+    // Outlives the transports, which are thrown away when they disconnect
+    WarmRelayConnection *m_warmRelay = nullptr;
 };
 
 class CloudTransport : public NymeaTransportInterface
 {
     Q_OBJECT
 public:
-    explicit CloudTransport(AWSClient *awsClient, QObject *parent = nullptr);
+    explicit CloudTransport(AWSClient *awsClient, WarmRelayConnection *warmRelay = nullptr, QObject *parent = nullptr);
 
     bool connect(const QUrl &url) override;
     QUrl url() const override;
@@ -62,11 +91,22 @@ public:
     void sendData(const QByteArray &data) override;
 
     void ignoreSslErrors(const QList<QSslError> &errors) override;
+
+private:
+    void prewarm();
+    void setupProxyConnection();
+    void dropProxyConnection();
+    void authenticateIfPossible();
+
 private:
     QUrl m_url;
     AWSClient *m_awsClient = nullptr;
+    QPointer<WarmRelayConnection> m_warmRelay;
     remoteproxyclient::RemoteProxyConnection *m_remoteproxyConnection = nullptr;
     QString m_nonce;
+    bool m_mqttPosted = false;
+    bool m_authenticating = false;
+    bool m_remoteConnected = false;
 };
 
 #endif // CLOUDTRANSPORT_H
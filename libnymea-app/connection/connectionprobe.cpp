@@ -0,0 +1,141 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "connectionprobe.h"
+#include "nymeahost.h"
+
+#include <QTcpSocket>
+#include <QTimer>
+
+#include "logging.h"
+NYMEA_LOGGING_CATEGORY(dcConnectionProbe, "ConnectionProbe")
+
+// Don't hammer the network (or the radio on mobile) with all of them at once
+static const int maxConcurrentProbes = 4;
+static const int probeTimeout = 3000;
+
+ConnectionProbe::ConnectionProbe(QObject *parent) : QObject(parent)
+{
+    m_clock.start();
+}
+
+void ConnectionProbe::probe(const QList<Connection*> &connections)
+{
+    foreach (Connection *connection, connections) {
+        // Only TCP based transports can be probed cheaply. Cloud and Bluetooth are left alone.
+        QString scheme = connection->url().scheme();
+        if (scheme != "nymea" && scheme != "nymeas" && scheme != "ws" && scheme != "wss") {
+            continue;
+        }
+        if (connection->url().port() <= 0 || m_queue.contains(connection) || m_running.values().contains(connection)) {
+            continue;
+        }
+        m_queue.append(connection);
+    }
+    qCDebug(dcConnectionProbe()) << "Probing" << m_queue.count() << "connections";
+    startNext();
+}
+
+void ConnectionProbe::cancel()
+{
+    if (!running()) {
+        return;
+    }
+    qCDebug(dcConnectionProbe()) << "Cancelling probes";
+    m_queue.clear();
+    foreach (QTcpSocket *socket, m_running.keys()) {
+        socket->disconnect(this);
+        socket->abort();
+        socket->deleteLater();
+    }
+    m_running.clear();
+    m_startTimes.clear();
+}
+
+bool ConnectionProbe::running() const
+{
+    return !m_queue.isEmpty() || !m_running.isEmpty();
+}
+
+void ConnectionProbe::startNext()
+{
+    while (!m_queue.isEmpty() && m_running.count() < maxConcurrentProbes) {
+        QPointer<Connection> connection = m_queue.takeFirst();
+        if (connection.isNull()) {
+            continue;
+        }
+        QTcpSocket *socket = new QTcpSocket(this);
+        m_running.insert(socket, connection);
+        m_startTimes.insert(socket, m_clock.elapsed());
+        connect(socket, &QTcpSocket::connected, this, [this, socket](){
+            finishProbe(socket, true);
+        });
+#if (QT_VERSION >= QT_VERSION_CHECK(5, 15, 0))
+        connect(socket, &QTcpSocket::errorOccurred, this, [this, socket](){
+#else
+        connect(socket, static_cast<void (QTcpSocket::*)(QAbstractSocket::SocketError)>(&QTcpSocket::error), this, [this, socket](){
+#endif
+            finishProbe(socket, false);
+        });
+        QTimer::singleShot(probeTimeout, socket, [this, socket](){
+            finishProbe(socket, false);
+        });
+        socket->connectToHost(connection->url().host(), static_cast<quint16>(connection->url().port()));
+    }
+
+    if (m_queue.isEmpty() && m_running.isEmpty()) {
+        emit finished();
+    }
+}
+
+void ConnectionProbe::finishProbe(QTcpSocket *socket, bool success)
+{
+    if (!m_running.contains(socket)) {
+        return;
+    }
+    QPointer<Connection> connection = m_running.take(socket);
+    qint64 duration = m_clock.elapsed() - m_startTimes.take(socket);
+    socket->disconnect(this);
+    socket->abort();
+    socket->deleteLater();
+
+    if (!connection.isNull()) {
+        if (success) {
+            qCDebug(dcConnectionProbe()) << connection->url().toString() << "answered in" << duration << "ms";
+            connection->setProbeTime(static_cast<int>(duration));
+            connection->setOnline(true);
+            emit reachable(connection);
+        } else {
+            qCDebug(dcConnectionProbe()) << connection->url().toString() << "did not answer";
+        }
+    }
+
+    startNext();
+}
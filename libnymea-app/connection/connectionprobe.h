@@ -0,0 +1,71 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef CONNECTIONPROBE_H
+#define CONNECTIONPROBE_H
+
+#include <QObject>
+#include <QPointer>
+#include <QElapsedTimer>
+#include <QHash>
+
+class QTcpSocket;
+class Connection;
+
+// Checks which of a host's known connections are reachable by opening plain TCP connections
+// to them, a few at a time. Reachable ones are marked online with the time it took, so the
+// regular connection logic picks a live endpoint first.
+class ConnectionProbe : public QObject
+{
+    Q_OBJECT
+public:
+    explicit ConnectionProbe(QObject *parent = nullptr);
+
+    void probe(const QList<Connection*> &connections);
+    void cancel();
+
+    bool running() const;
+
+signals:
+    void reachable(Connection *connection);
+    void finished();
+
+private:
+    void startNext();
+    void finishProbe(QTcpSocket *socket, bool success);
+
+private:
+    QList<QPointer<Connection>> m_queue;
+    QHash<QTcpSocket*, QPointer<Connection>> m_running;
+    QHash<QTcpSocket*, qint64> m_startTimes;
+    QElapsedTimer m_clock;
+};
+
+#endif // CONNECTIONPROBE_H
@@ -34,6 +34,7 @@
 #include "bluetoothservicediscovery.h"
 #include "connection/awsclient.h"
 #include "../nymeahost.h"
+#include "startuptimeline.h"
 
 #include <QUuid>
 #include <QBluetoothUuid>
@@ -41,13 +42,34 @@
 #include <QSettings>
 #include <QNetworkConfigurationManager>
 #include <QNetworkSession>
+#include <QStandardPaths>
+#include <QDataStream>
+#include <QSaveFile>
+#include <QFile>
+#include <QDir>
 
 #include "logging.h"
 NYMEA_LOGGING_CATEGORY(dcDiscovery, "Discovery")
 
+// Bump the version when changing the layout. Unknown versions are discarded and rebuilt.
+static const quint32 hostCacheMagic = 0x6e796d68;
+static const quint8 hostCacheVersion = 1;
+
+static QString hostCacheFile()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::DataLocation) + "/hostcache";
+}
+
 NymeaDiscovery::NymeaDiscovery(QObject *parent) : QObject(parent)
 {
     m_nymeaHosts = new NymeaHosts(this);
+    connect(m_nymeaHosts, &NymeaHosts::hostAdded, this, &NymeaDiscovery::onHostAdded);
+    connect(m_nymeaHosts, &NymeaHosts::hostRemoved, this, [this](NymeaHost *host){
+        if (host == m_firstUsableHost) {
+            m_firstUsableHost = nullptr;
+            emit firstUsableHostChanged();
+        }
+    });
 
     loadFromDisk();
 
@@ -76,6 +98,15 @@ void NymeaDiscovery::setDiscovering(bool discovering)
 
     m_discovering = discovering;
     if (discovering) {
+        StartupTimeline::mark("Discovery started");
+        if (m_firstUsableHost) {
+            m_firstUsableHost = nullptr;
+            emit firstUsableHostChanged();
+        }
+        for (int i = 0; i < m_nymeaHosts->rowCount(); i++) {
+            checkUsable(m_nymeaHosts->get(i));
+        }
+
         if (m_zeroconfDiscoveryEnabled) {
             if (!m_zeroConf) {
                 m_zeroConf = new ZeroconfDiscovery(m_nymeaHosts, this);
@@ -125,6 +156,11 @@ NymeaHosts *NymeaDiscovery::nymeaHosts() const
     return m_nymeaHosts;
 }
 
+NymeaHost *NymeaDiscovery::firstUsableHost() const
+{
+    return m_firstUsableHost;
+}
+
 AWSClient *NymeaDiscovery::awsClient() const
 {
     return m_awsClient;
@@ -144,11 +180,6 @@ void NymeaDiscovery::setAwsClient(AWSClient *awsClient)
 
 void NymeaDiscovery::cacheHost(NymeaHost *host)
 {
-    QSettings settings;
-    settings.beginGroup("HostCache");
-    settings.remove(host->uuid().toString());
-    settings.beginGroup(host->uuid().toString());
-    settings.setValue("name", host->name());
     QList<Connection*> connections;
     Connection *remoteConnection = host->connections()->bestMatch(Connection::BearerTypeCloud);
     if (remoteConnection) {
@@ -170,16 +201,14 @@ void NymeaDiscovery::cacheHost(NymeaHost *host)
     if (btConnection) {
         connections.append(btConnection);
     }
-    int i = 0;
+
+    CachedHost cachedHost;
+    cachedHost.name = host->name();
     foreach (Connection *connection, connections) {
-        settings.beginGroup(QString::number(i++));
-        settings.setValue("url", connection->url());
-        settings.setValue("bearerType", connection->bearerType());
-        settings.setValue("secure", connection->secure());
-        settings.setValue("displayName", connection->displayName());
-        settings.endGroup();
+        cachedHost.connections.append({connection->url(), connection->bearerType(), connection->secure(), connection->displayName()});
     }
-    settings.endGroup();
+    m_hostCache.insert(host->uuid(), cachedHost);
+    writeCacheFile();
 }
 
 bool NymeaDiscovery::zeroconfDiscoveryEnable() const
@@ -280,35 +309,143 @@ void NymeaDiscovery::syncCloudDevices()
 
 void NymeaDiscovery::loadFromDisk()
 {
-    QSettings settings;
-    settings.beginGroup("HostCache");
-    foreach (const QString &serverUuid, settings.childGroups()) {
-        settings.beginGroup(serverUuid);
-        NymeaHost* host = m_nymeaHosts->find(QUuid(serverUuid));
+    if (!loadCacheFile(m_hostCache)) {
+        // Older versions kept the cache in the settings. Move it over.
+        loadLegacyCache(m_hostCache);
+        if (!m_hostCache.isEmpty()) {
+            writeCacheFile();
+            QSettings settings;
+            settings.remove("HostCache");
+        }
+    }
+
+    foreach (const QUuid &serverUuid, m_hostCache.keys()) {
+        const CachedHost &cachedHost = m_hostCache[serverUuid];
+        NymeaHost* host = m_nymeaHosts->find(serverUuid);
         if (!host) {
             host = new NymeaHost(m_nymeaHosts);
-            host->setName(settings.value("name").toString());
-            host->setUuid(QUuid(serverUuid));
+            host->setName(cachedHost.name);
+            host->setUuid(serverUuid);
             m_nymeaHosts->addHost(host);
         }
         qCDebug(dcDiscovery()) << "Loaded Host from cache" << host->name() << host->uuid();
-        foreach (const QString &group, settings.childGroups()) {
-            settings.beginGroup(group);
-            QString url = settings.value("url").toString();
-            Connection* connection = host->connections()->find(url);
+        foreach (const CachedConnection &cachedConnection, cachedHost.connections) {
+            Connection* connection = host->connections()->find(cachedConnection.url);
             if (!connection) {
-                Connection::BearerType bearerType = static_cast<Connection::BearerType>(settings.value("bearerType").toInt());
-                bool secure = settings.value("secure").toBool();
-                QString displayName = settings.value("displayName").toString();
-                connection = new Connection(url, bearerType, secure, displayName, host);
+                connection = new Connection(cachedConnection.url, cachedConnection.bearerType, cachedConnection.secure, cachedConnection.displayName, host);
                 host->connections()->addConnection(connection);
-                qCDebug(dcDiscovery()) << "|- Connection:" << group << connection->url() << connection->bearerType() << "secure:" << connection->secure();
+                qCDebug(dcDiscovery()) << "|- Connection:" << connection->url() << connection->bearerType() << "secure:" << connection->secure();
             }
+        }
+    }
+}
+
+bool NymeaDiscovery::loadCacheFile(QHash<QUuid, CachedHost> &cache) const
+{
+    QFile file(hostCacheFile());
+    if (!file.open(QFile::ReadOnly)) {
+        return false;
+    }
+    // One read, then parse from memory
+    QByteArray data = file.readAll();
+    file.close();
+
+    QDataStream stream(data);
+    stream.setVersion(QDataStream::Qt_5_6);
+    quint32 magic;
+    quint8 version;
+    quint32 hostCount;
+    stream >> magic >> version >> hostCount;
+    if (magic != hostCacheMagic || version != hostCacheVersion) {
+        qCWarning(dcDiscovery()) << "Discarding host cache of unknown format";
+        return false;
+    }
+    for (quint32 i = 0; i < hostCount && stream.status() == QDataStream::Ok; i++) {
+        QUuid uuid;
+        CachedHost cachedHost;
+        quint32 connectionCount;
+        stream >> uuid >> cachedHost.name >> connectionCount;
+        for (quint32 j = 0; j < connectionCount && stream.status() == QDataStream::Ok; j++) {
+            CachedConnection cachedConnection;
+            qint32 bearerType;
+            stream >> cachedConnection.url >> bearerType >> cachedConnection.secure >> cachedConnection.displayName;
+            cachedConnection.bearerType = static_cast<Connection::BearerType>(bearerType);
+            cachedHost.connections.append(cachedConnection);
+        }
+        cache.insert(uuid, cachedHost);
+    }
+    if (stream.status() != QDataStream::Ok) {
+        qCWarning(dcDiscovery()) << "Host cache is truncated. Discarding it.";
+        cache.clear();
+        return false;
+    }
+    return true;
+}
+
+void NymeaDiscovery::loadLegacyCache(QHash<QUuid, CachedHost> &cache) const
+{
+    QSettings settings;
+    settings.beginGroup("HostCache");
+    foreach (const QString &serverUuid, settings.childGroups()) {
+        settings.beginGroup(serverUuid);
+        CachedHost cachedHost;
+        cachedHost.name = settings.value("name").toString();
+        foreach (const QString &group, settings.childGroups()) {
+            settings.beginGroup(group);
+            CachedConnection cachedConnection;
+            cachedConnection.url = settings.value("url").toUrl();
+            cachedConnection.bearerType = static_cast<Connection::BearerType>(settings.value("bearerType").toInt());
+            cachedConnection.secure = settings.value("secure").toBool();
+            cachedConnection.displayName = settings.value("displayName").toString();
+            cachedHost.connections.append(cachedConnection);
             settings.endGroup();
         }
+        cache.insert(QUuid(serverUuid), cachedHost);
         settings.endGroup();
     }
+    settings.endGroup();
+}
 
+void NymeaDiscovery::writeCacheFile() const
+{
+    QDir().mkpath(QStandardPaths::writableLocation(QStandardPaths::DataLocation));
+    QSaveFile file(hostCacheFile());
+    if (!file.open(QFile::WriteOnly)) {
+        qCWarning(dcDiscovery()) << "Cannot write host cache:" << file.errorString();
+        return;
+    }
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_6);
+    stream << hostCacheMagic << hostCacheVersion << static_cast<quint32>(m_hostCache.count());
+    foreach (const QUuid &uuid, m_hostCache.keys()) {
+        const CachedHost &cachedHost = m_hostCache[uuid];
+        stream << uuid << cachedHost.name << static_cast<quint32>(cachedHost.connections.count());
+        foreach (const CachedConnection &cachedConnection, cachedHost.connections) {
+            stream << cachedConnection.url << static_cast<qint32>(cachedConnection.bearerType) << cachedConnection.secure << cachedConnection.displayName;
+        }
+    }
+    if (!file.commit()) {
+        qCWarning(dcDiscovery()) << "Cannot write host cache:" << file.errorString();
+    }
+}
+
+void NymeaDiscovery::onHostAdded(NymeaHost *host)
+{
+    connect(host, &NymeaHost::onlineChanged, this, [this, host](){
+        checkUsable(host);
+    });
+    checkUsable(host);
+}
+
+void NymeaDiscovery::checkUsable(NymeaHost *host)
+{
+    if (!m_discovering || m_firstUsableHost || !host->online()) {
+        return;
+    }
+    qCInfo(dcDiscovery()) << "First usable host found:" << host->name() << host->uuid();
+    StartupTimeline::mark("First usable host found");
+    m_firstUsableHost = host;
+    emit firstUsableHostChanged();
 }
 
 void NymeaDiscovery::updateActiveBearers()
@@ -55,6 +55,7 @@ class NymeaDiscovery : public QObject
     Q_PROPERTY(AWSClient* awsClient READ awsClient WRITE setAwsClient NOTIFY awsClientChanged)
 
     Q_PROPERTY(NymeaHosts* nymeaHosts READ nymeaHosts CONSTANT)
+    Q_PROPERTY(NymeaHost* firstUsableHost READ firstUsableHost NOTIFY firstUsableHostChanged)
 
 public:
     explicit NymeaDiscovery(QObject *parent = nullptr);
@@ -65,6 +66,9 @@ public:
 
     NymeaHosts *nymeaHosts() const;
 
+    // The first host any discovery strategy found reachable since discovery was started
+    NymeaHost *firstUsableHost() const;
+
     AWSClient* awsClient() const;
     void setAwsClient(AWSClient *awsClient);
 
@@ -82,6 +86,7 @@ public slots:
 signals:
     void discoveringChanged();
     void awsClientChanged();
+    void firstUsableHostChanged();
 
     void serverUuidResolved(const QUuid &uuid, const QString &url);
 
@@ -93,9 +98,27 @@ private slots:
     void syncCloudDevices();
 
     void loadFromDisk();
+    void onHostAdded(NymeaHost *host);
+    void checkUsable(NymeaHost *host);
 
     void updateActiveBearers();
 
+private:
+    struct CachedConnection {
+        QUrl url;
+        Connection::BearerType bearerType;
+        bool secure;
+        QString displayName;
+    };
+    struct CachedHost {
+        QString name;
+        QList<CachedConnection> connections;
+    };
+
+    bool loadCacheFile(QHash<QUuid, CachedHost> &cache) const;
+    void loadLegacyCache(QHash<QUuid, CachedHost> &cache) const;
+    void writeCacheFile() const;
+
 private:
     bool m_discovering = false;
     NymeaHosts *m_nymeaHosts = nullptr;
@@ -110,6 +133,9 @@ private:
 
     QList<QUuid> m_pendingHostResolutions;
 
+    QHash<QUuid, CachedHost> m_hostCache;
+    NymeaHost *m_firstUsableHost = nullptr;
+
     bool m_zeroconfDiscoveryEnabled = true;
     bool m_bluetoothDiscoveryEnabled = true;
     bool m_upnpDiscoveryEnabled = true;
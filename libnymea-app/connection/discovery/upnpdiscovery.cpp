@@ -40,6 +40,13 @@
 
 NYMEA_LOGGING_CATEGORY(dcUPnP, "UPnP")
 
+// Description fetches run in parallel, but a busy network shouldn't get flooded
+static const int maxConcurrentFetches = 4;
+
+// Devices answer within MX seconds. Search quickly at first, then back off.
+static const int initialSearchInterval = 500;
+static const int maxSearchInterval = 4000;
+
 UpnpDiscovery::UpnpDiscovery(NymeaHosts *nymeaHosts, QObject *parent) :
     QObject(parent),
     m_nymeaHosts(nymeaHosts)
@@ -48,7 +55,7 @@ UpnpDiscovery::UpnpDiscovery(NymeaHosts *nymeaHosts, QObject *parent) :
     m_networkAccessManager = new QNetworkAccessManager(this);
     connect(m_networkAccessManager, &QNetworkAccessManager::finished, this, &UpnpDiscovery::networkReplyFinished);
 
-    m_repeatTimer.setInterval(500);
+    m_repeatTimer.setInterval(initialSearchInterval);
     connect(&m_repeatTimer, &QTimer::timeout, this, &UpnpDiscovery::writeDiscoveryPacket);
 
     connect(m_networkConfigurationManager, &QNetworkConfigurationManager::configurationAdded, this, &UpnpDiscovery::updateInterfaces);
@@ -76,7 +83,7 @@ void UpnpDiscovery::discover()
     }
 
     qCInfo(dcUPnP()) << "Discovery started...";
-    m_repeatTimer.start();
+    m_repeatTimer.start(initialSearchInterval);
     m_foundDevices.clear();
     writeDiscoveryPacket();
     emit discoveringChanged();
@@ -153,6 +160,10 @@ void UpnpDiscovery::writeDiscoveryPacket()
             qCDebug(dcUPnP()) << "Error sending SSDP query on socket" << socket->localAddress();
         }
     }
+
+    if (m_repeatTimer.isActive() && m_repeatTimer.interval() < maxSearchInterval) {
+        m_repeatTimer.setInterval(qMin(m_repeatTimer.interval() * 2, maxSearchInterval));
+    }
 }
 
 void UpnpDiscovery::error(QAbstractSocket::SocketError error)
@@ -201,21 +212,36 @@ void UpnpDiscovery::readData()
 
             if (!m_foundDevices.contains(location) && isNymea) {
                 m_foundDevices.append(location);
-                qCDebug(dcUPnP()) << "Getting server data from:" << location;
-                QNetworkReply *reply = m_networkAccessManager->get(QNetworkRequest(location));
-                connect(reply, &QNetworkReply::sslErrors, [reply](const QList<QSslError> &errors){
-                    reply->ignoreSslErrors(errors);
-                });
-                m_runningReplies.insert(reply, hostAddress);
+                m_pendingFetches.append(qMakePair(location, hostAddress));
+                fetchNextDescription();
             }
         }
     }
 }
 
+void UpnpDiscovery::fetchNextDescription()
+{
+    while (!m_pendingFetches.isEmpty() && m_runningReplies.count() < maxConcurrentFetches) {
+        QPair<QUrl, QHostAddress> fetch = m_pendingFetches.takeFirst();
+        qCDebug(dcUPnP()) << "Getting server data from:" << fetch.first;
+        QNetworkRequest request(fetch.first);
+#if (QT_VERSION >= QT_VERSION_CHECK(5, 15, 0))
+        // Don't let a single unresponsive device hold up a slot for long
+        request.setTransferTimeout(5000);
+#endif
+        QNetworkReply *reply = m_networkAccessManager->get(request);
+        connect(reply, &QNetworkReply::sslErrors, [reply](const QList<QSslError> &errors){
+            reply->ignoreSslErrors(errors);
+        });
+        m_runningReplies.insert(reply, fetch.second);
+    }
+}
+
 void UpnpDiscovery::networkReplyFinished(QNetworkReply *reply)
 {
     reply->deleteLater();
     QHostAddress discoveredAddress = m_runningReplies.take(reply);
+    fetchNextDescription();
 
     int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
     if (reply->error() != QNetworkReply::NoError || status != 200) {
@@ -67,6 +67,8 @@ private slots:
     void networkReplyFinished(QNetworkReply *reply);
 
 private:
+    void fetchNextDescription();
+
     QHash<QHostAddress, QUdpSocket*> m_sockets;
     QNetworkAccessManager *m_networkAccessManager;
     QNetworkConfigurationManager *m_networkConfigurationManager;
@@ -76,6 +78,7 @@ private:
     NymeaHosts *m_nymeaHosts;
 
     QHash<QNetworkReply *, QHostAddress> m_runningReplies;
+    QList<QPair<QUrl, QHostAddress>> m_pendingFetches;
     QList<QUrl> m_foundDevices;
 
 };
@@ -44,12 +44,16 @@
 #include <QGuiApplication>
 
 #include "nymeatransportinterface.h"
+#include "connectionprobe.h"
+#include "startuptimeline.h"
 #include "logging.h"
 
 NYMEA_LOGGING_CATEGORY(dcNymeaConnection, "NymeaConnection")
 
 NymeaConnection::NymeaConnection(QObject *parent) : QObject(parent)
 {
+    m_probe = new ConnectionProbe(this);
+
     m_networkConfigManager = new QNetworkConfigurationManager(this);
 
     QObject::connect(m_networkConfigManager, &QNetworkConfigurationManager::configurationAdded, this, [this](const QNetworkConfiguration &config){
@@ -83,6 +87,8 @@ NymeaConnection::NymeaConnection(QObject *parent) : QObject(parent)
         updateActiveBearers();
     });
 
+    m_clock.start();
+
     updateActiveBearers();
 
     m_reconnectTimer.setInterval(100);
@@ -132,8 +138,11 @@ void NymeaConnection::setCurrentHost(NymeaHost *host)
         return;
     }
 
+    m_probe->cancel();
+    m_lastProbe.invalidate();
+
     if (m_currentTransport) {
-        m_currentTransport = nullptr;
+        setCurrentTransport(nullptr);
         emit currentConnectionChanged();
         emit connectedChanged(false);
     }
@@ -143,6 +152,9 @@ void NymeaConnection::setCurrentHost(NymeaHost *host)
         m_transportCandidates.remove(transport);
         transport->deleteLater();
     }
+    m_connectStartTimes.clear();
+    m_upgradeTransport = nullptr;
+
     if (m_currentHost) {
         disconnect(m_currentHost, &NymeaHost::connectionChanged, this, &NymeaConnection::hostConnectionsUpdated);
         m_currentHost = nullptr;
@@ -165,6 +177,8 @@ void NymeaConnection::setCurrentHost(NymeaHost *host)
     emit connectionStatusChanged();
 
     connectInternal(m_currentHost);
+    // Cached connections might be stale. Find out in parallel which ones are still alive.
+    probeConnections(true);
 }
 
 Connection *NymeaConnection::currentConnection() const
@@ -175,6 +189,52 @@ Connection *NymeaConnection::currentConnection() const
     return m_transportCandidates.value(m_currentTransport);
 }
 
+bool NymeaConnection::upgradeAvailable() const
+{
+    return m_upgradeTransport && m_upgradeTransport->connectionState() == NymeaTransportInterface::ConnectionStateConnected;
+}
+
+bool NymeaConnection::upgradeTransport()
+{
+    if (!upgradeAvailable()) {
+        return false;
+    }
+
+    NymeaTransportInterface *oldTransport = m_currentTransport;
+    setCurrentTransport(m_upgradeTransport);
+    m_upgradeTransport = nullptr;
+    qCInfo(dcNymeaConnection()) << "Upgrading connection to" << m_currentHost->name() << "from" << (oldTransport ? oldTransport->url() : QUrl()) << "to" << m_currentTransport->url();
+
+    if (oldTransport) {
+        m_transportCandidates.remove(oldTransport);
+        oldTransport->deleteLater();
+    }
+
+    emit currentConnectionChanged();
+    return true;
+}
+
+void NymeaConnection::dropCurrentTransport()
+{
+    if (!m_currentTransport) {
+        return;
+    }
+    NymeaTransportInterface *transport = m_currentTransport;
+    qCWarning(dcNymeaConnection()) << "Dropping connection to" << transport->url();
+    // Don't wait for the transport to report back, some of them only do so after a timeout on a dead link.
+    QObject::disconnect(transport, nullptr, this, nullptr);
+    transport->disconnect();
+    handleDisconnected(transport);
+}
+
+void NymeaConnection::setReceiveBuffer(QByteArray *buffer)
+{
+    m_receiveBuffer = buffer;
+    if (m_currentTransport) {
+        m_currentTransport->setReceiveBuffer(buffer);
+    }
+}
+
 void NymeaConnection::sendData(const QByteArray &data)
 {
     if (connected()) {
@@ -253,6 +313,20 @@ void NymeaConnection::onError(QAbstractSocket::SocketError error)
         return;
     }
 
+    if (m_currentTransport) {
+        // A background attempt to find a faster path failed. Just keep using the current one.
+        if (m_transportCandidates.contains(transport)) {
+            qCDebug(dcNymeaConnection()) << "Alternative connection to" << transport->url() << "failed:" << error;
+            m_transportCandidates.remove(transport);
+            m_connectStartTimes.remove(transport);
+            if (transport == m_upgradeTransport) {
+                m_upgradeTransport = nullptr;
+            }
+            transport->deleteLater();
+        }
+        return;
+    }
+
     if (!m_currentTransport) {
         // We're trying to connect and one of the transports failed...
         if (m_transportCandidates.contains(transport)) {
@@ -278,49 +352,68 @@ void NymeaConnection::onError(QAbstractSocket::SocketError error)
 void NymeaConnection::onConnected()
 {
     NymeaTransportInterface* newTransport = qobject_cast<NymeaTransportInterface*>(sender());
+    Connection *newConnection = m_transportCandidates.value(newTransport);
+    if (newConnection && m_connectStartTimes.contains(newTransport)) {
+        newConnection->setHandshakeTime(m_clock.elapsed() - m_connectStartTimes.take(newTransport));
+        qCDebug(dcNymeaConnection()) << "Connection to" << newConnection->url() << "established in" << newConnection->handshakeTime() << "ms";
+    }
+
     if (!m_currentTransport) {
-        m_currentTransport = newTransport;
+        m_probe->cancel();
+        setCurrentTransport(newTransport);
         qCInfo(dcNymeaConnection()) << "Connected to" << m_currentHost->name() << "via" << m_currentTransport->url() << m_currentTransport->isEncrypted();
+        StartupTimeline::mark("Transport connected");
         emit currentConnectionChanged();
         emit connectedChanged(true);
         return;
     }
 
     if (m_currentTransport != newTransport) {
-        // In theory, we could roam from one connection to another.
-        // However, in practice it turns out there are too many issues for this to be reliable
-        // So lets just tear down any alternative connection that comes up again.
+        // Switching the transport underneath a running session is only done when the new one is
+        // clearly faster (e.g. LAN instead of the cloud relay). The actual switch is left to the
+        // JsonRpcClient so it can wait for in-flight replies and redo the session setup.
+        Connection *currentConnection = m_transportCandidates.value(m_currentTransport);
+        if (!m_preferredConnection && newConnection && isFaster(newConnection, currentConnection)) {
+            if (m_upgradeTransport) {
+                if (!isFaster(newConnection, m_transportCandidates.value(m_upgradeTransport))) {
+                    qCInfo(dcNymeaConnection()) << "Dropping alternative connection to" << newTransport->url() << "A faster upgrade is pending already.";
+                    m_transportCandidates.remove(newTransport);
+                    newTransport->deleteLater();
+                    return;
+                }
+                m_transportCandidates.remove(m_upgradeTransport);
+                m_upgradeTransport->deleteLater();
+            }
+            qCInfo(dcNymeaConnection()) << "Faster connection available via" << newTransport->url() << newConnection->handshakeTime() << "ms" << "Current:" << m_currentTransport->url() << (currentConnection ? currentConnection->latency() : -1) << "ms";
+            m_upgradeTransport = newTransport;
+            emit transportUpgradeAvailable();
+            return;
+        }
 
         qCInfo(dcNymeaConnection()) << "Dropping successfully established alternative connection to" << newTransport->url() << "again...";
         m_transportCandidates.remove(newTransport);
         newTransport->deleteLater();
-
-
-//        Connection *existingConnection = m_transportCandidates.value(m_currentTransport);
-//        Connection *alternativeConnection = m_transportCandidates.value(newTransport);
-//        if (alternativeConnection->priority() > existingConnection->priority()) {
-//            qDebug() << "New connection has higher priority! Roaming from" << existingConnection->url() << existingConnection->priority() << "to" << alternativeConnection->url() << alternativeConnection->priority();
-//            m_transportCandidates.remove(m_currentTransport);
-//            m_currentTransport->deleteLater();
-//            m_currentTransport = newTransport;
-//        } else {
-//            qDebug() << "Connection" << alternativeConnection->url() << alternativeConnection->priority() << "has lower priority than existing" << existingConnection->url() << existingConnection->priority();
-//            m_transportCandidates.remove(newTransport);
-//            newTransport->deleteLater();
-//        }
         return;
     }
 }
 
 void NymeaConnection::onDisconnected()
 {
-    NymeaTransportInterface* t = qobject_cast<NymeaTransportInterface*>(sender());
+    handleDisconnected(qobject_cast<NymeaTransportInterface*>(sender()));
+}
+
+void NymeaConnection::handleDisconnected(NymeaTransportInterface *t)
+{
     qCInfo(dcNymeaConnection()) << "Disconnected from" << t->url().toString();
     if (m_currentTransport != t) {
         qCDebug(dcNymeaConnection()) << "An inactive transport for url" << t->url() << "disconnected... Cleaning up...";
         if (m_transportCandidates.contains(t)) {
             m_transportCandidates.remove(t);
         }
+        m_connectStartTimes.remove(t);
+        if (t == m_upgradeTransport) {
+            m_upgradeTransport = nullptr;
+        }
         t->deleteLater();
 
         qCDebug(dcNymeaConnection()) << "Current transport:" << m_currentTransport << "Remaining connections:" << m_transportCandidates.count() << "Current host:" << m_currentHost;
@@ -336,12 +429,13 @@ void NymeaConnection::onDisconnected()
     }
     m_transportCandidates.remove(m_currentTransport);
     m_currentTransport->deleteLater();
-    m_currentTransport = nullptr;
+    setCurrentTransport(nullptr);
+    m_upgradeTransport = nullptr;
 
     foreach (NymeaTransportInterface *candidate, m_transportCandidates.keys()) {
         if (candidate->connectionState() == NymeaTransportInterface::ConnectionStateConnected) {
             qCInfo(dcNymeaConnection()) << "Alternative connection is still up. Roaming to:" << candidate->url();
-            m_currentTransport = candidate;
+            setCurrentTransport(candidate);
             break;
         }
     }
@@ -376,6 +470,24 @@ void NymeaConnection::onDataAvailable(const QByteArray &data)
     }
 }
 
+void NymeaConnection::onDataAppended()
+{
+    // Only the current transport is given the receive buffer, no need to check the sender
+    emit dataAppended();
+}
+
+void NymeaConnection::setCurrentTransport(NymeaTransportInterface *transport)
+{
+    // Candidates and old transports must never write into the decoder's buffer
+    if (m_currentTransport) {
+        m_currentTransport->setReceiveBuffer(nullptr);
+    }
+    m_currentTransport = transport;
+    if (m_currentTransport) {
+        m_currentTransport->setReceiveBuffer(m_receiveBuffer);
+    }
+}
+
 void NymeaConnection::updateActiveBearers()
 {
     NymeaConnection::BearerTypes availableBearerTypes;
@@ -423,13 +535,16 @@ void NymeaConnection::updateActiveBearers()
     //   (Unless aggressive WiFi to mobile handover is enabled on the phone)
     // - When roaming from mobile to Wifi, for some reason, any new connection attempts
     //   fail as long as the mobile data isn't shut down by the OS.
-    // Those issues prevent roaming from working properly, so let's just not do anything at
-    // this point if there already is a connected channel, try reconnecting otherwise.
+    // Because of that, the existing channel is never torn down here. If there is one, we only
+    // try a faster path in the background and switch over once it's actually established.
 
     if (!m_currentTransport) {
         // There's a host but no connection. Try connecting now...
         qCInfo(dcNymeaConnection()) << "There's a host but no connection. Trying to connect now...";
         connectInternal(m_currentHost);
+        probeConnections();
+    } else {
+        connectUpgradeCandidate();
     }
 }
 
@@ -438,7 +553,33 @@ void NymeaConnection::hostConnectionsUpdated()
     if (!m_currentTransport) {
         qCInfo(dcNymeaConnection()) << "Possible connections for host" << m_currentHost->name() << "updated.";
         connectInternal(m_currentHost);
+    } else {
+        connectUpgradeCandidate();
+    }
+}
+
+void NymeaConnection::probeConnections(bool force)
+{
+    if (!m_currentHost || m_currentTransport) {
+        return;
+    }
+    // Bearer changes tend to come in bursts
+    if (!force && m_lastProbe.isValid() && m_lastProbe.elapsed() < 10000) {
+        qCDebug(dcNymeaConnection()) << "Connections probed recently. Not probing again.";
+        return;
+    }
+    m_lastProbe.start();
+
+    QList<Connection*> connections;
+    for (int i = 0; i < m_currentHost->connections()->rowCount(); i++) {
+        Connection *connection = m_currentHost->connections()->get(i);
+        // Those already have a real connection attempt running
+        if (!m_transportCandidates.values().contains(connection)) {
+            connections.append(connection);
+        }
     }
+    // Reachable ones go online, which triggers hostConnectionsUpdated() and connects to them
+    m_probe->probe(connections);
 }
 
 void NymeaConnection::registerTransport(NymeaTransportInterfaceFactory *transportFactory)
@@ -539,6 +680,7 @@ bool NymeaConnection::connectInternal(Connection *connection)
     QObject::connect(newTransport, &NymeaTransportInterface::connected, this, &NymeaConnection::onConnected);
     QObject::connect(newTransport, &NymeaTransportInterface::disconnected, this, &NymeaConnection::onDisconnected);
     QObject::connect(newTransport, &NymeaTransportInterface::dataReady, this, &NymeaConnection::onDataAvailable, Qt::QueuedConnection);
+    QObject::connect(newTransport, &NymeaTransportInterface::dataAppended, this, &NymeaConnection::onDataAppended);
 
 //    // Load any certificate we might have for this url
 //    QByteArray pem;
@@ -551,10 +693,79 @@ bool NymeaConnection::connectInternal(Connection *connection)
 //    }
 
     m_transportCandidates.insert(newTransport, connection);
+    m_connectStartTimes.insert(newTransport, m_clock.elapsed());
     qCInfo(dcNymeaConnection()) << "Connecting to:" << connection->url() << newTransport << m_transportCandidates.value(newTransport);
+    StartupTimeline::mark("Connecting");
     return newTransport->connect(connection->url());
 }
 
+void NymeaConnection::connectUpgradeCandidate()
+{
+    Connection *current = currentConnection();
+    if (!current || m_preferredConnection) {
+        return;
+    }
+
+    Connection *candidate = m_currentHost->connections()->bestMatch(Connection::BearerTypeLoopback);
+    if (!candidate) {
+        if (isConnectionBearerAvailable(Connection::BearerTypeLan)) {
+            candidate = m_currentHost->connections()->bestMatch(Connection::BearerTypeLan | Connection::BearerTypeWan);
+        } else if (isConnectionBearerAvailable(Connection::BearerTypeWan)) {
+            candidate = m_currentHost->connections()->bestMatch(Connection::BearerTypeWan);
+        }
+    }
+
+    if (!candidate || candidate == current || !isFaster(candidate, current)) {
+        return;
+    }
+
+    qCInfo(dcNymeaConnection()) << "Trying faster connection" << candidate->url() << "in the background. Current:" << current->url();
+    connectInternal(candidate);
+}
+
+static int bearerRank(Connection::BearerType bearerType)
+{
+    switch (bearerType) {
+    case Connection::BearerTypeLoopback:
+        return 5;
+    case Connection::BearerTypeLan:
+        return 4;
+    case Connection::BearerTypeWan:
+        return 3;
+    case Connection::BearerTypeCloud:
+        return 2;
+    case Connection::BearerTypeBluetooth:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+bool NymeaConnection::isFaster(Connection *candidate, Connection *current) const
+{
+    if (!current) {
+        return true;
+    }
+    // Never move a session and its token off TLS, however much faster the other path is
+    if (current->secure() && !candidate->secure()) {
+        return false;
+    }
+    int candidateRank = bearerRank(candidate->bearerType());
+    int currentRank = bearerRank(current->bearerType());
+    if (candidateRank != currentRank) {
+        return candidateRank > currentRank;
+    }
+    // Same kind of path. Only switch for a clear gain so we don't flap between similar links.
+    // Only compare like with like, a probe doesn't include TLS and the session setup.
+    if (candidate->handshakeTime() >= 0 && current->handshakeTime() >= 0) {
+        return candidate->handshakeTime() * 10 < current->handshakeTime() * 7;
+    }
+    if (candidate->probeTime() >= 0 && current->probeTime() >= 0) {
+        return candidate->probeTime() * 10 < current->probeTime() * 7;
+    }
+    return false;
+}
+
 NymeaConnection::BearerType NymeaConnection::qBearerTypeToNymeaBearerType(QNetworkConfiguration::BearerType type) const
 {
     switch (type) {
@@ -615,6 +826,16 @@ bool NymeaConnection::isEncrypted() const
     return m_currentTransport && m_currentTransport->isEncrypted();
 }
 
+bool NymeaConnection::isBinarySafe() const
+{
+    return m_currentTransport && m_currentTransport->isBinarySafe();
+}
+
+bool NymeaConnection::sessionResumptionOffered() const
+{
+    return m_currentTransport && m_currentTransport->sessionResumptionOffered();
+}
+
 QSslCertificate NymeaConnection::sslCertificate() const
 {
     if (!m_currentTransport) {
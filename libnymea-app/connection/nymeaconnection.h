@@ -38,9 +38,12 @@
 #include <QUrl>
 #include <QNetworkConfigurationManager>
 #include <QTimer>
+#include <QElapsedTimer>
 
 #include "nymeahost.h"
 
+class ConnectionProbe;
+
 class NymeaTransportInterface;
 class NymeaTransportInterfaceFactory;
 
@@ -90,6 +93,8 @@ public:
     Q_INVOKABLE void disconnectFromHost();
 
     bool isEncrypted() const;
+    bool isBinarySafe() const;
+    bool sessionResumptionOffered() const;
     QSslCertificate sslCertificate() const;
 
     NymeaConnection::BearerTypes availableBearerTypes() const;
@@ -102,9 +107,23 @@ public:
 
     Connection* currentConnection() const;
 
+    // A faster transport to the current host is connected and waiting to take over.
+    bool upgradeAvailable() const;
+    // Makes the pending faster transport the current one and drops the old one. The caller
+    // is responsible for picking a quiet moment (no pending replies) and redoing any
+    // per-connection session setup on the new transport.
+    bool upgradeTransport();
+
+    // Tears down the current transport right away, e.g. when the session layer detected a dead
+    // link, instead of waiting for the OS to time out the socket. Roams or reconnects as usual.
+    void dropCurrentTransport();
 
     void sendData(const QByteArray &data);
 
+    // The current transport appends received data directly into this buffer and dataAppended()
+    // is emitted instead of dataAvailable(). The buffer is owned by the caller.
+    void setReceiveBuffer(QByteArray *buffer);
+
 signals:
     void availableBearerTypesChanged();
     void verifyConnectionCertificate(const QString &url, const QStringList &issuerInfo, const QByteArray &fingerprint, const QByteArray &pem);
@@ -113,6 +132,8 @@ signals:
     void connectionStatusChanged();
     void currentConnectionChanged();
     void dataAvailable(const QByteArray &data);
+    void dataAppended();
+    void transportUpgradeAvailable();
 
 private slots:
     void onSslErrors(const QList<QSslError> &errors);
@@ -120,12 +141,18 @@ private slots:
     void onConnected();
     void onDisconnected();
     void onDataAvailable(const QByteArray &data);
+    void onDataAppended();
 
     void updateActiveBearers();
     void hostConnectionsUpdated();
 private:
     void connectInternal(NymeaHost *host);
     bool connectInternal(Connection *connection);
+    void handleDisconnected(NymeaTransportInterface *transport);
+    void setCurrentTransport(NymeaTransportInterface *transport);
+    void connectUpgradeCandidate();
+    void probeConnections(bool force = false);
+    bool isFaster(Connection *candidate, Connection *current) const;
 
     NymeaConnection::BearerType qBearerTypeToNymeaBearerType(QNetworkConfiguration::BearerType type) const;
 
@@ -141,8 +168,17 @@ private:
     NymeaTransportInterface *m_currentTransport = nullptr;
     NymeaHost *m_currentHost = nullptr;
     Connection *m_preferredConnection = nullptr;
+    NymeaTransportInterface *m_upgradeTransport = nullptr;
+
+    QByteArray *m_receiveBuffer = nullptr;
+
+    QElapsedTimer m_clock;
+    QHash<NymeaTransportInterface*, qint64> m_connectStartTimes;
 
     QTimer m_reconnectTimer;
+
+    ConnectionProbe *m_probe = nullptr;
+    QElapsedTimer m_lastProbe;
 };
 
 #endif // NYMEACONNECTION_H
@@ -62,7 +62,10 @@ QUuid NymeaHost::uuid() const
 
 void NymeaHost::setUuid(const QUuid &uuid)
 {
-    m_uuid = uuid;
+    if (m_uuid != uuid) {
+        m_uuid = uuid;
+        emit uuidChanged();
+    }
 }
 
 QString NymeaHost::name() const
@@ -327,11 +330,65 @@ int Connection::priority() const
     default:
         prio += 0;
     }
+    // Encrypted connections form their own tier above plaintext ones on the same bearer.
+    // The latency adjustment below is smaller than that gap, so speed never wins over TLS.
     if (m_secure) {
-        prio += 10;
+        prio += 50;
     }
     if (m_url.scheme().startsWith("nymea")) {
         prio += 1;
     }
+    // Among connections of the same bearer type and security, prefer the faster one.
+    if (latency() >= 0) {
+        prio -= qMin(40, latency() / 20);
+    }
     return prio;
 }
+
+int Connection::handshakeTime() const
+{
+    return m_handshakeTime;
+}
+
+void Connection::setHandshakeTime(int handshakeTime)
+{
+    if (m_handshakeTime != handshakeTime) {
+        m_handshakeTime = handshakeTime;
+        emit latencyChanged();
+        emit priorityChanged();
+    }
+}
+
+int Connection::roundTripTime() const
+{
+    return m_roundTripTime;
+}
+
+void Connection::addRoundTripSample(int roundTripTime)
+{
+    // Smooth out single outliers, but still follow a degrading link within a few samples
+    int smoothed = m_roundTripTime < 0 ? roundTripTime : (m_roundTripTime * 3 + roundTripTime) / 4;
+    if (m_roundTripTime != smoothed) {
+        m_roundTripTime = smoothed;
+        emit latencyChanged();
+        emit priorityChanged();
+    }
+}
+
+int Connection::latency() const
+{
+    return m_roundTripTime >= 0 ? m_roundTripTime : m_handshakeTime;
+}
+
+int Connection::probeTime() const
+{
+    return m_probeTime;
+}
+
+void Connection::setProbeTime(int probeTime)
+{
+    if (m_probeTime != probeTime) {
+        m_probeTime = probeTime;
+        emit latencyChanged();
+    }
+}
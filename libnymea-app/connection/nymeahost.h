@@ -50,6 +50,9 @@ class Connection: public QObject {
     Q_PROPERTY(QString displayName READ displayName CONSTANT)
     Q_PROPERTY(bool online READ online NOTIFY onlineChanged)
     Q_PROPERTY(int priority READ priority NOTIFY priorityChanged)
+    Q_PROPERTY(int handshakeTime READ handshakeTime NOTIFY latencyChanged)
+    Q_PROPERTY(int roundTripTime READ roundTripTime NOTIFY latencyChanged)
+    Q_PROPERTY(int probeTime READ probeTime NOTIFY latencyChanged)
 
 public:
     enum BearerType {
@@ -78,9 +81,21 @@ public:
     void setOnline(bool online);
     int priority() const;
 
+    // Latencies in ms as measured by NymeaConnection/JsonRpcClient, -1 if not measured yet
+    int handshakeTime() const;
+    void setHandshakeTime(int handshakeTime);
+    int roundTripTime() const;
+    void addRoundTripSample(int roundTripTime);
+    int latency() const;
+    // Bare TCP connect time as measured by ConnectionProbe. Not comparable to the above,
+    // which include TLS and the session setup.
+    int probeTime() const;
+    void setProbeTime(int probeTime);
+
 signals:
     void onlineChanged();
     void priorityChanged();
+    void latencyChanged();
 
 private:
     QUrl m_url;
@@ -89,6 +104,9 @@ private:
     QString m_displayName;
     bool m_online = false;
     QDateTime m_lastSeen;
+    int m_handshakeTime = -1;
+    int m_roundTripTime = -1;
+    int m_probeTime = -1;
 };
 
 class Connections: public QAbstractListModel
@@ -157,6 +175,7 @@ public:
     bool online() const;
 
 signals:
+    void uuidChanged();
     void nameChanged();
     void versionChanged();
     void connectionChanged();
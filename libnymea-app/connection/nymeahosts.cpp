@@ -64,13 +64,21 @@ QVariant NymeaHosts::data(const QModelIndex &index, int role) const
 
 void NymeaHosts::addHost(NymeaHost *host)
 {
-    for (int i = 0; i < m_hosts.count(); i++) {
-        if (m_hosts.at(i)->uuid() == host->uuid()) {
-            qWarning() << "Host already added. Update existing host instead.";
-            return;
-        }
+    if (m_hostsByUuid.contains(host->uuid())) {
+        qWarning() << "Host already added. Update existing host instead.";
+        return;
     }
     host->setParent(this);
+    m_hostsByUuid.insert(host->uuid(), host);
+    connect(host, &NymeaHost::uuidChanged, this, [=](){
+        // Manually added hosts only learn their uuid when connecting
+        if (m_hostsByUuid.value(m_hostsByUuid.key(host)) == host) {
+            m_hostsByUuid.remove(m_hostsByUuid.key(host));
+        }
+        if (!m_hostsByUuid.contains(host->uuid())) {
+            m_hostsByUuid.insert(host->uuid(), host);
+        }
+    });
     connect(host, &NymeaHost::nameChanged, this, [=](){
         int idx = m_hosts.indexOf(host);
         emit dataChanged(index(idx), index(idx), {NameRole});
@@ -98,6 +106,10 @@ void NymeaHosts::removeHost(NymeaHost *host)
     beginRemoveRows(QModelIndex(), idx, idx);
     m_hosts.takeAt(idx);
     endRemoveRows();
+    disconnect(host, &NymeaHost::uuidChanged, this, nullptr);
+    if (m_hostsByUuid.value(host->uuid()) == host) {
+        m_hostsByUuid.remove(host->uuid());
+    }
     emit hostRemoved(host);
     emit countChanged();
 }
@@ -141,18 +153,14 @@ NymeaHost *NymeaHosts::get(int index) const
 
 NymeaHost *NymeaHosts::find(const QUuid &uuid)
 {
-    foreach (NymeaHost *dev, m_hosts) {
-        if (dev->uuid() == uuid) {
-            return dev;
-        }
-    }
-    return nullptr;
+    return m_hostsByUuid.value(uuid);
 }
 
 void NymeaHosts::clearModel()
 {
     beginResetModel();
     m_hosts.clear();
+    m_hostsByUuid.clear();
     endResetModel();
     emit countChanged();
 }
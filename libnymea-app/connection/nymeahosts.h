@@ -80,6 +80,8 @@ protected:
 
 private:
     QList<NymeaHost*> m_hosts;
+    // Discovery merges every result by uuid, keep that lookup O(1)
+    QHash<QUuid, NymeaHost*> m_hostsByUuid;
 };
 
 class NymeaHostsFilterModel: public QSortFilterProxyModel
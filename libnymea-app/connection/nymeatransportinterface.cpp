@@ -36,3 +36,24 @@ NymeaTransportInterface::NymeaTransportInterface(QObject *parent) :
 {
 
 }
+
+void NymeaTransportInterface::setReceiveBuffer(QByteArray *buffer)
+{
+    m_receiveBuffer = buffer;
+}
+
+QByteArray *NymeaTransportInterface::receiveBuffer() const
+{
+    return m_receiveBuffer;
+}
+
+void NymeaTransportInterface::deliverData(const QByteArray &data)
+{
+    if (!m_receiveBuffer) {
+        emit dataReady(data);
+        return;
+    }
+    // Appending to an empty buffer only takes a reference on the data
+    m_receiveBuffer->append(data);
+    emit dataAppended();
+}
@@ -68,6 +68,14 @@ public:
     virtual void ignoreSslErrors(const QList<QSslError> &errors) { Q_UNUSED(errors) }
     virtual bool isEncrypted() const { return false; }
     virtual QSslCertificate serverCertificate() const { return QSslCertificate(); }
+    // Whether arbitrary bytes make it through unchanged, as opposed to UTF-8 text only.
+    virtual bool isBinarySafe() const { return false; }
+    // Whether a cached TLS session ticket has been offered to the server for this connection.
+    virtual bool sessionResumptionOffered() const { return false; }
+
+    // When set, received data is appended straight into the given buffer and announced with
+    // dataAppended() instead of being handed out as a copy in dataReady().
+    void setReceiveBuffer(QByteArray *buffer);
 
 signals:
     void connected();
@@ -75,6 +83,14 @@ signals:
     void error(QAbstractSocket::SocketError error);
     void sslErrors(const QList<QSslError> &errors);
     void dataReady(const QByteArray &data);
+    void dataAppended();
+
+protected:
+    QByteArray *receiveBuffer() const;
+    void deliverData(const QByteArray &data);
+
+private:
+    QByteArray *m_receiveBuffer = nullptr;
 };
 
 #endif // NYMEATRANSPORTINTERFACE_H
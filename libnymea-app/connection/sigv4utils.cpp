@@ -36,6 +36,21 @@
 #include <QtDebug>
 #include <QUrlQuery>
 #include <QList>
+#include <QMutex>
+
+namespace {
+struct SignatureKey {
+    QByteArray secret;
+    QByteArray date;
+    QByteArray region;
+    QByteArray service;
+    QByteArray key;
+};
+// Usually there's only one key per service in use
+static const int maxSignatureKeys = 8;
+static QMutex signatureKeyMutex;
+static QList<SignatureKey> signatureKeys;
+}
 
 SigV4Utils::SigV4Utils()
 {
@@ -102,19 +117,42 @@ QByteArray SigV4Utils::getCanonicalQueryString(const QNetworkRequest &request, c
 
 QByteArray SigV4Utils::getSignatureKey(const QByteArray &key, const QByteArray &date, const QByteArray &region, const QByteArray &service)
 {
+    QMutexLocker locker(&signatureKeyMutex);
+    foreach (const SignatureKey &signatureKey, signatureKeys) {
+        if (signatureKey.date == date && signatureKey.region == region && signatureKey.service == service && signatureKey.secret == key) {
+            return signatureKey.key;
+        }
+    }
+
     QCryptographicHash::Algorithm hashAlgorithm = QCryptographicHash::Sha256;
-    return QMessageAuthenticationCode::hash("aws4_request",
+    QByteArray signatureKey = QMessageAuthenticationCode::hash("aws4_request",
            QMessageAuthenticationCode::hash(service,
            QMessageAuthenticationCode::hash(region,
            QMessageAuthenticationCode::hash(date, "AWS4"+key,
            hashAlgorithm), hashAlgorithm), hashAlgorithm), hashAlgorithm);
+
+    // A key is only valid for its date (yyyyMMdd, so comparing works)
+    for (int i = signatureKeys.count() - 1; i >= 0; i--) {
+        if (signatureKeys.at(i).date < date) {
+            signatureKeys.removeAt(i);
+        }
+    }
+    if (signatureKeys.count() >= maxSignatureKeys) {
+        signatureKeys.removeFirst();
+    }
+    signatureKeys.append({key, date, region, service, signatureKey});
+    return signatureKey;
 }
 
-QByteArray SigV4Utils::getCanonicalRequest(QNetworkAccessManager::Operation operation, const QNetworkRequest &request, const QByteArray &payload)
+void SigV4Utils::clearSignatureKeyCache()
 {
-    QByteArray canonicalRequest;
+    QMutexLocker locker(&signatureKeyMutex);
+    signatureKeys.clear();
+}
 
-    QByteArray method;
+QByteArray SigV4Utils::getCanonicalRequest(QNetworkAccessManager::Operation operation, const QNetworkRequest &request, const QByteArray &payload)
+{
+    const char *method = nullptr;
     switch (operation) {
     case QNetworkAccessManager::GetOperation:
         method = "GET";
@@ -124,28 +162,53 @@ QByteArray SigV4Utils::getCanonicalRequest(QNetworkAccessManager::Operation oper
         break;
     default:
         Q_ASSERT_X(false, "Network operation not implemented", "SigV4Utils");
+        method = "";
     }
-    QByteArray uri = request.url().path(QUrl::FullyEncoded).toUtf8();
-    QUrlQuery query(request.url());
-    QList<QPair<QString, QString> > queryItems = query.queryItems();
+
+    const QUrl url = request.url();
     QStringList queryItemStrings;
-    for (int i = 0; i < queryItems.count(); i++) {
-        QPair<QString, QString> queryItem = queryItems.at(i);
-        queryItemStrings.append(queryItem.first + '=' + queryItem.second);
+    if (url.hasQuery()) {
+        const QList<QPair<QString, QString> > queryItems = QUrlQuery(url).queryItems();
+        queryItemStrings.reserve(queryItems.count());
+        for (int i = 0; i < queryItems.count(); i++) {
+            const QPair<QString, QString> &queryItem = queryItems.at(i);
+            queryItemStrings.append(queryItem.first + '=' + queryItem.second);
+        }
+        queryItemStrings.sort(Qt::CaseInsensitive);
     }
-    queryItemStrings.sort(Qt::CaseInsensitive);
 
-    QByteArray canonicalQueryString = queryItemStrings.join('&').toUtf8();
+    const QByteArray uri = url.path(QUrl::FullyEncoded).toUtf8();
+    const QByteArray canonicalQueryString = queryItemStrings.join('&').toUtf8();
+    const QByteArray canonicalHeaders = getCanonicalHeaders(request);
+    const QByteArray signedHeaders = getSignedHeaders(request);
 
+    QByteArray canonicalRequest;
+    // 64 for the payload hash, 5 separators
+    canonicalRequest.reserve(static_cast<int>(qstrlen(method)) + uri.length() + canonicalQueryString.length() + canonicalHeaders.length() + signedHeaders.length() + 64 + 5);
+    canonicalRequest.append(method).append('\n')
+            .append(uri).append('\n')
+            .append(canonicalQueryString).append('\n')
+            .append(canonicalHeaders).append('\n')
+            .append(signedHeaders).append('\n')
+            .append(QCryptographicHash::hash(payload, QCryptographicHash::Sha256).toHex());
+    return canonicalRequest;
+}
+
+QByteArray SigV4Utils::getCanonicalHeaders(const QNetworkRequest &request)
+{
+    const QList<QByteArray> headerNames = request.rawHeaderList();
     QByteArray canonicalHeaders;
-    foreach(const QByteArray &headerName, request.rawHeaderList()) {
-        canonicalHeaders += headerName.toLower() + ':' + request.rawHeader(headerName) + '\n';
+    // Typical headers are host, content type, date and the session token
+    canonicalHeaders.reserve(headerNames.count() * 64);
+    foreach (const QByteArray &headerName, headerNames) {
+        canonicalHeaders.append(headerName.toLower()).append(':').append(request.rawHeader(headerName)).append('\n');
     }
+    return canonicalHeaders;
+}
 
-    QByteArray payloadHash = QCryptographicHash::hash(payload, QCryptographicHash::Sha256).toHex();
-
-    canonicalRequest = method + '\n' + uri + '\n' + canonicalQueryString + '\n' + canonicalHeaders + '\n' + request.rawHeaderList().join(';').toLower() + '\n' + payloadHash;
-    return canonicalRequest;
+QByteArray SigV4Utils::getSignedHeaders(const QNetworkRequest &request)
+{
+    return request.rawHeaderList().join(';').toLower();
 }
 
 QByteArray SigV4Utils::getCredentialScope(const QByteArray &dateTime, const QByteArray &region, const QByteArray &service)
@@ -156,10 +219,17 @@ QByteArray SigV4Utils::getCredentialScope(const QByteArray &dateTime, const QByt
 
 QByteArray SigV4Utils::getStringToSign(const QByteArray &canonicalRequest, const QByteArray &dateTime, const QByteArray &region, const QByteArray &service)
 {
-    QByteArray algorithm = "AWS4-HMAC-SHA256";
-    QByteArray credentialScope = getCredentialScope(dateTime, region, service);
+    static const QByteArray algorithm = "AWS4-HMAC-SHA256";
+
+    const QByteArray credentialScope = getCredentialScope(dateTime, region, service);
 
-    QByteArray stringToSign = algorithm + '\n' + dateTime + '\n' + credentialScope + '\n' + QCryptographicHash::hash(canonicalRequest, QCryptographicHash::Sha256).toHex();
+    QByteArray stringToSign;
+    // 64 for the hash, 3 separators
+    stringToSign.reserve(algorithm.length() + dateTime.length() + credentialScope.length() + 64 + 3);
+    stringToSign.append(algorithm).append('\n')
+            .append(dateTime).append('\n')
+            .append(credentialScope).append('\n')
+            .append(QCryptographicHash::hash(canonicalRequest, QCryptographicHash::Sha256).toHex());
     return stringToSign;
 }
 
@@ -172,6 +242,11 @@ QByteArray SigV4Utils::getSignature(const QByteArray &stringToSign, const QByteA
 
 QByteArray SigV4Utils::getAuthorizationHeader(const QByteArray &accessKeyId, const QByteArray &dateTime, const QString &region, const QString &service, const QNetworkRequest &request, const QByteArray &signature)
 {
-    QByteArray authHeader = "AWS4-HMAC-SHA256 Credential=" + accessKeyId + '/' + dateTime.left(8) + '/' + region.toUtf8() + '/' + service.toUtf8() + '/' + "aws4_request, SignedHeaders=" + request.rawHeaderList().join(';').toLower() + ", Signature=" + signature;
+    QByteArray authHeader;
+    authHeader.reserve(128 + accessKeyId.length() + signature.length());
+    authHeader.append("AWS4-HMAC-SHA256 Credential=").append(accessKeyId).append('/')
+            .append(getCredentialScope(dateTime, region.toUtf8(), service.toUtf8()))
+            .append(", SignedHeaders=").append(getSignedHeaders(request))
+            .append(", Signature=").append(signature);
     return authHeader;
 }
@@ -50,9 +50,12 @@ public:
     static QByteArray getCanonicalQueryString(const QNetworkRequest &request, const QByteArray &accessKeyId, const QByteArray &secretAccessKey, const QByteArray &sessionToken, const QByteArray &region, const QByteArray &service, const QByteArray &payload);
     static QByteArray getCanonicalRequest(QNetworkAccessManager::Operation operation, const QNetworkRequest &request, const QByteArray &payload);
     static QByteArray getCanonicalHeaders(const QNetworkRequest &request);
+    static QByteArray getSignedHeaders(const QNetworkRequest &request);
     static QByteArray getCredentialScope(const QByteArray &dateTime, const QByteArray &region, const QByteArray &service);
     static QByteArray getStringToSign(const QByteArray &canonicalRequest, const QByteArray &dateTime, const QByteArray &region, const QByteArray &service);
+    // Derived keys are cached per secret, date, region and service. Keys of past dates are dropped once a newer date is used.
     static QByteArray getSignatureKey(const QByteArray &key, const QByteArray &date, const QByteArray &region, const QByteArray &service);
+    static void clearSignatureKeyCache();
     static QByteArray getSignature(const QByteArray &stringToSign, const QByteArray &secretAccessKey, const QByteArray &dateTime, const QString &region, const QString &service);
     static QByteArray getAuthorizationHeader(const QByteArray &accessKeyId, const QByteArray &dateTime, const QString &region, const QString &service, const QNetworkRequest &request, const QByteArray &signature);
 
@@ -33,6 +33,9 @@
 #include <QUrl>
 #include <QSslConfiguration>
 
+#include "sslsessioncache.h"
+#include "startuptimeline.h"
+
 #include "logging.h"
 
 NYMEA_LOGGING_CATEGORY(dcTcpTransport, "TcpTransport")
@@ -45,7 +48,13 @@ TcpSocketTransport::TcpSocketTransport(QObject *parent) : NymeaTransportInterfac
     QObject::connect(&m_socket, static_cast<sslErrorsSignal>(&QSslSocket::sslErrors), this, &TcpSocketTransport::sslErrors);
     QObject::connect(&m_socket, &QSslSocket::readyRead, this, &TcpSocketTransport::socketReadyRead);
     typedef void (QSslSocket:: *errorSignal)(QAbstractSocket::SocketError);
-    QObject::connect(&m_socket, static_cast<errorSignal>(&QSslSocket::error), this, &TcpSocketTransport::error);
+    QObject::connect(&m_socket, static_cast<errorSignal>(&QSslSocket::error), this, &TcpSocketTransport::onError);
+#if (QT_VERSION >= QT_VERSION_CHECK(5, 15, 0))
+    // With TLS 1.3 the ticket arrives after the handshake
+    QObject::connect(&m_socket, &QSslSocket::newSessionTicketReceived, this, [this](){
+        SslSessionCache::storeTicket(m_url, m_socket.sslConfiguration().sessionTicket());
+    });
+#endif
     QObject::connect(&m_socket, &QSslSocket::stateChanged, this, &TcpSocketTransport::onSocketStateChanged);
 
 }
@@ -73,8 +82,19 @@ QSslCertificate TcpSocketTransport::serverCertificate() const
     return m_socket.peerCertificate();
 }
 
+bool TcpSocketTransport::isBinarySafe() const
+{
+    return true;
+}
+
+bool TcpSocketTransport::sessionResumptionOffered() const
+{
+    return m_sessionResumptionOffered;
+}
+
 void TcpSocketTransport::onConnected()
 {
+    StartupTimeline::mark("TCP connected");
     if (m_url.scheme() == "nymea") {
         qCDebug(dcTcpTransport()) << "TCP socket connected";
         emit connected();
@@ -83,14 +103,32 @@ void TcpSocketTransport::onConnected()
 
 void TcpSocketTransport::onEncrypted()
 {
-    qDebug() << "TCP socket encrypted";
+    qCDebug(dcTcpTransport()) << "TCP socket encrypted" << (m_sessionResumptionOffered ? "(session resumption offered)" : "");
+    SslSessionCache::storeTicket(m_url, m_socket.sslConfiguration().sessionTicket());
+    StartupTimeline::mark("TLS established");
     emit connected();
 }
 
+void TcpSocketTransport::onError(QAbstractSocket::SocketError error)
+{
+    if (error == QAbstractSocket::SslHandshakeFailedError && m_sessionResumptionOffered) {
+        // Don't keep offering a ticket the server doesn't like
+        SslSessionCache::dropTicket(m_url);
+    }
+    emit this->error(error);
+}
+
 bool TcpSocketTransport::connect(const QUrl &url)
 {
     m_url = url;
     if (url.scheme() == "nymeas") {
+        QSslConfiguration sslConfiguration = m_socket.sslConfiguration();
+        sslConfiguration.setSslOption(QSsl::SslOptionDisableSessionPersistence, false);
+        QByteArray sessionTicket = SslSessionCache::ticket(url);
+        sslConfiguration.setSessionTicket(sessionTicket);
+        m_sessionResumptionOffered = !sessionTicket.isEmpty();
+        m_socket.setSslConfiguration(sslConfiguration);
+
         qCDebug(dcTcpTransport()) << "TCP socket connecting to" << url.host() << url.port();
         m_socket.connectToHostEncrypted(url.host(), static_cast<quint16>(url.port()));
         return true;
@@ -133,8 +171,20 @@ void TcpSocketTransport::disconnect()
 
 void TcpSocketTransport::socketReadyRead()
 {
-    QByteArray data = m_socket.readAll();
-    emit dataReady(data);
+    QByteArray *buffer = receiveBuffer();
+    if (!buffer) {
+        emit dataReady(m_socket.readAll());
+        return;
+    }
+    // Read straight into the decoder's buffer, one notification per burst
+    int oldSize = buffer->size();
+    qint64 available = m_socket.bytesAvailable();
+    buffer->resize(oldSize + static_cast<int>(available));
+    qint64 read = m_socket.read(buffer->data() + oldSize, available);
+    buffer->resize(oldSize + static_cast<int>(qMax(read, Q_INT64_C(0))));
+    if (read > 0) {
+        emit dataAppended();
+    }
 }
 
 void TcpSocketTransport::onSocketStateChanged(const QAbstractSocket::SocketState &state)
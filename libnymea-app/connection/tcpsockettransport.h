@@ -58,16 +58,20 @@ public:
     void ignoreSslErrors(const QList<QSslError> &errors) override;
     bool isEncrypted() const override;
     QSslCertificate serverCertificate() const override;
+    bool isBinarySafe() const override;
+    bool sessionResumptionOffered() const override;
 
 private slots:
     void onConnected();
     void onEncrypted();
+    void onError(QAbstractSocket::SocketError error);
     void socketReadyRead();
     void onSocketStateChanged(const QAbstractSocket::SocketState &state);
 
 private:
     QSslSocket m_socket;
     QUrl m_url;
+    bool m_sessionResumptionOffered = false;
 };
 
 #endif // TCPSOCKETTRANSPROT_H
@@ -34,17 +34,31 @@
 #include <QJsonDocument>
 #include <QJsonParseError>
 #include <QSettings>
+#include <QNetworkRequest>
+#include <QSslConfiguration>
+
+#include "sslsessioncache.h"
+
+#include "logging.h"
+
+NYMEA_LOGGING_CATEGORY(dcWebSocketTransport, "WebSocketTransport")
+
+// Advertised to the server in the handshake. Servers not knowing it just ignore it and keep talking text.
+static const QByteArray binaryProtocol = "nymea-binary";
+// Messages larger than this are compressed in binary mode. Smaller ones aren't worth the CPU time.
+static const int compressionThreshold = 4096;
 
 WebsocketTransport::WebsocketTransport(QObject *parent) :
     NymeaTransportInterface(parent)
 {
     m_socket = new QWebSocket(QCoreApplication::applicationName(), QWebSocketProtocol::VersionLatest, this);
 
-    QObject::connect(m_socket, &QWebSocket::connected, this, &WebsocketTransport::connected);
+    QObject::connect(m_socket, &QWebSocket::connected, this, &WebsocketTransport::onConnected);
     QObject::connect(m_socket, &QWebSocket::disconnected, this, &WebsocketTransport::disconnected);
     typedef void (QWebSocket:: *errorSignal)(QAbstractSocket::SocketError);
-    QObject::connect(m_socket, static_cast<errorSignal>(&QWebSocket::error), this, &WebsocketTransport::error);
+    QObject::connect(m_socket, static_cast<errorSignal>(&QWebSocket::error), this, &WebsocketTransport::onError);
     QObject::connect(m_socket, &QWebSocket::textMessageReceived, this, &WebsocketTransport::onTextMessageReceived);
+    QObject::connect(m_socket, &QWebSocket::binaryMessageReceived, this, &WebsocketTransport::onBinaryMessageReceived);
 
     typedef void (QWebSocket:: *sslErrorsSignal)(const QList<QSslError> &);
     QObject::connect(m_socket, static_cast<sslErrorsSignal>(&QWebSocket::sslErrors),this, &WebsocketTransport::sslErrors);
@@ -53,7 +67,19 @@ WebsocketTransport::WebsocketTransport(QObject *parent) :
 bool WebsocketTransport::connect(const QUrl &url)
 {
     m_url = url;
-    m_socket->open(QUrl(url));
+    m_binaryMode = false;
+    m_sessionResumptionOffered = false;
+    if (url.scheme() == "wss") {
+        QSslConfiguration sslConfiguration = m_socket->sslConfiguration();
+        sslConfiguration.setSslOption(QSsl::SslOptionDisableSessionPersistence, false);
+        QByteArray sessionTicket = SslSessionCache::ticket(url);
+        sslConfiguration.setSessionTicket(sessionTicket);
+        m_sessionResumptionOffered = !sessionTicket.isEmpty();
+        m_socket->setSslConfiguration(sslConfiguration);
+    }
+    QNetworkRequest request(url);
+    request.setRawHeader("Sec-WebSocket-Protocol", binaryProtocol);
+    m_socket->open(request);
     return true;
 }
 
@@ -84,7 +110,22 @@ void WebsocketTransport::disconnect()
 
 void WebsocketTransport::sendData(const QByteArray &data)
 {
-    m_socket->sendTextMessage(QString::fromUtf8(data));
+    if (!m_binaryMode) {
+        m_socket->sendTextMessage(QString::fromUtf8(data));
+        return;
+    }
+    QByteArray frame;
+    if (data.size() > compressionThreshold) {
+        QByteArray compressed = qCompress(data);
+        frame.reserve(compressed.size() + 1);
+        frame.append(static_cast<char>(FrameTypeCompressed));
+        frame.append(compressed);
+    } else {
+        frame.reserve(data.size() + 1);
+        frame.append(static_cast<char>(data.startsWith('{') ? FrameTypeJson : FrameTypeCbor));
+        frame.append(data);
+    }
+    m_socket->sendBinaryMessage(frame);
 }
 
 void WebsocketTransport::ignoreSslErrors(const QList<QSslError> &errors)
@@ -109,9 +150,67 @@ QSslCertificate WebsocketTransport::serverCertificate() const
     return m_socket->sslConfiguration().peerCertificate();
 }
 
+bool WebsocketTransport::isBinarySafe() const
+{
+    return m_binaryMode;
+}
+
+bool WebsocketTransport::sessionResumptionOffered() const
+{
+    return m_sessionResumptionOffered;
+}
+
+void WebsocketTransport::onConnected()
+{
+    if (isEncrypted()) {
+        SslSessionCache::storeTicket(m_url, m_socket->sslConfiguration().sessionTicket());
+    }
+    emit connected();
+}
+
+void WebsocketTransport::onError(QAbstractSocket::SocketError error)
+{
+    if (error == QAbstractSocket::SslHandshakeFailedError && m_sessionResumptionOffered) {
+        SslSessionCache::dropTicket(m_url);
+    }
+    emit this->error(error);
+}
+
 void WebsocketTransport::onTextMessageReceived(const QString &data)
 {
-    emit dataReady(data.toUtf8());
+    deliverData(data.toUtf8());
+}
+
+void WebsocketTransport::onBinaryMessageReceived(const QByteArray &data)
+{
+    if (!m_binaryMode) {
+        qCDebug(dcWebSocketTransport()) << "Server sent a binary frame. Switching to binary mode.";
+        m_binaryMode = true;
+    }
+
+    if (data.isEmpty()) {
+        qCWarning(dcWebSocketTransport()) << "Dropping empty binary frame";
+        return;
+    }
+
+    switch (data.at(0)) {
+    case FrameTypeJson:
+    case FrameTypeCbor:
+        // The decoder tells JSON and CBOR apart by itself
+        deliverData(data.mid(1));
+        return;
+    case FrameTypeCompressed: {
+        QByteArray uncompressed = qUncompress(reinterpret_cast<const uchar*>(data.constData() + 1), data.size() - 1);
+        if (uncompressed.isEmpty()) {
+            qCWarning(dcWebSocketTransport()) << "Dropping invalid compressed frame of" << data.size() << "bytes";
+            return;
+        }
+        deliverData(uncompressed);
+        return;
+    }
+    default:
+        qCWarning(dcWebSocketTransport()) << "Dropping binary frame of unknown type" << static_cast<int>(data.at(0));
+    }
 }
 
 NymeaTransportInterface *WebsocketTransportFactory::createTransport(QObject *parent) const
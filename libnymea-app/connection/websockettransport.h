@@ -58,13 +58,29 @@ public:
 
     bool isEncrypted() const override;
     QSslCertificate serverCertificate() const override;
+    bool isBinarySafe() const override;
+    bool sessionResumptionOffered() const override;
 
 private:
     QUrl m_url;
     QWebSocket *m_socket;
 
+    // Text frames are what every nymea core understands. Once the server sends binary frames itself,
+    // we answer in kind. Each binary frame starts with one of these bytes telling how to read the rest.
+    enum FrameType {
+        FrameTypeJson = 0x01,
+        FrameTypeCbor = 0x02,
+        // qCompress()ed JSON or CBOR
+        FrameTypeCompressed = 0x03
+    };
+    bool m_binaryMode = false;
+    bool m_sessionResumptionOffered = false;
+
 private slots:
     void onTextMessageReceived(const QString &data);
+    void onBinaryMessageReceived(const QByteArray &data);
+    void onConnected();
+    void onError(QAbstractSocket::SocketError error);
 };
 
 #endif // WEBSOCKETTRANSPORT_H
@@ -1,6 +1,11 @@
 #include "energylogs.h"
 
 #include <QMetaEnum>
+#include <QDate>
+
+#include <algorithm>
+
+#include "memorystats.h"
 
 #include "logging.h"
 NYMEA_LOGGING_CATEGORY(dcEnergyLogs, "EnergyLogs")
@@ -25,6 +30,7 @@ QDateTime EnergyLogEntry::timestamp() const
 
 EnergyLogs::EnergyLogs(QObject *parent) : QAbstractListModel(parent)
 {
+    MemoryStats::registerModel(this, [this](){ return estimatedSize(); });
 }
 
 EnergyLogs::~EnergyLogs()
@@ -190,15 +196,19 @@ void EnergyLogs::appendEntry(EnergyLogEntry *entry)
 
 void EnergyLogs::appendEntries(const QList<EnergyLogEntry *> &entries)
 {
-    beginInsertRows(QModelIndex(), m_list.count(), m_list.count() + entries.count());
+    if (entries.isEmpty()) {
+        return;
+    }
+    // Only notify once for the whole block. Use entriesAdded() to process them, entryAdded() is emitted for single entries only.
+    beginInsertRows(QModelIndex(), m_list.count(), m_list.count() + entries.count() - 1);
+    m_list.reserve(m_list.count() + entries.count());
     foreach (EnergyLogEntry* entry, entries) {
         entry->setParent(this);
         m_list.append(entry);
-        emit entryAdded(entry);
     }
     endInsertRows();
-    emit entriesAdded(entries);
     emit countChanged();
+    emit entriesAdded(entries);
 }
 
 QVariantMap EnergyLogs::fetchParams() const
@@ -206,11 +216,103 @@ QVariantMap EnergyLogs::fetchParams() const
     return QVariantMap();
 }
 
+QString EnergyLogs::entriesKey() const
+{
+    return QString();
+}
+
+QString EnergyLogs::entryKey() const
+{
+    return QString();
+}
+
+QString EnergyLogs::groupingKey() const
+{
+    return QString();
+}
+
+QStringList EnergyLogs::averagedFields() const
+{
+    return QStringList();
+}
+
+QDateTime EnergyLogs::sampleTimestamp(const QDateTime &timestamp, SampleRate sampleRate)
+{
+    // Samples are timestamped at their end, aligned to local time
+    QDateTime startOfDay = QDateTime(timestamp.date(), QTime(0, 0));
+    bool onMidnight = timestamp == startOfDay;
+    switch (sampleRate) {
+    case SampleRate1Week: {
+        if (onMidnight && timestamp.date().dayOfWeek() == Qt::Monday) {
+            return timestamp;
+        }
+        return startOfDay.addDays(8 - timestamp.date().dayOfWeek());
+    }
+    case SampleRate1Month: {
+        if (onMidnight && timestamp.date().day() == 1) {
+            return timestamp;
+        }
+        return QDateTime(QDate(timestamp.date().year(), timestamp.date().month(), 1).addMonths(1), QTime(0, 0));
+    }
+    case SampleRate1Year: {
+        if (onMidnight && timestamp.date().dayOfYear() == 1) {
+            return timestamp;
+        }
+        return QDateTime(QDate(timestamp.date().year() + 1, 1, 1), QTime(0, 0));
+    }
+    default: {
+        qint64 sampleSize = static_cast<qint64>(sampleRate) * 60;
+        int offset = timestamp.offsetFromUtc();
+        qint64 localSecs = timestamp.toSecsSinceEpoch() + offset;
+        qint64 remainder = localSecs % sampleSize;
+        if (remainder != 0) {
+            localSecs += sampleSize - remainder;
+        }
+        return QDateTime::fromSecsSinceEpoch(localSecs - offset);
+    }
+    }
+}
+
 void EnergyLogs::getLogsResponse(int commandId, const QVariantMap &params)
 {
-    Q_UNUSED(commandId)
 //    qCDebug(dcEnergyLogs()) << "Energy logs response:" << params;
-    logEntriesReceived(params);
+    PendingFetch fetch = m_pendingFetches.take(commandId);
+    if (fetch.cacheFill) {
+        // The cache may have been replaced while this was pending
+        if (fetch.sampleRate == m_cacheSampleRate && fetch.params == m_cacheParams && fetch.to == m_cacheFrom) {
+            // Prepend what we've been missing and roll up the complete range
+            QVariantList olderEntries;
+            foreach (const QVariant &entry, params.value(entriesKey()).toList()) {
+                if (m_cacheFrom.isNull() || entry.toMap().value("timestamp").toLongLong() < m_cacheFrom.toSecsSinceEpoch()) {
+                    olderEntries.append(entry);
+                }
+            }
+            m_cache = olderEntries + m_cache;
+            m_cacheFrom = fetch.from;
+        }
+        if (!cacheCovers(m_sampleRate)) {
+            qCDebug(dcEnergyLogs()) << "Discarding outdated" << logsName() << "cache fill";
+            return;
+        }
+
+        QVariantMap rolledUp;
+        rolledUp.insert(entriesKey(), rollUp(m_sampleRate));
+        logEntriesReceived(rolledUp);
+    } else {
+        if (!entriesKey().isEmpty() && replacesCache(fetch)) {
+            m_cache = params.value(entriesKey()).toList();
+            m_cacheSampleRate = fetch.sampleRate;
+            m_cacheParams = fetch.params;
+            m_cacheFrom = fetch.from;
+            m_cacheTo = fetch.to;
+        }
+        if (fetch.sampleRate != m_sampleRate || fetch.params != fetchParams()) {
+            // Asked for before the sample rate or things changed. Good for the cache, but not what's on display anymore.
+            qCDebug(dcEnergyLogs()) << "Discarding outdated" << logsName() << "reply";
+            return;
+        }
+        logEntriesReceived(params);
+    }
 
     m_fetchingData = false;
     emit fetchingDataChanged();
@@ -218,6 +320,20 @@ void EnergyLogs::getLogsResponse(int commandId, const QVariantMap &params)
 
 void EnergyLogs::notificationReceivedInternal(const QVariantMap &data)
 {
+    // Keep the cache up to date, regardless of what's being displayed
+    if (!m_cache.isEmpty() && m_cacheTo.isNull() && !entryKey().isEmpty()) {
+        QVariantMap params = data.value("params").toMap();
+        QMetaEnum metaEnum = QMetaEnum::fromType<SampleRate>();
+        if (params.contains(entryKey()) && params.value("sampleRate").toByteArray() == metaEnum.valueToKey(m_cacheSampleRate)) {
+            QVariantMap entry = params.value(entryKey()).toMap();
+            // Fetch params filter by the plural of the grouping key, e.g. thingIds
+            QString grouping = groupingKey();
+            QVariantList groups = m_cacheParams.value(grouping + "s").toList();
+            if (grouping.isEmpty() || groups.isEmpty() || groups.contains(entry.value(grouping).toUuid().toString())) {
+                m_cache.append(entry);
+            }
+        }
+    }
 
     if (!m_live) {
         return;
@@ -239,6 +355,20 @@ void EnergyLogs::fetchLogs()
     m_fetchingData = true;
     fetchingDataChanged();
 
+    if (cacheCovers(m_sampleRate)) {
+        qCDebug(dcEnergyLogs()) << "Rolling up" << logsName() << "from cached samples";
+        QVariantMap params;
+        params.insert(entriesKey(), rollUp(m_sampleRate));
+        logEntriesReceived(params);
+        m_fetchingData = false;
+        emit fetchingDataChanged();
+        return;
+    }
+
+    if (fillCache()) {
+        return;
+    }
+
     QVariantMap params = fetchParams();
     QMetaEnum metaEnum = QMetaEnum::fromType<SampleRate>();
     params.insert("sampleRate", metaEnum.valueToKey(m_sampleRate));
@@ -249,6 +379,169 @@ void EnergyLogs::fetchLogs()
         params.insert("to", m_endTime.toSecsSinceEpoch());
     }
     qCDebug(dcEnergyLogs()) << "Fetching power balance logs" << params;
-    m_engine->jsonRpcClient()->sendCommand("Energy.Get" + logsName(), params, this, "getLogsResponse");
+    int commandId = m_engine->jsonRpcClient()->sendCommand("Energy.Get" + logsName(), params, this, "getLogsResponse");
+
+    PendingFetch fetch;
+    fetch.sampleRate = m_sampleRate;
+    fetch.params = fetchParams();
+    fetch.from = m_startTime;
+    fetch.to = m_live ? QDateTime() : (m_endTime.isNull() ? QDateTime::currentDateTime() : m_endTime);
+    m_pendingFetches.insert(commandId, fetch);
+}
+
+bool EnergyLogs::cacheCovers(SampleRate sampleRate) const
+{
+    if (entriesKey().isEmpty() || m_cache.isEmpty() || m_cacheSampleRate > sampleRate || m_cacheParams != fetchParams()) {
+        return false;
+    }
+    if (!m_cacheFrom.isNull() && (m_startTime.isNull() || m_startTime < m_cacheFrom)) {
+        return false;
+    }
+    if (!m_cacheTo.isNull() && (m_endTime.isNull() || m_endTime > m_cacheTo)) {
+        return false;
+    }
+    return true;
+}
+
+bool EnergyLogs::fillCache()
+{
+    // Only the start is missing. Fetch the gap in the cache's resolution unless that would be a lot more than fetching the requested one
+    if (entriesKey().isEmpty() || m_cache.isEmpty() || m_cacheSampleRate > m_sampleRate || m_cacheParams != fetchParams()) {
+        return false;
+    }
+    if (m_cacheFrom.isNull() || m_startTime.isNull() || m_startTime >= m_cacheFrom) {
+        return false;
+    }
+    if (!m_cacheTo.isNull() && (m_endTime.isNull() || m_endTime > m_cacheTo)) {
+        return false;
+    }
+    qint64 missingSamples = m_startTime.secsTo(m_cacheFrom) / (static_cast<qint64>(m_cacheSampleRate) * 60);
+    if (missingSamples > 2000) {
+        return false;
+    }
+
+    QVariantMap params = fetchParams();
+    QMetaEnum metaEnum = QMetaEnum::fromType<SampleRate>();
+    params.insert("sampleRate", metaEnum.valueToKey(m_cacheSampleRate));
+    params.insert("from", m_startTime.toSecsSinceEpoch());
+    params.insert("to", m_cacheFrom.toSecsSinceEpoch());
+    params.remove("includeCurrent");
+    qCDebug(dcEnergyLogs()) << "Fetching missing" << logsName() << "samples for the cache" << params;
+    int commandId = m_engine->jsonRpcClient()->sendCommand("Energy.Get" + logsName(), params, this, "getLogsResponse");
+
+    PendingFetch fetch;
+    fetch.sampleRate = m_cacheSampleRate;
+    fetch.params = m_cacheParams;
+    fetch.from = m_startTime;
+    fetch.to = m_cacheFrom;
+    fetch.cacheFill = true;
+    m_pendingFetches.insert(commandId, fetch);
+    return true;
 }
 
+bool EnergyLogs::replacesCache(const PendingFetch &fetch) const
+{
+    // Rollups need the finest samples we have. Only give them up for ones at least as fine covering at least the same range.
+    if (m_cache.isEmpty() || fetch.params != m_cacheParams) {
+        return true;
+    }
+    if (fetch.sampleRate > m_cacheSampleRate) {
+        return false;
+    }
+    if (!fetch.from.isNull() && (m_cacheFrom.isNull() || fetch.from > m_cacheFrom)) {
+        return false;
+    }
+    if (!fetch.to.isNull() && (m_cacheTo.isNull() || fetch.to < m_cacheTo)) {
+        return false;
+    }
+    return true;
+}
+
+QVariantList EnergyLogs::rollUp(SampleRate sampleRate) const
+{
+    if (sampleRate == m_cacheSampleRate) {
+        QVariantList ret;
+        foreach (const QVariant &variant, m_cache) {
+            QDateTime timestamp = QDateTime::fromSecsSinceEpoch(variant.toMap().value("timestamp").toLongLong());
+            if ((m_startTime.isNull() || timestamp >= m_startTime) && (m_endTime.isNull() || timestamp <= m_endTime)) {
+                ret.append(variant);
+            }
+        }
+        return ret;
+    }
+
+    class Sample {
+    public:
+        qint64 timestamp = 0;
+        QVariantMap last;
+        QHash<QString, double> sums;
+        int count = 0;
+    };
+
+    const QStringList averaged = averagedFields();
+    const QString grouping = groupingKey();
+    QDateTime now = QDateTime::currentDateTime();
+    QHash<QString, Sample> openSamples;
+    QList<QPair<qint64, QVariantMap>> samples;
+
+    auto finalize = [&](const Sample &sample) {
+        QDateTime timestamp = QDateTime::fromSecsSinceEpoch(sample.timestamp);
+        // Incomplete samples are not available from the server either
+        if (timestamp > now) {
+            return;
+        }
+        if ((!m_startTime.isNull() && timestamp < m_startTime) || (!m_endTime.isNull() && timestamp > m_endTime)) {
+            return;
+        }
+        QVariantMap map = sample.last;
+        map.insert("timestamp", sample.timestamp);
+        foreach (const QString &field, averaged) {
+            map.insert(field, sample.sums.value(field) / sample.count);
+        }
+        samples.append(qMakePair(sample.timestamp, map));
+    };
+
+    foreach (const QVariant &variant, m_cache) {
+        QVariantMap map = variant.toMap();
+        QString group = grouping.isEmpty() ? QString() : map.value(grouping).toString();
+        qint64 timestamp = sampleTimestamp(QDateTime::fromSecsSinceEpoch(map.value("timestamp").toLongLong()), sampleRate).toSecsSinceEpoch();
+
+        Sample &sample = openSamples[group];
+        if (sample.count > 0 && sample.timestamp != timestamp) {
+            finalize(sample);
+            sample = Sample();
+        }
+        sample.timestamp = timestamp;
+        sample.last = map;
+        foreach (const QString &field, averaged) {
+            sample.sums[field] += map.value(field).toDouble();
+        }
+        sample.count++;
+    }
+    foreach (const Sample &sample, openSamples) {
+        if (sample.count > 0) {
+            finalize(sample);
+        }
+    }
+
+    std::stable_sort(samples.begin(), samples.end(), [](const QPair<qint64, QVariantMap> &a, const QPair<qint64, QVariantMap> &b) {
+        return a.first < b.first;
+    });
+    QVariantList ret;
+    ret.reserve(samples.count());
+    for (int i = 0; i < samples.count(); i++) {
+        ret.append(samples.at(i).second);
+    }
+    return ret;
+}
+
+qint64 EnergyLogs::estimatedSize() const
+{
+    // Subclasses add a handful of doubles to the entries, 6 covers the largest one
+    qint64 size = m_list.count() * (sizeof(EnergyLogEntry*) + MemoryStats::objectSize(sizeof(EnergyLogEntry) + 6 * sizeof(double)));
+    if (!m_cache.isEmpty()) {
+        // The cached entries all have the same shape
+        size += m_cache.count() * (sizeof(QVariant) + MemoryStats::variantMapSize(m_cache.first().toMap()));
+    }
+    return size;
+}
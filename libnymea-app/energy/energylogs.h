@@ -7,8 +7,9 @@
 #include <QUuid>
 #include <QQmlParserStatus>
 
+#include "types/instancecounter.h"
 
-class EnergyLogEntry: public QObject
+class EnergyLogEntry: public QObject, private InstanceCounter<InstanceCounters::TypeEnergyLogEntry>
 {
     Q_OBJECT
     Q_PROPERTY(QDateTime timestamp READ timestamp CONSTANT)
@@ -79,6 +80,9 @@ public:
 
     Q_INVOKABLE EnergyLogEntry* get(int index) const;
 
+    // bytes held by the entries and the rollup cache
+    virtual qint64 estimatedSize() const;
+
 signals:
     void engineChanged();
     void sampleRateChanged();
@@ -100,14 +104,42 @@ protected:
     virtual void logEntriesReceived(const QVariantMap &params) = 0;
     virtual void notificationReceived(const QVariantMap &data) = 0;
 
+    // Client side rollups: The finest fetched sample rate is cached and coarser sample rates are
+    // derived from it locally. Subclasses opt in by returning the key of their entries in replies
+    // and notifications. Averaged fields are averaged over a sample, all others (the energy counters)
+    // take the value at the end of the sample.
+    virtual QString entriesKey() const;
+    virtual QString entryKey() const;
+    virtual QString groupingKey() const;
+    virtual QStringList averagedFields() const;
+
     void appendEntry(EnergyLogEntry *entry);
     void appendEntries(const QList<EnergyLogEntry *> &entries);
 
+    static QDateTime sampleTimestamp(const QDateTime &timestamp, SampleRate sampleRate);
+
 private slots:
     void getLogsResponse(int commandId, const QVariantMap &params);
     void notificationReceivedInternal(const QVariantMap &data);
 
     void fetchLogs();
+
+private:
+    // What each pending request asked for, replies are matched by command id
+    struct PendingFetch {
+        SampleRate sampleRate = SampleRate1Min;
+        QVariantMap params;
+        QDateTime from;
+        QDateTime to;
+        // Fetches the samples missing at the start of the cache
+        bool cacheFill = false;
+    };
+
+    bool cacheCovers(SampleRate sampleRate) const;
+    bool replacesCache(const PendingFetch &fetch) const;
+    bool fillCache();
+    QVariantList rollUp(SampleRate sampleRate) const;
+
 private:
     Engine *m_engine = nullptr;
     SampleRate m_sampleRate = SampleRate15Mins;
@@ -121,6 +153,14 @@ private:
     bool m_ready = false;
 
     QList<EnergyLogEntry*> m_list;
+
+    QVariantList m_cache; // raw entries, sorted by timestamp
+    SampleRate m_cacheSampleRate = SampleRate1Min;
+    QVariantMap m_cacheParams;
+    QDateTime m_cacheFrom; // null if fetched from the beginning
+    QDateTime m_cacheTo; // null if open ended and kept up to date by notifications
+
+    QHash<int, PendingFetch> m_pendingFetches;
 };
 
 #endif // ENERGYLOGS_H
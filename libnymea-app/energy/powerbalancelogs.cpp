@@ -81,101 +81,85 @@ QString PowerBalanceLogs::logsName() const
     return "PowerBalanceLogs";
 }
 
+QString PowerBalanceLogs::entriesKey() const
+{
+    return "powerBalanceLogEntries";
+}
+
+QString PowerBalanceLogs::entryKey() const
+{
+    return "powerBalanceLogEntry";
+}
+
+QStringList PowerBalanceLogs::averagedFields() const
+{
+    return {"consumption", "production", "acquisition", "storage"};
+}
+
 void PowerBalanceLogs::addEntry(PowerBalanceLogEntry *entry)
 {
-    if (entry->consumption() < m_minValue) {
-        m_minValue = entry->consumption();
-        emit minValueChanged();
-    }
-    if (entry->consumption() > m_maxValue) {
-        m_maxValue = entry->consumption();
-        emit maxValueChanged();
-    }
+    updateMinMax(entry);
+    appendEntry(entry);
+}
 
-    if (entry->production() < m_minValue) {
-        m_minValue = entry->production();
-        emit minValueChanged();
-    }
-    if (entry->production() > m_maxValue) {
-        m_maxValue = entry->production();
-        emit maxValueChanged();
-    }
-    if (entry->acquisition() < m_minValue) {
-        m_minValue = entry->acquisition();
-        emit minValueChanged();
-    }
-    if (entry->acquisition() > m_maxValue) {
-        m_maxValue = entry->acquisition();
-        emit maxValueChanged();
-    }
-    if (entry->storage() < m_minValue) {
-        m_minValue = entry->storage();
+void PowerBalanceLogs::updateMinMax(PowerBalanceLogEntry *entry)
+{
+    double newMin = qMin(qMin(entry->consumption(), entry->production()), qMin(entry->acquisition(), entry->storage()));
+    double newMax = qMax(qMax(entry->consumption(), entry->production()), qMax(entry->acquisition(), entry->storage()));
+    if (newMin < m_minValue) {
+        m_minValue = newMin;
         emit minValueChanged();
     }
-    if (entry->storage() > m_maxValue) {
-        m_maxValue = entry->storage();
+    if (newMax > m_maxValue) {
+        m_maxValue = newMax;
         emit maxValueChanged();
     }
+}
 
-    appendEntry(entry);
+PowerBalanceLogEntry *PowerBalanceLogs::unpack(const QVariantMap &map)
+{
+    QDateTime timestamp = QDateTime::fromSecsSinceEpoch(map.value("timestamp").toLongLong());
+    double consumption = map.value("consumption").toDouble();
+    double production = map.value("production").toDouble();
+    double acquisition = map.value("acquisition").toDouble();
+    double storage = map.value("storage").toDouble();
+    double totalConsumption = map.value("totalConsumption").toDouble();
+    double totalProduction = map.value("totalProduction").toDouble();
+    double totalAcquisition = map.value("totalAcquisition").toDouble();
+    double totalReturn = map.value("totalReturn").toDouble();
+    return new PowerBalanceLogEntry(timestamp, consumption, production, acquisition, storage, totalConsumption, totalProduction, totalAcquisition, totalReturn, this);
 }
 
 EnergyLogEntry *PowerBalanceLogs::find(const QDateTime &timestamp) const
 {
-    qWarning() << "Finding log entry for timestamp:" << timestamp;
+    // Entries are sorted by timestamp. Returns the entry at the given timestamp or the next newer one,
+    // clamped to the oldest/newest entry if the timestamp is out of range.
+    if (rowCount() == 0) {
+        return nullptr;
+    }
     int oldest = 0;
     int newest = rowCount() - 1;
-    EnergyLogEntry *entry = nullptr;
-    int step = 0;
-    while (oldest <= newest && step < rowCount()) {
-        EnergyLogEntry *oldestEntry = get(oldest);
-        EnergyLogEntry *newestEntry = get(newest);
-        int middle = (newest - oldest) / 2 + oldest;
-        EnergyLogEntry *middleEntry = get(middle);
-        qWarning() << "Oldest:" << oldestEntry->timestamp().toString() << "Middle:" << middleEntry->timestamp().toString() << "Newest:" << newestEntry->timestamp().toString() << ":" << (newest - oldest);
-        if (timestamp <= oldestEntry->timestamp()) {
-            return oldestEntry;
-        }
-        if (timestamp >= newestEntry->timestamp()) {
-            return newestEntry;
-        }
-
-        if (timestamp == middleEntry->timestamp()) {
-            return middleEntry;
-        }
-
-        if (timestamp < middleEntry->timestamp()) {
-            newest = middle;
+    while (oldest < newest) {
+        int middle = oldest + (newest - oldest) / 2;
+        if (get(middle)->timestamp() < timestamp) {
+            oldest = middle + 1;
         } else {
-            oldest = middle;
-        }
-
-        if ((newest - oldest) <= 1) {
-            return newestEntry;
+            newest = middle;
         }
-        step++;
     }
-    return entry;
+    return get(oldest);
 }
 
 void PowerBalanceLogs::logEntriesReceived(const QVariantMap &params)
 {
+    QList<EnergyLogEntry*> entries;
     foreach (const QVariant &variant, params.value("powerBalanceLogEntries").toList()) {
-        QVariantMap map = variant.toMap();
-        QDateTime timestamp = QDateTime::fromSecsSinceEpoch(map.value("timestamp").toLongLong());
-        double consumption = map.value("consumption").toDouble();
-        double production = map.value("production").toDouble();
-        double acquisition = map.value("acquisition").toDouble();
-        double storage = map.value("storage").toDouble();
-        double totalConsumption = map.value("totalConsumption").toDouble();
-        double totalProduction = map.value("totalProduction").toDouble();
-        double totalAcquisition = map.value("totalAcquisition").toDouble();
-        double totalReturn = map.value("totalReturn").toDouble();
-        PowerBalanceLogEntry *entry = new PowerBalanceLogEntry(timestamp, consumption, production, acquisition, storage, totalConsumption, totalProduction, totalAcquisition, totalReturn, this);
+        PowerBalanceLogEntry *entry = unpack(variant.toMap());
 //        qCritical() << "Adding entry:" << entry->timestamp() << entry->totalConsumption();
-
-        addEntry(entry);
+        updateMinMax(entry);
+        entries.append(entry);
     }
+    appendEntries(entries);
 }
 
 void PowerBalanceLogs::notificationReceived(const QVariantMap &data)
@@ -191,18 +175,7 @@ void PowerBalanceLogs::notificationReceived(const QVariantMap &data)
     }
 
     if (notification == "Energy.PowerBalanceLogEntryAdded") {
-        QVariantMap map = params.value("powerBalanceLogEntry").toMap();
-        QDateTime timestamp = QDateTime::fromSecsSinceEpoch(map.value("timestamp").toLongLong());
-        double consumption = map.value("consumption").toDouble();
-        double production = map.value("production").toDouble();
-        double acquisition = map.value("acquisition").toDouble();
-        double storage = map.value("storage").toDouble();
-        double totalConsumption = map.value("totalConsumption").toDouble();
-        double totalProduction = map.value("totalProduction").toDouble();
-        double totalAcquisition = map.value("totalAcquisition").toDouble();
-        double totalReturn = map.value("totalReturn").toDouble();
-        PowerBalanceLogEntry *entry = new PowerBalanceLogEntry(timestamp, consumption, production, acquisition, storage, totalConsumption, totalProduction, totalAcquisition, totalReturn, this);
-        addEntry(entry);
+        addEntry(unpack(params.value("powerBalanceLogEntry").toMap()));
     }
 }
 
@@ -62,11 +62,16 @@ signals:
 
 protected:
     QString logsName() const override;
+    QString entriesKey() const override;
+    QString entryKey() const override;
+    QStringList averagedFields() const override;
     void logEntriesReceived(const QVariantMap &params) override;
     void notificationReceived(const QVariantMap &data) override;
 
 private:
     void addEntry(PowerBalanceLogEntry *entry);
+    void updateMinMax(PowerBalanceLogEntry *entry);
+    PowerBalanceLogEntry *unpack(const QVariantMap &map);
 
     double m_minValue = 0;
     double m_maxValue = 0;
@@ -1,4 +1,5 @@
 #include "thingpowerlogs.h"
+#include "memorystats.h"
 
 #include <QMetaEnum>
 
@@ -39,12 +40,11 @@ double ThingPowerLogEntry::totalProduction() const
 
 ThingPowerLogs::ThingPowerLogs(QObject *parent) : EnergyLogs(parent)
 {
-    m_cacheTimer.setInterval(2000);
-    connect(&m_cacheTimer, &QTimer::timeout, this, [=](){
-        if (m_cachedEntries.count() > 0) {
-            addEntries(m_cachedEntries);
-            m_cachedEntries.clear();
-        }
+    m_cacheTimer.setSingleShot(true);
+    connect(&m_cacheTimer, &QTimer::timeout, this, &ThingPowerLogs::flushCachedEntries);
+
+    connect(this, &QAbstractItemModel::modelReset, this, [=](){
+        m_entriesByThing.clear();
     });
 }
 
@@ -73,25 +73,32 @@ double ThingPowerLogs::maxValue() const
 
 ThingPowerLogEntry *ThingPowerLogs::find(const QUuid &thingId, const QDateTime &timestamp)
 {
-    // TODO: Can we do a binary search even if they key we're looking for is not unique (but still sorted)?
-    // For now, 365 * consumers items is the max we'll have here which seems on the edge for doing a stupid linear search...
-//    qWarning() << "Finding item for" << thingId.toString() << timestamp.toString();
-    for (int i = rowCount() - 1; i >= 0; i--) {
-        ThingPowerLogEntry *entry = static_cast<ThingPowerLogEntry*>(get(i));
-        if (entry->thingId() != thingId) {
-            continue;
-        }
-//        qWarning() << "comparing" << entry->timestamp().toString();
-        if (timestamp == entry->timestamp()) {
-            return entry;
-        }
-        if (timestamp > entry->timestamp()) {
-            return nullptr; // Giving up, entry is not here
-        }
+    const QVector<ThingPowerLogEntry*> entries = m_entriesByThing.value(thingId);
+    int index = lowerBound(entries, timestamp);
+    if (index < entries.count() && entries.at(index)->timestamp() == timestamp) {
+        return entries.at(index);
     }
     return nullptr;
 }
 
+ThingPowerLogEntry *ThingPowerLogs::findClosest(const QUuid &thingId, const QDateTime &timestamp)
+{
+    const QVector<ThingPowerLogEntry*> entries = m_entriesByThing.value(thingId);
+    if (entries.isEmpty()) {
+        return nullptr;
+    }
+    int index = lowerBound(entries, timestamp);
+    if (index == entries.count()) {
+        return entries.last();
+    }
+    if (index == 0) {
+        return entries.first();
+    }
+    ThingPowerLogEntry *older = entries.at(index - 1);
+    ThingPowerLogEntry *newer = entries.at(index);
+    return older->timestamp().msecsTo(timestamp) <= timestamp.msecsTo(newer->timestamp()) ? older : newer;
+}
+
 ThingPowerLogEntry *ThingPowerLogs::liveEntry(const QUuid &thingId)
 {
     return m_liveEntries.value(thingId);
@@ -99,18 +106,55 @@ ThingPowerLogEntry *ThingPowerLogs::liveEntry(const QUuid &thingId)
 
 void ThingPowerLogs::addEntry(ThingPowerLogEntry *entry)
 {
+    QVector<ThingPowerLogEntry*> &thingEntries = m_entriesByThing[entry->thingId()];
+    thingEntries.insert(lowerBound(thingEntries, entry->timestamp().addMSecs(1)), entry);
     appendEntry(entry);
 }
 
 void ThingPowerLogs::addEntries(const QList<ThingPowerLogEntry *> &entries)
 {
     QList<EnergyLogEntry*> energyLogEntries;
+    energyLogEntries.reserve(entries.count());
     foreach (ThingPowerLogEntry* entry, entries) {
+        // Entries normally arrive in order, making this an append
+        QVector<ThingPowerLogEntry*> &thingEntries = m_entriesByThing[entry->thingId()];
+        if (thingEntries.isEmpty() || thingEntries.last()->timestamp() <= entry->timestamp()) {
+            thingEntries.append(entry);
+        } else {
+            thingEntries.insert(lowerBound(thingEntries, entry->timestamp().addMSecs(1)), entry);
+        }
         energyLogEntries.append(entry);
     }
     appendEntries(energyLogEntries);
 }
 
+int ThingPowerLogs::lowerBound(const QVector<ThingPowerLogEntry *> &entries, const QDateTime &timestamp) const
+{
+    int first = 0;
+    int last = entries.count();
+    while (first < last) {
+        int middle = first + (last - first) / 2;
+        if (entries.at(middle)->timestamp() < timestamp) {
+            first = middle + 1;
+        } else {
+            last = middle;
+        }
+    }
+    return first;
+}
+
+void ThingPowerLogs::flushCachedEntries()
+{
+    m_cacheTimer.stop();
+    if (m_cachedEntries.isEmpty()) {
+        return;
+    }
+
+    m_flushedTimestamp = m_cachedEntries.first()->timestamp();
+    addEntries(m_cachedEntries);
+    m_cachedEntries.clear();
+}
+
 ThingPowerLogEntry *ThingPowerLogs::unpack(const QVariantMap &map)
 {
     QDateTime timestamp = QDateTime::fromSecsSinceEpoch(map.value("timestamp").toLongLong());
@@ -126,6 +170,26 @@ QString ThingPowerLogs::logsName() const
     return "ThingPowerLogs";
 }
 
+QString ThingPowerLogs::entriesKey() const
+{
+    return "thingPowerLogEntries";
+}
+
+QString ThingPowerLogs::entryKey() const
+{
+    return "thingPowerLogEntry";
+}
+
+QString ThingPowerLogs::groupingKey() const
+{
+    return "thingId";
+}
+
+QStringList ThingPowerLogs::averagedFields() const
+{
+    return {"currentPower"};
+}
+
 QVariantMap ThingPowerLogs::fetchParams() const
 {
     QVariantList thingIdsStrings;
@@ -150,33 +214,14 @@ void ThingPowerLogs::logEntriesReceived(const QVariantMap &params)
         emit liveEntryChanged(entry);
     }
 
-    // Grouping them so when the UI gets entriesAdded, the whole set for this timstamp will be available at once
-    QList<ThingPowerLogEntry*> groupForTimestamp;
+    // Adding the whole block at once. Entries are sorted by timestamp so the UI can group them in entriesAdded
+    QList<ThingPowerLogEntry*> entries;
     foreach (const QVariant &variant, params.value("thingPowerLogEntries").toList()) {
-        QVariantMap map = variant.toMap();
-        QDateTime timestamp = QDateTime::fromSecsSinceEpoch(map.value("timestamp").toLongLong());
-        QUuid thingId = map.value("thingId").toUuid();
-        double currentPower = map.value("currentPower").toDouble();
-        double totalConsumption = map.value("totalConsumption").toDouble();
-        double totalProduction = map.value("totalProduction").toDouble();
-        ThingPowerLogEntry *entry = new ThingPowerLogEntry(timestamp, thingId, currentPower, totalConsumption, totalProduction, this);
+        ThingPowerLogEntry *entry = unpack(variant.toMap());
 //        qWarning() << "Adding entry:" << entry->thingId() << entry->timestamp().toString() << entry->totalConsumption();
-
-        if (groupForTimestamp.isEmpty()) {
-            groupForTimestamp.append(entry);
-        } else if (groupForTimestamp.first()->timestamp() == timestamp) {
-            groupForTimestamp.append(entry);
-        } else {
-            // Finalize previous group and start a new one
-            addEntries(groupForTimestamp);
-            groupForTimestamp.clear();
-            groupForTimestamp.append(entry);
-        }
-    }
-
-    if (!groupForTimestamp.isEmpty()) {
-        addEntries(groupForTimestamp);
+        entries.append(entry);
     }
+    addEntries(entries);
 }
 
 void ThingPowerLogs::notificationReceived(const QVariantMap &data)
@@ -210,31 +255,51 @@ void ThingPowerLogs::notificationReceived(const QVariantMap &data)
     }
 
     if (notification == "Energy.ThingPowerLogEntryAdded") {
-        QVariantMap map = params.value("thingPowerLogEntry").toMap();
-        QDateTime timestamp = QDateTime::fromSecsSinceEpoch(map.value("timestamp").toLongLong());
-        QUuid thingId = map.value("thingId").toUuid();
-        if (!m_thingIds.isEmpty() && !m_thingIds.contains(thingId)) {
-            return;
-        }
-        double currentPower = map.value("currentPower").toDouble();
-        double totalConsumption = map.value("totalConsumption").toDouble();
-        double totalProduction = map.value("totalProduction").toDouble();
-        ThingPowerLogEntry *entry = new ThingPowerLogEntry(timestamp, thingId, currentPower, totalConsumption, totalProduction, this);
+        ThingPowerLogEntry *entry = unpack(params.value("thingPowerLogEntry").toMap());
 
         // In order to be easier on resources, we'll batch notifications by grouping them by timestamp
         // While the timestamp is the same, just cache the changes. Once the timestamp changes, we'll finalize the
         // batch and actually append them.
         // Also if we're not getting any more notification for a while and still have cached entries, we'll process the batch
+        if (!m_cachedEntries.isEmpty() && entry->timestamp() != m_cachedEntries.first()->timestamp()) {
+            flushCachedEntries();
+        }
+        // Never wait longer than the old fixed 2 seconds
         if (m_cachedEntries.isEmpty()) {
-            m_cachedEntries.append(entry);
-        } else if (entry->timestamp() == m_cachedEntries.first()->timestamp()) {
-            m_cachedEntries.append(entry);
+            if (m_flushedTimestamp.isValid() && entry->timestamp() == m_flushedTimestamp) {
+                // A straggler of the batch we just flushed, the window was too short
+                m_coalescingWindow = static_cast<int>(qMin<qint64>(qMax<qint64>(m_coalescingWindow * 2, m_arrivalTimer.elapsed() * 2), 2000));
+                m_lateBatch = true;
+            } else if (m_flushedTimestamp.isValid()) {
+                // A clean timestamp change. Unless the last batch was a straggler, see if a shorter window would have done as well.
+                if (!m_lateBatch) {
+                    m_coalescingWindow = static_cast<int>(qBound<qint64>(50, qMax<qint64>(m_batchGap * 2, m_coalescingWindow * 3 / 4), 2000));
+                }
+                m_lateBatch = false;
+            }
+            m_batchGap = 0;
         } else {
-            addEntries(m_cachedEntries);
-            m_cachedEntries.clear();
-            m_cachedEntries.append(entry);
+            m_batchGap = qMax(m_batchGap, m_arrivalTimer.elapsed());
         }
-        m_cacheTimer.start();
+        m_arrivalTimer.start();
+        m_cachedEntries.append(entry);
+
+        // Got an entry for every thing we're watching, no need to wait any longer
+        if (!m_thingIds.isEmpty() && m_cachedEntries.count() >= m_thingIds.count()) {
+            flushCachedEntries();
+            return;
+        }
+        m_cacheTimer.start(m_coalescingWindow);
     }
 }
 
+qint64 ThingPowerLogs::estimatedSize() const
+{
+    qint64 size = EnergyLogs::estimatedSize();
+    foreach (const QVector<ThingPowerLogEntry*> &entries, m_entriesByThing) {
+        size += entries.count() * sizeof(ThingPowerLogEntry*);
+    }
+    size += m_cachedEntries.count() * (sizeof(ThingPowerLogEntry*) + MemoryStats::objectSize(sizeof(ThingPowerLogEntry)));
+    size += m_liveEntries.count() * (sizeof(ThingPowerLogEntry*) + MemoryStats::objectSize(sizeof(ThingPowerLogEntry)));
+    return size;
+}
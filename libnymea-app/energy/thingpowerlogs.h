@@ -3,6 +3,8 @@
 
 #include <QObject>
 #include <QAbstractListModel>
+#include <QElapsedTimer>
+#include <QTimer>
 
 #include "energylogs.h"
 
@@ -45,9 +47,12 @@ public:
     double maxValue() const;
 
     Q_INVOKABLE ThingPowerLogEntry *find(const QUuid &thingId, const QDateTime &timestamp);
+    Q_INVOKABLE ThingPowerLogEntry *findClosest(const QUuid &thingId, const QDateTime &timestamp);
 
     Q_INVOKABLE ThingPowerLogEntry *liveEntry(const QUuid &thingId);
 
+    qint64 estimatedSize() const override;
+
 signals:
     void thingIdsChanged();
 
@@ -58,6 +63,10 @@ signals:
 
 protected:
     QString logsName() const override;
+    QString entriesKey() const override;
+    QString entryKey() const override;
+    QString groupingKey() const override;
+    QStringList averagedFields() const override;
     QVariantMap fetchParams() const override;
     void logEntriesReceived(const QVariantMap &params) override;
     void notificationReceived(const QVariantMap &data) override;
@@ -67,13 +76,25 @@ private:
     void addEntries(const QList<ThingPowerLogEntry *> &entries);
 
     ThingPowerLogEntry *unpack(const QVariantMap &map);
+    int lowerBound(const QVector<ThingPowerLogEntry*> &entries, const QDateTime &timestamp) const;
+    void flushCachedEntries();
 
     QList<QUuid> m_thingIds;
     double m_minValue = 0;
     double m_maxValue = 0;
 
+    // Per thing, sorted by timestamp
+    QHash<QUuid, QVector<ThingPowerLogEntry*>> m_entriesByThing;
+
+    // Live notifications for one timestamp arrive spread over a short time. Coalesce them in a window adapted
+    // to how far apart they've been arriving recently. It grows when a batch got split and shrinks after clean ones.
     QList<ThingPowerLogEntry*> m_cachedEntries;
     QTimer m_cacheTimer;
+    QElapsedTimer m_arrivalTimer;
+    qint64 m_batchGap = 0;
+    QDateTime m_flushedTimestamp;
+    bool m_lateBatch = false;
+    int m_coalescingWindow = 2000;
 
     QHash<QUuid, ThingPowerLogEntry*> m_liveEntries;
 };
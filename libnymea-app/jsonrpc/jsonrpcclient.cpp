@@ -29,6 +29,7 @@
 * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 
 #include "jsonrpcclient.h"
+#include "jsonrpcstatistics.h"
 #include "connection/nymeaconnection.h"
 #include "types/param.h"
 #include "types/params.h"
@@ -37,8 +38,14 @@
 #include "connection/websockettransport.h"
 #include "connection/bluetoothtransport.h"
 #include "connection/cloudtransport.h"
+#include "tracerecorder.h"
+#include "stallwatchdog.h"
+#include "startuptimeline.h"
 
 #include <QJsonDocument>
+#include <QJsonValue>
+#include <QCborValue>
+#include <QCborStreamReader>
 #include <QVariantMap>
 #include <QDebug>
 #include <QUuid>
@@ -57,6 +64,7 @@ JsonRpcClient::JsonRpcClient(QObject *parent) :
     m_id(0)
 {
     m_connection = new NymeaConnection(this);
+    m_statistics = new JsonRpcStatistics(this);
     m_connection->registerTransport(new TcpSocketTransportFactory());
     m_connection->registerTransport(new WebsocketTransportFactory());
     m_connection->registerTransport(new BluetoothTransportFactoy());
@@ -70,8 +78,21 @@ JsonRpcClient::JsonRpcClient(QObject *parent) :
     // We'll connect this Queued, because in case of a disconnect we'll want to react on that ASAP instead of processing a queue that may be left in buffers
     // Especially on mobile platforms (hello Android) we get a huge queue of buffers upon resume from suspend just to get a disconnect after that.
     connect(m_connection, &NymeaConnection::dataAvailable, this, &JsonRpcClient::dataReceived, Qt::QueuedConnection);
+    // Transports append straight into m_receiveBuffer. The notification carries no data, processing is still deferred.
+    m_connection->setReceiveBuffer(&m_receiveBuffer);
+    connect(m_connection, &NymeaConnection::dataAppended, this, &JsonRpcClient::onDataAppended);
+    connect(m_connection, &NymeaConnection::transportUpgradeAvailable, this, &JsonRpcClient::upgradeTransportWhenIdle);
 
     registerNotificationHandler(this, QStringLiteral("JSONRPC"), "notificationReceived");
+
+    m_heartbeatTimer.setInterval(5000);
+    connect(&m_heartbeatTimer, &QTimer::timeout, this, &JsonRpcClient::sendHeartbeat);
+}
+
+JsonRpcClient::~JsonRpcClient()
+{
+    // The connection outlives m_receiveBuffer while children are torn down
+    m_connection->setReceiveBuffer(nullptr);
 }
 
 void JsonRpcClient::registerNotificationHandler(QObject *handler, const QString &nameSpace, const QString &method)
@@ -184,7 +205,20 @@ void JsonRpcClient::setNotificationsEnabledResponse(int commandId, const QVarian
     qCDebug(dcJsonRpc()) << "Notification configuration response:" << commandId << qUtf8Printable(QJsonDocument::fromVariant(params).toJson());
 
     if (!m_connected) {
+        Connection *connection = m_connection->currentConnection();
+        qCInfo(dcJsonRpc()).nospace() << "Connection timeline for " << (connection ? connection->url() : QUrl())
+                                      << ": Transport handshake: " << (connection ? connection->handshakeTime() : -1) << " ms"
+                                      << (m_connection->isEncrypted() ? (m_connection->sessionResumptionOffered() ? " (TLS session resumption offered)" : " (full TLS handshake)") : "")
+                                      << ", Hello reply after " << m_helloReplyTime << " ms"
+                                      << ", session ready after " << m_sessionClock.elapsed() << " ms";
+        StartupTimeline::mark("Session ready");
+
         m_connected = true;
+        m_pendingHeartbeat = -1;
+        m_missedHeartbeats = 0;
+        if (m_heartbeatTimer.interval() > 0) {
+            m_heartbeatTimer.start();
+        }
         emit connectedChanged(true);
     }
 }
@@ -379,6 +413,60 @@ QVariantMap JsonRpcClient::experiences() const
     return m_experiences;
 }
 
+int JsonRpcClient::heartbeatInterval() const
+{
+    return m_heartbeatTimer.interval();
+}
+
+void JsonRpcClient::setHeartbeatInterval(int heartbeatInterval)
+{
+    heartbeatInterval = qMax(0, heartbeatInterval);
+    if (m_heartbeatTimer.interval() == heartbeatInterval) {
+        return;
+    }
+    m_heartbeatTimer.setInterval(heartbeatInterval);
+    if (heartbeatInterval == 0) {
+        m_heartbeatTimer.stop();
+    } else if (m_connected) {
+        m_heartbeatTimer.start();
+    }
+    emit heartbeatIntervalChanged();
+}
+
+int JsonRpcClient::heartbeatMissLimit() const
+{
+    return m_heartbeatMissLimit;
+}
+
+void JsonRpcClient::setHeartbeatMissLimit(int heartbeatMissLimit)
+{
+    heartbeatMissLimit = qMax(1, heartbeatMissLimit);
+    if (m_heartbeatMissLimit != heartbeatMissLimit) {
+        m_heartbeatMissLimit = heartbeatMissLimit;
+        emit heartbeatMissLimitChanged();
+    }
+}
+
+int JsonRpcClient::roundTripTime() const
+{
+    return m_roundTripTimes.isEmpty() ? -1 : m_roundTripTimes.last().toInt();
+}
+
+QVariantList JsonRpcClient::roundTripTimes() const
+{
+    return m_roundTripTimes;
+}
+
+JsonRpcStatistics *JsonRpcClient::statistics() const
+{
+    return m_statistics;
+}
+
+qint64 JsonRpcClient::msecsSinceConnected() const
+{
+    return m_sessionClock.isValid() ? m_sessionClock.elapsed() : -1;
+}
+
 int JsonRpcClient::createUser(const QString &username, const QString &password)
 {
     QVariantMap params;
@@ -386,7 +474,7 @@ int JsonRpcClient::createUser(const QString &username, const QString &password)
     params.insert("password", password);
     JsonRpcReply* reply = createReply("JSONRPC.CreateUser", params, this, "processCreateUser");
     m_replies.insert(reply->commandId(), reply);
-    m_connection->sendData(QJsonDocument::fromVariant(reply->requestMap()).toJson());
+    sendRequest(reply->requestMap());
     return reply->commandId();
 }
 
@@ -399,7 +487,7 @@ int JsonRpcClient::authenticate(const QString &username, const QString &password
     qDebug() << "Authenticating:" << username << password << deviceName;
     JsonRpcReply* reply = createReply("JSONRPC.Authenticate", params, this, "processAuthenticate");
     m_replies.insert(reply->commandId(), reply);
-    m_connection->sendData(QJsonDocument::fromVariant(reply->requestMap()).toJson());
+    sendRequest(reply->requestMap());
     return reply->commandId();
 }
 
@@ -410,7 +498,7 @@ int JsonRpcClient::requestPushButtonAuth(const QString &deviceName)
     params.insert("deviceName", deviceName);
     JsonRpcReply *reply = createReply("JSONRPC.RequestPushButtonAuth", params, this, "processRequestPushButtonAuth");
     m_replies.insert(reply->commandId(), reply);
-    m_connection->sendData(QJsonDocument::fromVariant(reply->requestMap()).toJson());
+    sendRequest(reply->requestMap());
     return reply->commandId();
 }
 
@@ -432,6 +520,7 @@ void JsonRpcClient::processAuthenticate(int /*commandId*/, const QVariantMap &da
 {
     if (data.value("success").toBool()) {
         qDebug() << "authentication successful";
+        StartupTimeline::mark("Authenticated");
         m_token = data.value("token").toByteArray();
         m_username = data.value("username").toString();
         if (m_jsonRpcVersion.majorVersion() >= 6) {
@@ -519,14 +608,95 @@ void JsonRpcClient::setNotificationsEnabled()
 
 void JsonRpcClient::sendRequest(const QVariantMap &request)
 {
+    if (TraceRecorder::active()) {
+        TraceRecorder::instance()->addAsyncBegin("jsonrpc", request.value("method").toString(), request.value("id").toInt());
+    }
     QVariantMap newRequest = request;
     newRequest.insert("token", m_token);
     //    qDebug() << "Sending request" << qUtf8Printable(QJsonDocument::fromVariant(newRequest).toJson());
-    m_connection->sendData(QJsonDocument::fromVariant(newRequest).toJson(QJsonDocument::Compact) + "\n");
+    QByteArray data;
+    if (m_encoding == EncodingCbor) {
+        // Going through QJsonValue keeps the types exactly as in JSON mode (e.g. QByteArray and QUuid become strings)
+        data = QCborValue::fromJsonValue(QJsonValue::fromVariant(newRequest)).toCbor();
+    } else {
+        data = QJsonDocument::fromVariant(newRequest).toJson(QJsonDocument::Compact) + "\n";
+    }
+    JsonRpcReply *reply = m_replies.value(request.value("id").toInt());
+    if (reply) {
+        reply->setSent(data.size());
+    }
+    m_connection->sendData(data);
+}
+
+void JsonRpcClient::sendHello(const QString &callback, bool withLocale)
+{
+    QVariantMap params;
+    if (withLocale) {
+        params.insert("locale", QLocale().name());
+    }
+    // CBOR is binary and needs a transport that passes bytes through as they are
+    if (m_connection->isBinarySafe()) {
+        params.insert("encodings", QStringList{"cbor", "json"});
+    }
+    sendCommand("JSONRPC.Hello", params, this, callback);
+}
+
+bool JsonRpcClient::takeMessage(QVariantMap &message)
+{
+    if (m_encoding == EncodingCbor && !m_receiveBuffer.startsWith('{')) {
+        // CBOR items are self delimiting, no need to search for separators
+        QCborStreamReader reader(m_receiveBuffer);
+        QCborValue value = QCborValue::fromCbor(reader);
+        if (reader.lastError() == QCborError::EndOfFile) {
+            // Incomplete, wait for more data
+            return false;
+        }
+        if (reader.lastError() != QCborError::NoError || !value.isMap()) {
+            qCWarning(dcJsonRpc()) << "Could not parse CBOR data from nymea:" << reader.lastError().toString() << "Dropping" << m_receiveBuffer.length() << "bytes.";
+            m_receiveBuffer.clear();
+            return false;
+        }
+        m_receiveBuffer.remove(0, static_cast<int>(reader.currentOffset()));
+        message = value.toMap().toVariantMap();
+        return true;
+    }
+
+    int splitIndex = m_receiveBuffer.indexOf("}\n{") + 1;
+    if (splitIndex <= 0) {
+        splitIndex = m_receiveBuffer.length();
+        if (m_encoding == EncodingCbor) {
+            // Right after switching, the server's last JSON messages may be followed by CBOR ones.
+            int end = m_receiveBuffer.indexOf("}\n");
+            while (end >= 0) {
+                QJsonParseError error;
+                QJsonDocument::fromJson(m_receiveBuffer.left(end + 1), &error);
+                if (error.error == QJsonParseError::NoError) {
+                    splitIndex = end + 1;
+                    break;
+                }
+                end = m_receiveBuffer.indexOf("}\n", end + 1);
+            }
+        }
+    }
+    QJsonParseError error;
+    QJsonDocument jsonDoc = QJsonDocument::fromJson(m_receiveBuffer.left(splitIndex), &error);
+    if (error.error != QJsonParseError::NoError) {
+        //        qWarning() << "Could not parse json data from nymea" << m_receiveBuffer.left(splitIndex) << error.errorString();
+        return false;
+    }
+    //    qDebug() << "received response" << qUtf8Printable(jsonDoc.toJson(QJsonDocument::Indented));
+    // Keep the buffer's capacity, transports append into it directly
+    m_receiveBuffer.remove(0, splitIndex + 1);
+    message = jsonDoc.toVariant().toMap();
+    return true;
 }
 
 bool JsonRpcClient::loadPem(const QUuid &serverUud, QByteArray &pem)
 {
+    if (m_pinnedCertificates.contains(serverUud)) {
+        pem = m_pinnedCertificates.value(serverUud);
+        return true;
+    }
     QDir dir(QStandardPaths::writableLocation(QStandardPaths::DataLocation) + "/sslcerts/");
     QFile certFile(dir.absoluteFilePath(serverUud.toString().remove(QRegExp("[{}]")) + ".pem"));
     if (!certFile.open(QFile::ReadOnly)) {
@@ -534,11 +704,13 @@ bool JsonRpcClient::loadPem(const QUuid &serverUud, QByteArray &pem)
     }
     pem.clear();
     pem.append(certFile.readAll());
+    m_pinnedCertificates.insert(serverUud, pem);
     return true;
 }
 
 bool JsonRpcClient::storePem(const QUuid &serverUuid, const QByteArray &pem)
 {
+    m_pinnedCertificates.insert(serverUuid, pem);
     QDir dir(QStandardPaths::writableLocation(QStandardPaths::DataLocation) + "/sslcerts/");
     if (!dir.exists()) {
         dir.mkpath(QStandardPaths::writableLocation(QStandardPaths::DataLocation) + "/sslcerts/");
@@ -561,8 +733,19 @@ void JsonRpcClient::onInterfaceConnectedChanged(bool connected)
         m_authenticationRequired = false;
         m_authenticated = false;
         m_receiveBuffer.clear();
+        m_messageClock.invalidate();
         m_serverQtVersion.clear();
         m_serverQtBuildVersion.clear();
+        m_heartbeatTimer.stop();
+        m_pendingHeartbeat = -1;
+        m_sessionClock.invalidate();
+        if (!m_roundTripTimes.isEmpty()) {
+            m_roundTripTimes.clear();
+            emit roundTripTimesChanged();
+        }
+        // Replies for requests sent on the old link will never arrive. Drop them so they don't pile up.
+        qDeleteAll(m_replies);
+        m_replies.clear();
         if (m_connected) {
             m_connected = false;
             emit connectedChanged(false);
@@ -571,6 +754,9 @@ void JsonRpcClient::onInterfaceConnectedChanged(bool connected)
         qCInfo(dcJsonRpc()) << "JsonRpcClient: Transport connected. Starting handshake.";
         // Clear anything that might be left in the buffer from a previous connection.
         m_receiveBuffer.clear();
+        m_messageClock.invalidate();
+        m_sessionClock.start();
+        m_helloReplyTime = -1;
 
         // Load token for this host
         QSettings settings;
@@ -579,9 +765,9 @@ void JsonRpcClient::onInterfaceConnectedChanged(bool connected)
         settings.endGroup();
 
 
-        QVariantMap params;
-        params.insert("locale", QLocale().name());
-        sendCommand("JSONRPC.Hello", params, this, "helloReply");
+        m_encoding = EncodingJson;
+        StartupTimeline::mark("Hello sent");
+        sendHello("helloReply");
     }
 }
 
@@ -592,30 +778,54 @@ void JsonRpcClient::dataReceived(const QByteArray &data)
         // In that case we can discard all pending packages as we'll have to reconnect anyways.
         return;
     }
-    //    qDebug() << "JsonRpcClient: received data:" << qUtf8Printable(data);
     m_receiveBuffer.append(data);
+    onDataAppended();
+}
 
-    int splitIndex = m_receiveBuffer.indexOf("}\n{") + 1;
-    if (splitIndex <= 0) {
-        splitIndex = m_receiveBuffer.length();
+void JsonRpcClient::onDataAppended()
+{
+    // Any data from the server proves the link is alive.
+    m_missedHeartbeats = 0;
+    if (!m_messageClock.isValid()) {
+        m_messageClock.start();
     }
-    QJsonParseError error;
-    QJsonDocument jsonDoc = QJsonDocument::fromJson(m_receiveBuffer.left(splitIndex), &error);
-    if (error.error != QJsonParseError::NoError) {
-        //        qWarning() << "Could not parse json data from nymea" << m_receiveBuffer.left(splitIndex) << error.errorString();
+    // Coalesce bursts into a single queued call. Parsing is deferred so a disconnect that is
+    // already pending is handled before we churn through a backlog of buffered data.
+    if (!m_processingScheduled) {
+        m_processingScheduled = true;
+        QMetaObject::invokeMethod(this, "processReceiveBuffer", Qt::QueuedConnection);
+    }
+}
+
+void JsonRpcClient::processReceiveBuffer()
+{
+    m_processingScheduled = false;
+    if (!m_connection->connected()) {
         return;
     }
-    //    qDebug() << "received response" << qUtf8Printable(jsonDoc.toJson(QJsonDocument::Indented));
-    m_receiveBuffer = m_receiveBuffer.right(m_receiveBuffer.length() - splitIndex - 1);
+
+    QVariantMap dataMap;
+    int bufferSize = m_receiveBuffer.size();
+    {
+        TraceSpan span("jsonrpc", "decode");
+        if (!takeMessage(dataMap)) {
+            if (m_receiveBuffer.isEmpty()) {
+                m_messageClock.invalidate();
+            }
+            return;
+        }
+    }
+    int messageSize = bufferSize - m_receiveBuffer.size();
+    qint64 messageAge = m_messageClock.isValid() ? m_messageClock.elapsed() : 0;
+    m_messageClock.invalidate();
     if (!m_receiveBuffer.isEmpty()) {
-        staticMetaObject.invokeMethod(this, "dataReceived", Qt::QueuedConnection, Q_ARG(QByteArray, QByteArray()));
+        // One message per event loop iteration keeps the UI responsive during large bursts
+        onDataAppended();
     }
 
-    QVariantMap dataMap = jsonDoc.toVariant().toMap();
-
     // check if this is a notification
     if (dataMap.contains("notification")) {
-        qCDebug(dcJsonRpc()) << "Incoming notification:" << qUtf8Printable(jsonDoc.toJson());
+        qCDebug(dcJsonRpc()) << "Incoming notification:" << qUtf8Printable(QJsonDocument::fromVariant(dataMap).toJson());
         // Check if our permissions changed
         if (dataMap.value("notification").toString() == "Users.UserChanged") {
             QVariantMap userMap = dataMap.value("params").toMap().value("userInfo").toMap();
@@ -626,11 +836,17 @@ void JsonRpcClient::dataReceived(const QByteArray &data)
                 emit permissionsChanged();
             }
         }
-        QStringList notification = dataMap.value("notification").toString().split(".");
-        QString nameSpace = notification.first();
+        QString notificationName = dataMap.value("notification").toString();
+        QString nameSpace = notificationName.left(notificationName.indexOf('.'));
+        m_statistics->addNotification(nameSpace, messageSize);
+        qint64 traceStart = TraceRecorder::active() ? TraceRecorder::now() : -1;
+        StallActivity activity("notification", notificationName);
         foreach (QObject *handler, m_notificationHandlers.values(nameSpace)) {
             QMetaObject::invokeMethod(handler, m_notificationHandlerMethods.value(handler).toLatin1().data(), Q_ARG(QVariantMap, dataMap));
         }
+        if (traceStart >= 0) {
+            TraceRecorder::instance()->addComplete("notification", notificationName, traceStart, TraceRecorder::now() - traceStart);
+        }
         return;
     }
 
@@ -639,6 +855,23 @@ void JsonRpcClient::dataReceived(const QByteArray &data)
     JsonRpcReply *reply = m_replies.take(commandId);
     if (reply) {
         reply->deleteLater();
+        const QString fullMethod = reply->nameSpace() + '.' + reply->method();
+        reply->setReceived(messageAge, messageSize);
+        m_statistics->addReply(fullMethod,
+                               reply->completeTime() - qMax<qint64>(0, reply->sentTime()),
+                               reply->firstByteTime() - qMax<qint64>(0, reply->sentTime()),
+                               reply->requestSize(), reply->responseSize(),
+                               dataMap.value("status").toString() != "success");
+        qint64 traceStart = -1;
+        if (TraceRecorder::active()) {
+            TraceRecorder::instance()->addAsyncEnd("jsonrpc", fullMethod, commandId);
+            traceStart = TraceRecorder::now();
+        }
+
+        // The JSONRPC namespace calls are cheap on the server side, so they make a good measure for the link latency.
+        if (reply->nameSpace() == "JSONRPC" && m_connection->currentConnection()) {
+            m_connection->currentConnection()->addRoundTripSample(reply->elapsed());
+        }
         //        qDebug() << QString("JsonRpc: got response for %1.%2: %3").arg(reply->nameSpace(), reply->method(), QString::fromUtf8(jsonDoc.toJson(QJsonDocument::Indented))) << reply->callback() << reply->callback();
 
         if (dataMap.value("status").toString() == "unauthorized") {
@@ -658,24 +891,36 @@ void JsonRpcClient::dataReceived(const QByteArray &data)
             qWarning() << "An error happened in the JSONRPC layer:" << dataMap.value("error").toString();
             qWarning() << "Request was:" << qUtf8Printable(QJsonDocument::fromVariant(reply->requestMap()).toJson());
             if (reply->nameSpace() == "JSONRPC" && reply->method() == "Hello") {
-                qWarning() << "Hello call failed. Trying again without locale";
                 m_id = 0;
-                sendCommand("JSONRPC.Hello", QVariantMap(), this, "helloReply");
+                if (reply->params().contains("encodings")) {
+                    // Older cores reject params they don't know
+                    qWarning() << "Hello call failed. Trying again without encoding negotiation";
+                    sendHello(reply->callback(), reply->params().contains("locale"));
+                } else {
+                    qWarning() << "Hello call failed. Trying again without locale";
+                    sendCommand("JSONRPC.Hello", QVariantMap(), this, "helloReply");
+                }
             }
         }
         // Note: We're still forwarding a failed call, params will be empty tho...
         // This should never really happen as errors on this layer indicate a but in the caller code in the first place
         // Some methods however, like authenticate might fail on an invalid token tho and stil need to act on it
 
-        if (!reply->caller().isNull() && !reply->callback().isEmpty()) {
-            QMetaObject::invokeMethod(reply->caller(), reply->callback().toLatin1().data(), Q_ARG(int, commandId), Q_ARG(QVariantMap, dataMap.value("params").toMap()));
+        {
+            StallActivity activity("reply", fullMethod);
+            if (!reply->caller().isNull() && !reply->callback().isEmpty()) {
+                QMetaObject::invokeMethod(reply->caller(), reply->callback().toLatin1().data(), Q_ARG(int, commandId), Q_ARG(QVariantMap, dataMap.value("params").toMap()));
+            }
+
+            emit responseReceived(reply->commandId(), dataMap.value("params").toMap());
         }
 
-        emit responseReceived(reply->commandId(), dataMap.value("params").toMap());
+        if (traceStart >= 0) {
+            TraceRecorder::instance()->addComplete("dispatch", fullMethod, traceStart, TraceRecorder::now() - traceStart);
+        }
 
 
         // If the server supports cache hashes, cache stuff locally
-        QString fullMethod = reply->nameSpace() + '.' + reply->method();
         if (m_cacheHashes.contains(fullMethod)) {
             QString hash = m_cacheHashes.value(fullMethod);
             QString callSignature = fullMethod + '-' + QJsonDocument::fromVariant(reply->params()).toJson() + '-' + QLocale().name();
@@ -687,12 +932,22 @@ void JsonRpcClient::dataReceived(const QByteArray &data)
             }
         }
 
+        if (m_replies.isEmpty() && m_connection->upgradeAvailable()) {
+            upgradeTransportWhenIdle();
+        }
         return;
     }
 }
 
 void JsonRpcClient::helloReply(int /*commandId*/, const QVariantMap &params)
 {
+    m_helloReplyTime = m_sessionClock.elapsed();
+    StartupTimeline::mark("Hello reply received");
+    if (params.value("encoding").toString() == "cbor") {
+        qCInfo(dcJsonRpc()) << "Server agreed on CBOR encoding.";
+        m_encoding = EncodingCbor;
+    }
+
     m_initialSetupRequired = params.value("initialSetupRequired").toBool();
     m_authenticationRequired = params.value("authenticationRequired").toBool();
     m_pushButtonAuthAvailable = params.value("pushButtonAuthAvailable").toBool();
@@ -728,34 +983,8 @@ void JsonRpcClient::helloReply(int /*commandId*/, const QVariantMap &params)
     }
 
 
-    // Verify SSL certificate
-    if (m_connection->isEncrypted()) {
-        QByteArray oldPem;
-        QSslCertificate certificate = m_connection->sslCertificate();
-        if (!loadPem(m_serverUuid, oldPem)) {
-            qCInfo(dcJsonRpc()) << "No SSL certificate for this host stored. Accepting and pinning new certificate.";
-            // No certificate yet! Inform ui about it.
-            emit newSslCertificate();
-            storePem(m_serverUuid, m_connection->sslCertificate().toPem());
-        } else {
-            // We have a certificate pinned already. Check if it's the same
-            if (certificate.toPem() != oldPem) {
-                // Uh oh, the certificate has changed
-                qCWarning(dcJsonRpc()) << "This connections certificate has changed!";
-                qCWarning(dcJsonRpc()) << "Old PEM:" << oldPem;
-                qCWarning(dcJsonRpc()) << "New PEM:" << certificate.toPem();
-
-                // Extract certificate info before disconnecting.
-                QVariantMap issuerInfo = certificateIssuerInfo();
-
-                // Reject the connection until the UI explicitly accepts this...
-                m_connection->disconnectFromHost();
-
-                emit verifyConnectionCertificate(m_serverUuid, issuerInfo, certificate.toPem());
-                return;
-            }
-            qCInfo(dcJsonRpc()) << "This connections certificate is trusted.";
-        }
+    if (!verifyCertificate()) {
+        return;
     }
 
     m_cacheHashes.clear();
@@ -810,6 +1039,131 @@ void JsonRpcClient::helloReply(int /*commandId*/, const QVariantMap &params)
 
 }
 
+void JsonRpcClient::upgradeHelloReply(int /*commandId*/, const QVariantMap &params)
+{
+    if (params.value("encoding").toString() == "cbor") {
+        m_encoding = EncodingCbor;
+    }
+    if (params.value("uuid").toString() != m_serverUuid) {
+        qCWarning(dcJsonRpc()) << "Upgraded connection leads to a different server:" << params.value("uuid").toString() << "Expected:" << m_serverUuid;
+        m_connection->disconnectFromHost();
+        return;
+    }
+    if (!verifyCertificate()) {
+        return;
+    }
+    qCInfo(dcJsonRpc()) << "Session moved to" << m_connection->currentConnection()->url();
+    // Notification settings are per connection on the server side, the token is sent with each request anyways.
+    setNotificationsEnabled();
+}
+
+void JsonRpcClient::upgradeTransportWhenIdle()
+{
+    // Only move the session while nothing is in flight, replies would get lost on the old transport otherwise.
+    if (!m_connected || !m_replies.isEmpty() || !m_receiveBuffer.isEmpty()) {
+        return;
+    }
+    if (!m_connection->upgradeTransport()) {
+        return;
+    }
+
+    m_encoding = EncodingJson;
+    sendHello("upgradeHelloReply");
+}
+
+void JsonRpcClient::sendHeartbeat()
+{
+    if (!m_connected) {
+        m_heartbeatTimer.stop();
+        return;
+    }
+
+    if (m_pendingHeartbeat != -1) {
+        m_missedHeartbeats++;
+        qCWarning(dcJsonRpc()) << "No data received from the server for" << m_missedHeartbeats << "heartbeat interval(s)";
+        if (m_missedHeartbeats < m_heartbeatMissLimit) {
+            // Still waiting for the last one, no need to pile up more pings on a congested link.
+            return;
+        }
+
+        qCWarning(dcJsonRpc()) << "Connection to" << (currentConnection() ? currentConnection()->url() : QUrl()) << "is dead. Dropping it.";
+        m_pendingHeartbeat = -1;
+        m_missedHeartbeats = 0;
+        m_connection->dropCurrentTransport();
+
+        if (m_connection->connected()) {
+            // NymeaConnection roamed to another transport which is still up. Set up the session on that one.
+            qDeleteAll(m_replies);
+            m_replies.clear();
+            m_receiveBuffer.clear();
+            m_messageClock.invalidate();
+            m_encoding = EncodingJson;
+            sendHello("upgradeHelloReply");
+        }
+        return;
+    }
+
+    JsonRpcReply *reply = createReply("JSONRPC.Version", QVariantMap(), this, "heartbeatReply");
+    m_replies.insert(reply->commandId(), reply);
+    m_pendingHeartbeat = reply->commandId();
+    m_heartbeatClock.start();
+    sendRequest(reply->requestMap());
+}
+
+void JsonRpcClient::heartbeatReply(int commandId, const QVariantMap &params)
+{
+    Q_UNUSED(params)
+    if (commandId != m_pendingHeartbeat) {
+        return;
+    }
+    m_pendingHeartbeat = -1;
+
+    int roundTripTime = static_cast<int>(m_heartbeatClock.elapsed());
+    qCDebug(dcJsonRpc()) << "Heartbeat round trip time:" << roundTripTime << "ms";
+    m_roundTripTimes.append(roundTripTime);
+    // Keep about 5 minutes worth of samples with the default interval
+    while (m_roundTripTimes.count() > 60) {
+        m_roundTripTimes.removeFirst();
+    }
+    emit roundTripTimesChanged();
+}
+
+bool JsonRpcClient::verifyCertificate()
+{
+    if (!m_connection->isEncrypted()) {
+        return true;
+    }
+
+    QByteArray oldPem;
+    QSslCertificate certificate = m_connection->sslCertificate();
+    if (!loadPem(m_serverUuid, oldPem)) {
+        qCInfo(dcJsonRpc()) << "No SSL certificate for this host stored. Accepting and pinning new certificate.";
+        // No certificate yet! Inform ui about it.
+        emit newSslCertificate();
+        storePem(m_serverUuid, m_connection->sslCertificate().toPem());
+        return true;
+    }
+
+    // We have a certificate pinned already. Check if it's the same
+    if (certificate.toPem() != oldPem) {
+        // Uh oh, the certificate has changed
+        qCWarning(dcJsonRpc()) << "This connections certificate has changed!";
+        qCWarning(dcJsonRpc()) << "Old PEM:" << oldPem;
+        qCWarning(dcJsonRpc()) << "New PEM:" << certificate.toPem();
+
+        // Extract certificate info before disconnecting.
+        QVariantMap issuerInfo = certificateIssuerInfo();
+
+        // Reject the connection until the UI explicitly accepts this...
+        m_connection->disconnectFromHost();
+
+        emit verifyConnectionCertificate(m_serverUuid, issuerInfo, certificate.toPem());
+        return false;
+    }
+    qCInfo(dcJsonRpc()) << "This connections certificate is trusted.";
+    return true;
+}
+
 JsonRpcReply::JsonRpcReply(int commandId, QString nameSpace, QString method, QVariantMap params, QPointer<QObject> caller, const QString &callback):
     m_commandId(commandId),
     m_nameSpace(nameSpace),
@@ -818,6 +1172,7 @@ JsonRpcReply::JsonRpcReply(int commandId, QString nameSpace, QString method, QVa
     m_caller(caller),
     m_callback(callback)
 {
+    m_timer.start();
 }
 
 JsonRpcReply::~JsonRpcReply()
@@ -864,3 +1219,47 @@ QString JsonRpcReply::callback() const
 {
     return m_callback;
 }
+
+qint64 JsonRpcReply::elapsed() const
+{
+    return m_timer.elapsed();
+}
+
+qint64 JsonRpcReply::sentTime() const
+{
+    return m_sentTime;
+}
+
+qint64 JsonRpcReply::firstByteTime() const
+{
+    return m_firstByteTime;
+}
+
+qint64 JsonRpcReply::completeTime() const
+{
+    return m_completeTime;
+}
+
+int JsonRpcReply::requestSize() const
+{
+    return m_requestSize;
+}
+
+int JsonRpcReply::responseSize() const
+{
+    return m_responseSize;
+}
+
+void JsonRpcReply::setSent(int requestSize)
+{
+    m_sentTime = m_timer.elapsed();
+    m_requestSize = requestSize;
+}
+
+void JsonRpcReply::setReceived(qint64 firstByteAge, int responseSize)
+{
+    m_completeTime = m_timer.elapsed();
+    // The first bytes may have been sitting in the buffer behind other messages already
+    m_firstByteTime = qBound(qMax<qint64>(0, m_sentTime), m_completeTime - firstByteAge, m_completeTime);
+    m_responseSize = responseSize;
+}
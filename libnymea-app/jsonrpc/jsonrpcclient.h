@@ -35,11 +35,14 @@
 #include <QVariantMap>
 #include <QPointer>
 #include <QVersionNumber>
+#include <QElapsedTimer>
+#include <QTimer>
 
 #include "connection/nymeaconnection.h"
 #include "types/userinfo.h"
 
 class JsonRpcReply;
+class JsonRpcStatistics;
 class Param;
 class Params;
 
@@ -65,6 +68,11 @@ class JsonRpcClient : public QObject
     Q_PROPERTY(QVariantMap certificateIssuerInfo READ certificateIssuerInfo NOTIFY currentConnectionChanged)
     Q_PROPERTY(QVariantMap experiences READ experiences NOTIFY currentConnectionChanged)
     Q_PROPERTY(UserInfo::PermissionScopes permissions READ permissions NOTIFY permissionsChanged)
+    Q_PROPERTY(int heartbeatInterval READ heartbeatInterval WRITE setHeartbeatInterval NOTIFY heartbeatIntervalChanged)
+    Q_PROPERTY(int heartbeatMissLimit READ heartbeatMissLimit WRITE setHeartbeatMissLimit NOTIFY heartbeatMissLimitChanged)
+    Q_PROPERTY(int roundTripTime READ roundTripTime NOTIFY roundTripTimesChanged)
+    Q_PROPERTY(QVariantList roundTripTimes READ roundTripTimes NOTIFY roundTripTimesChanged)
+    Q_PROPERTY(JsonRpcStatistics* statistics READ statistics CONSTANT)
 
 public:
     enum CloudConnectionState {
@@ -76,6 +84,7 @@ public:
     Q_ENUM(CloudConnectionState)
 
     explicit JsonRpcClient(QObject *parent = nullptr);
+    ~JsonRpcClient() override;
 
     void registerNotificationHandler(QObject *handler, const QString &nameSpace, const QString &method);
     void unregisterNotificationHandler(QObject *handler);
@@ -108,6 +117,22 @@ public:
     QString serverQtBuildVersion();
     QVariantMap experiences() const;
 
+    // Interval in ms for the keepalive ping while connected. 0 disables it.
+    int heartbeatInterval() const;
+    void setHeartbeatInterval(int heartbeatInterval);
+    // Number of consecutive intervals without any data from the server before the link is considered dead.
+    int heartbeatMissLimit() const;
+    void setHeartbeatMissLimit(int heartbeatMissLimit);
+    // Latest and recent keepalive round trip times in ms, oldest first.
+    int roundTripTime() const;
+    QVariantList roundTripTimes() const;
+
+    // Per method latency and payload size, and notification rates
+    JsonRpcStatistics *statistics() const;
+
+    // ms since the current transport connected, -1 if not connected
+    qint64 msecsSinceConnected() const;
+
     // ui methods
     Q_INVOKABLE void connectToHost(NymeaHost *host, Connection *connection = nullptr);
     Q_INVOKABLE void disconnectFromHost();
@@ -146,14 +171,23 @@ signals:
     void serverQtVersionChanged();
     void serverNameChanged();
     void permissionsChanged();
+    void heartbeatIntervalChanged();
+    void heartbeatMissLimitChanged();
+    void roundTripTimesChanged();
 
     void responseReceived(const int &commandId, const QVariantMap &response);
 
 private slots:
     void onInterfaceConnectedChanged(bool connected);
     void dataReceived(const QByteArray &data);
+    void onDataAppended();
+    void processReceiveBuffer();
 
     void helloReply(int commandId, const QVariantMap &params);
+    void upgradeHelloReply(int commandId, const QVariantMap &params);
+    void upgradeTransportWhenIdle();
+    void sendHeartbeat();
+    void heartbeatReply(int commandId, const QVariantMap &params);
 
 private:
     int m_id;
@@ -179,11 +213,39 @@ private:
     QString m_serverQtBuildVersion;
     QByteArray m_token;
     QByteArray m_receiveBuffer;
+    bool m_processingScheduled = false;
+    // Running since the first byte of the next message in m_receiveBuffer arrived
+    QElapsedTimer m_messageClock;
+    JsonRpcStatistics *m_statistics = nullptr;
     QHash<QString, QString> m_cacheHashes;
     QVariantMap m_experiences;
     UserInfo::PermissionScopes m_permissionScopes = UserInfo::PermissionScopeNone;
     QString m_username;
 
+    QTimer m_heartbeatTimer;
+    QElapsedTimer m_heartbeatClock;
+    int m_heartbeatMissLimit = 3;
+    int m_pendingHeartbeat = -1;
+    int m_missedHeartbeats = 0;
+    QVariantList m_roundTripTimes;
+
+    // Wire encoding negotiated in JSONRPC.Hello. Starts out as JSON on every new transport.
+    // If the server answers the Hello with "encoding": "cbor", all following requests are sent as
+    // CBOR maps and the server switches its replies once it sees the first one. Messages are told
+    // apart by their first byte: '{' for JSON, 0xa0-0xbf for a CBOR map.
+    enum Encoding {
+        EncodingJson,
+        EncodingCbor
+    };
+    Encoding m_encoding = EncodingJson;
+
+    // Connection timeline, measured from the transport being connected
+    QElapsedTimer m_sessionClock;
+    qint64 m_helloReplyTime = -1;
+
+    // Pinned certificates by server uuid, so we only hit the disk once per server
+    QHash<QUuid, QByteArray> m_pinnedCertificates;
+
     void setNotificationsEnabled();
     void getCloudConnectionStatus();
 
@@ -200,6 +262,9 @@ private:
     Q_INVOKABLE void getVersionsReply(int commandId, const QVariantMap &data);
 
     void sendRequest(const QVariantMap &request);
+    void sendHello(const QString &callback, bool withLocale = true);
+    bool takeMessage(QVariantMap &message);
+    bool verifyCertificate();
 
     bool loadPem(const QUuid &serverUud, QByteArray &pem);
     bool storePem(const QUuid &serverUuid, const QByteArray &pem);
@@ -223,6 +288,20 @@ public:
     QPointer<QObject> caller() const;
     QString callback() const;
 
+    // ms since the request has been created
+    qint64 elapsed() const;
+
+    // Timeline of the call in ms since the request has been created, -1 until reached
+    qint64 sentTime() const;
+    qint64 firstByteTime() const;
+    qint64 completeTime() const;
+    // Bytes on the wire
+    int requestSize() const;
+    int responseSize() const;
+
+    void setSent(int requestSize);
+    void setReceived(qint64 firstByteAge, int responseSize);
+
 private:
     int m_commandId;
     QString m_nameSpace;
@@ -231,6 +310,13 @@ private:
 
     QPointer<QObject> m_caller;
     QString m_callback;
+
+    QElapsedTimer m_timer;
+    qint64 m_sentTime = -1;
+    qint64 m_firstByteTime = -1;
+    qint64 m_completeTime = -1;
+    int m_requestSize = 0;
+    int m_responseSize = 0;
 };
 
 
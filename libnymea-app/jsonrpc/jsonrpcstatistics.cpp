@@ -0,0 +1,268 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "jsonrpcstatistics.h"
+
+#include <QtAlgorithms>
+#include <QDebug>
+
+#include "logging.h"
+Q_DECLARE_LOGGING_CATEGORY(dcJsonRpc)
+
+void LatencyHistogram::add(qint64 ms)
+{
+    int index = bucketIndex(ms);
+    if (index >= m_buckets.count()) {
+        m_buckets.resize(index + 1);
+    }
+    m_buckets[index]++;
+    m_count++;
+    m_max = qMax(m_max, ms);
+}
+
+int LatencyHistogram::count() const
+{
+    return m_count;
+}
+
+qint64 LatencyHistogram::max() const
+{
+    return m_max;
+}
+
+qint64 LatencyHistogram::percentile(double percent) const
+{
+    if (m_count == 0) {
+        return -1;
+    }
+    quint64 rank = qMax<quint64>(1, static_cast<quint64>(m_count * percent / 100.0 + 0.5));
+    quint64 seen = 0;
+    for (int i = 0; i < m_buckets.count(); i++) {
+        seen += m_buckets.at(i);
+        if (seen >= rank) {
+            return qMin(bucketValue(i), m_max);
+        }
+    }
+    return m_max;
+}
+
+int LatencyHistogram::bucketIndex(qint64 ms)
+{
+    if (ms < 16) {
+        return static_cast<int>(qMax<qint64>(0, ms));
+    }
+    int exponent = qMin(63 - static_cast<int>(qCountLeadingZeroBits(static_cast<quint64>(ms))), 40);
+    int sub = static_cast<int>((ms >> (exponent - 3)) & 7);
+    return 16 + (exponent - 4) * 8 + sub;
+}
+
+qint64 LatencyHistogram::bucketValue(int index)
+{
+    if (index < 16) {
+        return index;
+    }
+    int exponent = (index - 16) / 8 + 4;
+    int sub = (index - 16) % 8;
+    qint64 lower = static_cast<qint64>(8 + sub) << (exponent - 3);
+    qint64 width = Q_INT64_C(1) << (exponent - 3);
+    return lower + width / 2;
+}
+
+JsonRpcStatistics::JsonRpcStatistics(QObject *parent):
+    QAbstractListModel(parent)
+{
+    m_clock.start();
+
+    m_refreshTimer.setInterval(1000);
+    connect(&m_refreshTimer, &QTimer::timeout, this, [this](){
+        // Rates decay over time even without new messages
+        if (!m_entries.isEmpty() && (m_dirty || !m_notificationIndex.isEmpty())) {
+            m_dirty = false;
+            emit dataChanged(index(0), index(m_entries.count() - 1));
+        }
+    });
+    m_refreshTimer.start();
+}
+
+int JsonRpcStatistics::rowCount(const QModelIndex &parent) const
+{
+    Q_UNUSED(parent)
+    return m_entries.count();
+}
+
+QVariant JsonRpcStatistics::data(const QModelIndex &index, int role) const
+{
+    if (index.row() < 0 || index.row() >= m_entries.count()) {
+        return QVariant();
+    }
+    const Entry &entry = m_entries.at(index.row());
+    switch (role) {
+    case RoleName:
+        return entry.name;
+    case RoleType:
+        return entry.type;
+    case RoleCount:
+        return entry.count;
+    case RoleErrors:
+        return entry.errors;
+    case RoleP50:
+        return entry.latency.percentile(50);
+    case RoleP95:
+        return entry.latency.percentile(95);
+    case RoleP99:
+        return entry.latency.percentile(99);
+    case RoleMax:
+        return entry.latency.count() > 0 ? entry.latency.max() : -1;
+    case RoleFirstByteP50:
+        return entry.firstByte.percentile(50);
+    case RoleRequestBytes:
+        return entry.requestBytes;
+    case RoleResponseBytes:
+        return entry.responseBytes;
+    case RoleMaxResponseBytes:
+        return entry.maxResponseBytes;
+    case RoleRatePerMinute:
+        return ratePerMinute(entry);
+    }
+    return QVariant();
+}
+
+QHash<int, QByteArray> JsonRpcStatistics::roleNames() const
+{
+    QHash<int, QByteArray> roles;
+    roles.insert(RoleName, "name");
+    roles.insert(RoleType, "type");
+    roles.insert(RoleCount, "count");
+    roles.insert(RoleErrors, "errors");
+    roles.insert(RoleP50, "p50");
+    roles.insert(RoleP95, "p95");
+    roles.insert(RoleP99, "p99");
+    roles.insert(RoleMax, "max");
+    roles.insert(RoleFirstByteP50, "firstByteP50");
+    roles.insert(RoleRequestBytes, "requestBytes");
+    roles.insert(RoleResponseBytes, "responseBytes");
+    roles.insert(RoleMaxResponseBytes, "maxResponseBytes");
+    roles.insert(RoleRatePerMinute, "ratePerMinute");
+    return roles;
+}
+
+void JsonRpcStatistics::addReply(const QString &method, qint64 latency, qint64 firstByte, int requestSize, int responseSize, bool error)
+{
+    Entry &e = entry(method, EntryTypeMethod);
+    e.count++;
+    if (error) {
+        e.errors++;
+    }
+    e.latency.add(latency);
+    e.firstByte.add(firstByte);
+    e.requestBytes += requestSize;
+    e.responseBytes += responseSize;
+    e.maxResponseBytes = qMax(e.maxResponseBytes, responseSize);
+    countInWindow(e);
+    m_dirty = true;
+}
+
+void JsonRpcStatistics::addNotification(const QString &nameSpace, int size)
+{
+    Entry &e = entry(nameSpace, EntryTypeNotification);
+    e.count++;
+    e.responseBytes += size;
+    e.maxResponseBytes = qMax(e.maxResponseBytes, size);
+    countInWindow(e);
+    m_dirty = true;
+}
+
+void JsonRpcStatistics::dumpToLog() const
+{
+    qCInfo(dcJsonRpc()) << "JSON-RPC statistics over" << m_clock.elapsed() / 1000 << "s";
+    foreach (const Entry &e, m_entries) {
+        if (e.type == EntryTypeMethod) {
+            qCInfo(dcJsonRpc()).nospace().noquote() << "  " << e.name << ": " << e.count << " calls, " << e.errors << " errors"
+                                                    << ", latency p50/p95/p99/max " << e.latency.percentile(50) << "/" << e.latency.percentile(95) << "/" << e.latency.percentile(99) << "/" << e.latency.max() << " ms"
+                                                    << ", first byte p50 " << e.firstByte.percentile(50) << " ms"
+                                                    << ", sent " << e.requestBytes << " B, received " << e.responseBytes << " B (max " << e.maxResponseBytes << " B)";
+        } else {
+            qCInfo(dcJsonRpc()).nospace().noquote() << "  " << e.name << " notifications: " << e.count << " total, " << ratePerMinute(e) << "/min"
+                                                    << ", received " << e.responseBytes << " B (max " << e.maxResponseBytes << " B)";
+        }
+    }
+}
+
+void JsonRpcStatistics::reset()
+{
+    beginResetModel();
+    m_entries.clear();
+    m_methodIndex.clear();
+    m_notificationIndex.clear();
+    m_clock.start();
+    endResetModel();
+    emit countChanged();
+}
+
+JsonRpcStatistics::Entry &JsonRpcStatistics::entry(const QString &name, EntryType type)
+{
+    QHash<QString, int> &index = type == EntryTypeMethod ? m_methodIndex : m_notificationIndex;
+    auto it = index.constFind(name);
+    if (it != index.constEnd()) {
+        return m_entries[it.value()];
+    }
+    beginInsertRows(QModelIndex(), m_entries.count(), m_entries.count());
+    Entry e;
+    e.name = name;
+    e.type = type;
+    m_entries.append(e);
+    index.insert(name, m_entries.count() - 1);
+    endInsertRows();
+    emit countChanged();
+    return m_entries.last();
+}
+
+void JsonRpcStatistics::countInWindow(Entry &entry)
+{
+    qint64 second = m_clock.elapsed() / 1000;
+    int slot = second % 60;
+    if (entry.windowSeconds[slot] != second) {
+        entry.windowSeconds[slot] = second;
+        entry.windowCounts[slot] = 0;
+    }
+    entry.windowCounts[slot]++;
+}
+
+int JsonRpcStatistics::ratePerMinute(const Entry &entry) const
+{
+    qint64 second = m_clock.elapsed() / 1000;
+    int count = 0;
+    for (int i = 0; i < 60; i++) {
+        if (second - entry.windowSeconds[i] < 60) {
+            count += entry.windowCounts[i];
+        }
+    }
+    return count;
+}
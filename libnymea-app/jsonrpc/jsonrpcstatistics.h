@@ -0,0 +1,134 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef JSONRPCSTATISTICS_H
+#define JSONRPCSTATISTICS_H
+
+#include <QAbstractListModel>
+#include <QElapsedTimer>
+#include <QTimer>
+#include <QVector>
+#include <QHash>
+
+// Log-linear latency histogram: exact below 16 ms, 8 buckets per power of two above,
+// so percentiles are within ~6% of the real value at a fixed memory cost.
+class LatencyHistogram
+{
+public:
+    void add(qint64 ms);
+    int count() const;
+    qint64 max() const;
+    qint64 percentile(double percent) const;
+
+private:
+    static int bucketIndex(qint64 ms);
+    static qint64 bucketValue(int index);
+
+    QVector<quint32> m_buckets;
+    int m_count = 0;
+    qint64 m_max = 0;
+};
+
+class JsonRpcStatistics : public QAbstractListModel
+{
+    Q_OBJECT
+    Q_PROPERTY(int count READ rowCount NOTIFY countChanged)
+
+public:
+    enum EntryType {
+        EntryTypeMethod,
+        EntryTypeNotification
+    };
+    Q_ENUM(EntryType)
+
+    enum Roles {
+        RoleName,
+        RoleType,
+        RoleCount,
+        RoleErrors,
+        RoleP50,
+        RoleP95,
+        RoleP99,
+        RoleMax,
+        RoleFirstByteP50,
+        RoleRequestBytes,
+        RoleResponseBytes,
+        RoleMaxResponseBytes,
+        RoleRatePerMinute
+    };
+    Q_ENUM(Roles)
+
+    explicit JsonRpcStatistics(QObject *parent = nullptr);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role) const override;
+    QHash<int, QByteArray> roleNames() const override;
+
+    // Latencies in ms from the request being sent
+    void addReply(const QString &method, qint64 latency, qint64 firstByte, int requestSize, int responseSize, bool error);
+    void addNotification(const QString &nameSpace, int size);
+
+    Q_INVOKABLE void dumpToLog() const;
+    Q_INVOKABLE void reset();
+
+signals:
+    void countChanged();
+
+private:
+    struct Entry {
+        QString name;
+        EntryType type = EntryTypeMethod;
+        LatencyHistogram latency;
+        LatencyHistogram firstByte;
+        int count = 0;
+        int errors = 0;
+        qint64 requestBytes = 0;
+        qint64 responseBytes = 0;
+        int maxResponseBytes = 0;
+        // Per second counts of the last minute
+        qint64 windowSeconds[60] = {};
+        int windowCounts[60] = {};
+    };
+
+    Entry &entry(const QString &name, EntryType type);
+    void countInWindow(Entry &entry);
+    int ratePerMinute(const Entry &entry) const;
+
+    QVector<Entry> m_entries;
+    QHash<QString, int> m_methodIndex;
+    QHash<QString, int> m_notificationIndex;
+    QElapsedTimer m_clock;
+
+    // Views are refreshed once a second instead of on every message
+    QTimer m_refreshTimer;
+    bool m_dirty = false;
+};
+
+#endif // JSONRPCSTATISTICS_H
@@ -130,6 +130,11 @@
 #include "zigbee/zigbeenodes.h"
 #include "zigbee/zigbeenodesproxy.h"
 #include "applogcontroller.h"
+#include "tracerecorder.h"
+#include "stallwatchdog.h"
+#include "startuptimeline.h"
+#include "memorystats.h"
+#include "jsonrpc/jsonrpcstatistics.h"
 #include "tagwatcher.h"
 #include "appdata.h"
 #include "modbus/modbusrtumanager.h"
@@ -173,9 +178,15 @@ void registerQmlTypes() {
 
     qmlRegisterSingletonType<AppLogController>("Nymea", 1, 0, "AppLogController", AppLogController::appLogControllerProvider);
     qmlRegisterType<LogMessages>("Nymea", 1, 0, "LogMessages");
+    qmlRegisterSingletonType<TraceRecorder>("Nymea", 1, 0, "TraceRecorder", TraceRecorder::traceRecorderProvider);
+    qmlRegisterSingletonType<StallWatchdog>("Nymea", 1, 0, "StallWatchdog", StallWatchdog::stallWatchdogProvider);
+    qmlRegisterUncreatableType<StallEvents>("Nymea", 1, 0, "StallEvents", "Get it from the StallWatchdog");
+    qmlRegisterSingletonType<StartupTimeline>("Nymea", 1, 0, "StartupTimeline", StartupTimeline::startupTimelineProvider);
+    qmlRegisterSingletonType<MemoryStats>("Nymea", 1, 0, "MemoryStats", MemoryStats::memoryStatsProvider);
 
     qmlRegisterUncreatableType<ThingManager>(uri, 1, 0, "ThingManager", "Can't create this in QML. Get it from the Engine.");
     qmlRegisterUncreatableType<JsonRpcClient>(uri, 1, 0, "JsonRpcClient", "Can't create this in QML. Get it from the Engine.");
+    qmlRegisterUncreatableType<JsonRpcStatistics>(uri, 1, 0, "JsonRpcStatistics", "Can't create this in QML. Get it from the JsonRpcClient.");
     qmlRegisterUncreatableType<NymeaConnection>(uri, 1, 0, "NymeaConnection", "Can't create this in QML. Get it from the Engine.");
 
     // libnymea-common
@@ -32,6 +32,10 @@ SOURCES += \
     $$PWD/zigbee/zigbeenodesproxy.cpp \
     $${PWD}/logging.cpp \
     $${PWD}/applogcontroller.cpp \
+    $${PWD}/tracerecorder.cpp \
+    $${PWD}/stallwatchdog.cpp \
+    $${PWD}/startuptimeline.cpp \
+    $${PWD}/memorystats.cpp \
     $${PWD}/wifisetup/btwifisetup.cpp \
     $$PWD/modbus/modbusrtumanager.cpp \
     $$PWD/modbus/modbusrtumaster.cpp \
@@ -102,6 +106,7 @@ SOURCES += \
     $${PWD}/types/calendaritems.cpp \
     $${PWD}/types/repeatingoption.cpp \
     $${PWD}/types/tag.cpp \
+    $${PWD}/types/instancecounter.cpp \
     $${PWD}/types/tags.cpp \
     $${PWD}/types/wirelessaccesspoint.cpp \
     $${PWD}/types/wirelessaccesspoints.cpp \
@@ -117,6 +122,8 @@ SOURCES += \
     $${PWD}/connection/nymeatransportinterface.cpp \
     $${PWD}/connection/websockettransport.cpp \
     $${PWD}/connection/tcpsockettransport.cpp \
+    $${PWD}/connection/sslsessioncache.cpp \
+    $${PWD}/connection/connectionprobe.cpp \
     $${PWD}/connection/bluetoothtransport.cpp \
     $${PWD}/connection/awsclient.cpp \
     $${PWD}/connection/discovery/nymeadiscovery.cpp \
@@ -125,6 +132,7 @@ SOURCES += \
     $${PWD}/connection/discovery/bluetoothservicediscovery.cpp \
     $${PWD}/thingmanager.cpp \
     $${PWD}/jsonrpc/jsonrpcclient.cpp \
+    $${PWD}/jsonrpc/jsonrpcstatistics.cpp \
     $${PWD}/things.cpp \
     $${PWD}/thingsproxy.cpp \
     $${PWD}/thingclasses.cpp \
@@ -192,6 +200,10 @@ HEADERS += \
     $$PWD/zigbee/zigbeenodesproxy.h \
     $${PWD}/logging.h \
     $${PWD}/applogcontroller.h \
+    $${PWD}/tracerecorder.h \
+    $${PWD}/stallwatchdog.h \
+    $${PWD}/startuptimeline.h \
+    $${PWD}/memorystats.h \
     $${PWD}/wifisetup/btwifisetup.h \
     $$PWD/modbus/modbusrtumanager.h \
     $$PWD/modbus/modbusrtumaster.h \
@@ -262,6 +274,7 @@ HEADERS += \
     $${PWD}/types/calendaritems.h \
     $${PWD}/types/repeatingoption.h \
     $${PWD}/types/tag.h \
+    $${PWD}/types/instancecounter.h \
     $${PWD}/types/tags.h \
     $${PWD}/types/wirelessaccesspoint.h \
     $${PWD}/types/wirelessaccesspoints.h \
@@ -277,6 +290,8 @@ HEADERS += \
     $${PWD}/connection/nymeatransportinterface.h \
     $${PWD}/connection/websockettransport.h \
     $${PWD}/connection/tcpsockettransport.h \
+    $${PWD}/connection/sslsessioncache.h \
+    $${PWD}/connection/connectionprobe.h \
     $${PWD}/connection/bluetoothtransport.h \
     $${PWD}/connection/awsclient.h \
     $${PWD}/connection/sigv4utils.h \
@@ -286,6 +301,7 @@ HEADERS += \
     $${PWD}/connection/discovery/bluetoothservicediscovery.h \
     $${PWD}/thingmanager.h \
     $${PWD}/jsonrpc/jsonrpcclient.h \
+    $${PWD}/jsonrpc/jsonrpcstatistics.h \
     $${PWD}/things.h \
     $${PWD}/thingsproxy.h \
     $${PWD}/thingclasses.h \
@@ -0,0 +1,273 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "memorystats.h"
+
+#include <QFile>
+#include <QSettings>
+
+#ifdef Q_OS_LINUX
+#include <unistd.h>
+#endif
+
+#include "types/instancecounter.h"
+#include "types/thing.h"
+#include "types/state.h"
+#include "types/logentry.h"
+#include "types/rule.h"
+#include "types/tag.h"
+#include "types/thingclass.h"
+#include "types/statetype.h"
+#include "types/eventtype.h"
+#include "types/actiontype.h"
+#include "types/paramtype.h"
+#include "energy/energylogs.h"
+
+#include "logging.h"
+NYMEA_LOGGING_CATEGORY(dcMemoryStats, "MemoryStats")
+
+// Heap cost of a QObject beyond its sizeof(), mostly the QObjectPrivate, on 64 bit
+static const int qobjectOverhead = 120;
+// Allocation header and the node pointers of a container entry
+static const int entryOverhead = 32;
+
+static qint64 instanceSize(InstanceCounters::Type type)
+{
+    switch (type) {
+    case InstanceCounters::TypeThing:
+        return MemoryStats::objectSize(sizeof(Thing));
+    case InstanceCounters::TypeState:
+        return MemoryStats::objectSize(sizeof(State));
+    case InstanceCounters::TypeLogEntry:
+        return MemoryStats::objectSize(sizeof(LogEntry));
+    case InstanceCounters::TypeEnergyLogEntry:
+        return MemoryStats::objectSize(sizeof(EnergyLogEntry));
+    case InstanceCounters::TypeRule:
+        return MemoryStats::objectSize(sizeof(Rule));
+    case InstanceCounters::TypeTag:
+        return MemoryStats::objectSize(sizeof(Tag));
+    case InstanceCounters::TypeThingClass:
+        return MemoryStats::objectSize(sizeof(ThingClass));
+    case InstanceCounters::TypeStateType:
+        return MemoryStats::objectSize(sizeof(StateType));
+    case InstanceCounters::TypeEventType:
+        return MemoryStats::objectSize(sizeof(EventType));
+    case InstanceCounters::TypeActionType:
+        return MemoryStats::objectSize(sizeof(ActionType));
+    case InstanceCounters::TypeParamType:
+        return MemoryStats::objectSize(sizeof(ParamType));
+    case InstanceCounters::TypeCount:
+        break;
+    }
+    return 0;
+}
+
+MemoryStats::MemoryStats(QObject *parent):
+    QAbstractListModel(parent)
+{
+    connect(&m_sampleTimer, &QTimer::timeout, this, &MemoryStats::logSample);
+    int interval = sampleInterval();
+    if (interval > 0) {
+        m_sampleTimer.start(interval * 1000);
+    }
+}
+
+QObject *MemoryStats::memoryStatsProvider(QQmlEngine *engine, QJSEngine *scriptEngine)
+{
+    Q_UNUSED(engine)
+    Q_UNUSED(scriptEngine)
+    return instance();
+}
+
+MemoryStats *MemoryStats::instance()
+{
+    static MemoryStats* thiz = nullptr;
+    if (!thiz) {
+        thiz = new MemoryStats();
+    }
+    return thiz;
+}
+
+void MemoryStats::registerModel(QObject *model, std::function<qint64 ()> estimate)
+{
+    MemoryStats *stats = instance();
+    stats->m_models.insert(model, estimate);
+    connect(model, &QObject::destroyed, stats, [stats, model](){
+        stats->m_models.remove(model);
+    });
+}
+
+qint64 MemoryStats::objectSize(qint64 size)
+{
+    return size + qobjectOverhead;
+}
+
+qint64 MemoryStats::variantMapSize(const QVariantMap &map)
+{
+    qint64 size = entryOverhead;
+    for (auto it = map.constBegin(); it != map.constEnd(); ++it) {
+        size += entryOverhead + sizeof(QString) + sizeof(QVariant) + it.key().size() * 2;
+        if (it.value().type() == QVariant::String) {
+            size += entryOverhead + it.value().toString().size() * 2;
+        }
+    }
+    return size;
+}
+
+int MemoryStats::rowCount(const QModelIndex &parent) const
+{
+    Q_UNUSED(parent)
+    return m_rows.count();
+}
+
+QVariant MemoryStats::data(const QModelIndex &index, int role) const
+{
+    if (index.row() < 0 || index.row() >= m_rows.count()) {
+        return QVariant();
+    }
+    const Row &row = m_rows.at(index.row());
+    switch (role) {
+    case RoleName:
+        return row.name;
+    case RoleKind:
+        return row.kind;
+    case RoleCount:
+        return row.count;
+    case RoleBytes:
+        return row.bytes;
+    }
+    return QVariant();
+}
+
+QHash<int, QByteArray> MemoryStats::roleNames() const
+{
+    QHash<int, QByteArray> roles;
+    roles.insert(RoleName, "name");
+    roles.insert(RoleKind, "kind");
+    roles.insert(RoleCount, "count");
+    roles.insert(RoleBytes, "bytes");
+    return roles;
+}
+
+int MemoryStats::sampleInterval() const
+{
+    QSettings settings;
+    return settings.value("MemoryStatsSampleInterval", 300).toInt();
+}
+
+void MemoryStats::setSampleInterval(int sampleInterval)
+{
+    if (this->sampleInterval() == sampleInterval) {
+        return;
+    }
+    QSettings settings;
+    settings.setValue("MemoryStatsSampleInterval", sampleInterval);
+    if (sampleInterval > 0) {
+        m_sampleTimer.start(sampleInterval * 1000);
+    } else {
+        m_sampleTimer.stop();
+    }
+    emit sampleIntervalChanged();
+}
+
+qint64 MemoryStats::totalBytes() const
+{
+    // Models own most of the counted instances, so only sum up the instances
+    qint64 total = 0;
+    foreach (const Row &row, m_rows) {
+        if (row.kind == KindInstances) {
+            total += row.bytes;
+        }
+    }
+    return total;
+}
+
+qint64 MemoryStats::residentSize() const
+{
+    return m_residentSize;
+}
+
+void MemoryStats::update()
+{
+    beginResetModel();
+    m_rows.clear();
+    for (int i = 0; i < InstanceCounters::TypeCount; i++) {
+        InstanceCounters::Type type = static_cast<InstanceCounters::Type>(i);
+        int count = InstanceCounters::count(type);
+        m_rows.append({InstanceCounters::typeName(type), KindInstances, count, count * instanceSize(type)});
+    }
+
+    QMap<QString, Row> models;
+    for (auto it = m_models.constBegin(); it != m_models.constEnd(); ++it) {
+        QString name = it.key()->metaObject()->className();
+        Row &row = models[name];
+        row.name = name;
+        row.kind = KindModel;
+        row.count++;
+        row.bytes += it.value()();
+    }
+    foreach (const Row &row, models) {
+        m_rows.append(row);
+    }
+    endResetModel();
+
+    m_residentSize = 0;
+#ifdef Q_OS_LINUX
+    // Second field is the resident set in pages
+    QFile statm("/proc/self/statm");
+    if (statm.open(QFile::ReadOnly)) {
+        QList<QByteArray> fields = statm.readAll().split(' ');
+        if (fields.count() > 1) {
+            m_residentSize = fields.at(1).toLongLong() * sysconf(_SC_PAGESIZE);
+        }
+    }
+#endif
+
+    emit updated();
+}
+
+void MemoryStats::logSample()
+{
+    update();
+
+    QStringList instances;
+    QStringList models;
+    foreach (const Row &row, m_rows) {
+        QString entry = QString("%1 %2 (%3 kB)").arg(row.name).arg(row.count).arg(row.bytes / 1024);
+        if (row.kind == KindInstances) {
+            instances.append(entry);
+        } else {
+            models.append(entry);
+        }
+    }
+    qCInfo(dcMemoryStats()).noquote() << "Resident:" << m_residentSize / 1024 << "kB, counted instances:" << totalBytes() / 1024 << "kB";
+    qCInfo(dcMemoryStats()).noquote() << "Instances:" << instances.join(", ");
+    qCInfo(dcMemoryStats()).noquote() << "Models:" << (models.isEmpty() ? QString("none") : models.join(", "));
+}
@@ -0,0 +1,112 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef MEMORYSTATS_H
+#define MEMORYSTATS_H
+
+#include <QAbstractListModel>
+#include <QVariantMap>
+#include <QTimer>
+#include <QHash>
+
+#include <functional>
+
+class QQmlEngine;
+class QJSEngine;
+
+// Live instance counts of the core types and approximate memory held by the big models,
+// sampled periodically into the log. Estimates are sizeof() based plus a flat overhead per
+// QObject and container entry; good enough to spot what grows, not an exact accounting.
+class MemoryStats : public QAbstractListModel
+{
+    Q_OBJECT
+    Q_PROPERTY(int sampleInterval READ sampleInterval WRITE setSampleInterval NOTIFY sampleIntervalChanged)
+    Q_PROPERTY(qint64 totalBytes READ totalBytes NOTIFY updated)
+    Q_PROPERTY(qint64 residentSize READ residentSize NOTIFY updated)
+
+public:
+    enum Roles {
+        RoleName,
+        RoleKind,
+        RoleCount,
+        RoleBytes
+    };
+    Q_ENUM(Roles)
+
+    enum Kind {
+        KindInstances,
+        KindModel
+    };
+    Q_ENUM(Kind)
+
+    static QObject* memoryStatsProvider(QQmlEngine *engine, QJSEngine *scriptEngine);
+    static MemoryStats* instance();
+
+    // Registered models are listed by class name until they are destroyed
+    static void registerModel(QObject *model, std::function<qint64()> estimate);
+
+    static qint64 objectSize(qint64 size);
+    static qint64 variantMapSize(const QVariantMap &map);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role) const override;
+    QHash<int, QByteArray> roleNames() const override;
+
+    // s, 0 disables logging samples
+    int sampleInterval() const;
+    void setSampleInterval(int sampleInterval);
+
+    qint64 totalBytes() const;
+    // bytes, 0 where the platform doesn't tell
+    qint64 residentSize() const;
+
+    Q_INVOKABLE void update();
+    Q_INVOKABLE void logSample();
+
+signals:
+    void sampleIntervalChanged();
+    void updated();
+
+private:
+    explicit MemoryStats(QObject *parent = nullptr);
+
+    struct Row {
+        QString name;
+        Kind kind;
+        int count;
+        qint64 bytes;
+    };
+    QList<Row> m_rows;
+    QHash<QObject*, std::function<qint64()>> m_models;
+    qint64 m_residentSize = 0;
+    QTimer m_sampleTimer;
+};
+
+#endif // MEMORYSTATS_H
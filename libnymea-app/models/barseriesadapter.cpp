@@ -32,6 +32,8 @@ void BarSeriesAdapter::setBarSeries(QtCharts::QAbstractBarSeries *barSeries)
     if (m_barSeries != barSeries) {
         m_barSeries = barSeries;
         emit barSeriesChanged();
+        m_set = nullptr;
+        m_timeslots.clear();
         update();
     }
 }
@@ -54,152 +56,134 @@ void BarSeriesAdapter::update()
     if (!m_barSeries || !m_logsModel) {
         return;
     }
-    m_set = new QtCharts::QBarSet(m_barSeries->name());
-    m_barSeries->append(m_set);
+    if (!m_set) {
+        m_set = new QtCharts::QBarSet(m_barSeries->name());
+        m_barSeries->append(m_set);
+    } else {
+        m_set->remove(0, m_set->count());
+    }
+    m_timeslots.clear();
+
+    QDateTime start = m_logsModel->startTime();
+    QDateTime end = m_logsModel->endTime();
+    for (int i = 0; i < m_logsModel->rowCount(); i++) {
+        LogEntry *entry = m_logsModel->get(i);
+        if (!start.isValid() || entry->timestamp() < start) {
+            start = entry->timestamp();
+        }
+        if (!end.isValid() || entry->timestamp() > end) {
+            end = entry->timestamp();
+        }
+    }
+    if (!start.isValid()) {
+        return;
+    }
+    if (!end.isValid()) {
+        end = QDateTime::currentDateTime();
+    }
 
+    // Size the slots for the whole range up front, fill them and push all values to the set at once
+    m_firstSlot = slotNumber(start);
+    m_timeslots.resize(static_cast<int>(qMax(m_firstSlot, slotNumber(end)) - m_firstSlot) + 1);
     for (int i = 0; i < m_logsModel->rowCount(); i++) {
         LogEntry *entry = m_logsModel->get(i);
-        qDebug() << "have entry" << entry->timestamp().toString();
+        TimeSlot &timeslot = m_timeslots[slotIndex(entry->timestamp())];
+        timeslot.sum += entry->value().toDouble();
+        timeslot.count++;
     }
+    m_set->append(slotValues());
 }
 
 void BarSeriesAdapter::ensureSlots(const QDateTime &start, const QDateTime &end)
 {
-    if (!m_barSeries || !m_logsModel) {
+    if (!m_barSeries || !m_logsModel || !m_set) {
         return;
     }
 
-    QDateTime startTime = start;
-    switch (m_interval) {
-    case IntervalMinutes:
-        startTime.setTime(QTime(startTime.time().hour(), startTime.time().minute()));
-        break;
-    case IntervalHours:
-        startTime.setTime(QTime(startTime.time().hour(), 0));
-        break;
-    case IntervalDays:
-        startTime.setTime(QTime(0, 0));
-        break;
-    }
-
-
     QDateTime endTime = end;
     if (!endTime.isValid()) {
         endTime = QDateTime::currentDateTime();
     }
-    endTime.setTime(QTime(endTime.time().hour(), endTime.time().minute()));
 
-    QDateTime oldestExistingSlot;
+    qint64 firstSlot = slotNumber(start);
+    qint64 lastSlot = qMax(firstSlot, slotNumber(endTime));
+
     if (m_timeslots.isEmpty()) {
-        oldestExistingSlot = endTime;
-    } else {
-        oldestExistingSlot = m_timeslots.first().datetime;
+        m_firstSlot = firstSlot;
+        m_timeslots.resize(static_cast<int>(lastSlot - firstSlot) + 1);
+        m_set->append(slotValues());
+        return;
     }
 
-    if (startTime < oldestExistingSlot) {
-        long duration = oldestExistingSlot.toMSecsSinceEpoch() - startTime.toMSecsSinceEpoch();
-        long slotCount = duration / (m_interval * 1000);
-        qDebug() << "Need" << slotCount << "new slots appended";
+    if (firstSlot < m_firstSlot) {
+        int slotCount = static_cast<int>(m_firstSlot - firstSlot);
+        m_timeslots.insert(0, slotCount, TimeSlot());
+        m_firstSlot = firstSlot;
 
-        for (int i = 0; i < slotCount; i++) {
-            QDateTime slotTime = oldestExistingSlot.addSecs(-m_interval * (i + 1));
-//            qDebug() << "Adding" << slotTime.toString();
-            TimeSlot timeslot;
-            timeslot.datetime = slotTime;
-            m_set->insert(0, 0);
-            m_timeslots.prepend(timeslot);
-        }
+        // All indices shift, replace the set's values in one go
+        m_set->remove(0, m_set->count());
+        m_set->append(slotValues());
     }
 
-    QDateTime newestExistingSlot;
-    if (m_timeslots.isEmpty()) {
-        newestExistingSlot = startTime;
-    } else {
-        newestExistingSlot = m_timeslots.last().datetime;
+    qint64 newestExistingSlot = m_firstSlot + m_timeslots.count() - 1;
+    if (lastSlot > newestExistingSlot) {
+        int slotCount = static_cast<int>(lastSlot - newestExistingSlot);
+        m_timeslots.resize(m_timeslots.count() + slotCount);
+        m_set->append(QVector<qreal>(slotCount, 0).toList());
     }
+}
 
-    if (endTime > newestExistingSlot) {
-        long duration = endTime.toMSecsSinceEpoch() - newestExistingSlot.toMSecsSinceEpoch();
-        long slotCount = duration / (m_interval * 1000);
-//        qDebug() << "Need" << slotCount << "new slots prepended";
+qint64 BarSeriesAdapter::slotNumber(const QDateTime &dateTime) const
+{
+    if (m_interval == IntervalDays) {
+        // Days around a DST change are 23 or 25 hours long, count them by calendar date
+        return dateTime.date().toJulianDay();
+    }
+    // Align slots to local time so hours start at full local hours
+    int offset = dateTime.offsetFromUtc();
+    qint64 localSecs = dateTime.toSecsSinceEpoch() + offset;
+    return (localSecs - (localSecs % m_interval) - offset) / m_interval;
+}
 
-        for (int i = 0; i < slotCount; i++) {
-            QDateTime slotTime = newestExistingSlot.addSecs(m_interval * (i + 1));
-            TimeSlot timeslot;
-            timeslot.datetime = slotTime;
-            m_set->append(0);
-            m_timeslots.append(timeslot);
-        }
-    }
+int BarSeriesAdapter::slotIndex(const QDateTime &dateTime) const
+{
+    return static_cast<int>(slotNumber(dateTime) - m_firstSlot);
+}
 
-    if (m_timeslots.isEmpty()) {
-//        qDebug() << "Need to initialize list with 1 entry";
-        TimeSlot timeslot;
-        timeslot.datetime = startTime;
-        m_set->append(0);
-        m_timeslots.append(timeslot);
+QList<qreal> BarSeriesAdapter::slotValues() const
+{
+    QList<qreal> values;
+    values.reserve(m_timeslots.count());
+    foreach (const TimeSlot &timeslot, m_timeslots) {
+        values.append(timeslot.value());
     }
-
-    qDebug() << "Ensuring slots from" << start << "to" << end << "oldest" << oldestExistingSlot << "newest" << newestExistingSlot;
-
+    return values;
 }
 
 void BarSeriesAdapter::logEntryAdded(LogEntry *entry)
 {
-    qDebug() << "****"  << m_barSeries << m_logsModel;
-    if (!m_barSeries || !m_logsModel) {
+    if (!m_barSeries || !m_logsModel || !m_set) {
         return;
     }
     ensureSlots(QDateTime::fromMSecsSinceEpoch(qMin(m_logsModel->startTime().toMSecsSinceEpoch(), entry->timestamp().toMSecsSinceEpoch())), QDateTime::fromMSecsSinceEpoch(qMax(m_logsModel->endTime().toMSecsSinceEpoch(), entry->timestamp().toMSecsSinceEpoch())));
 
-    QDateTime timestamp = entry->timestamp();
-
-    QDateTime timeSlotStart = timestamp;
-    switch (m_interval) {
-    case IntervalMinutes:
-        timeSlotStart.setTime(QTime(timestamp.time().hour(), timestamp.time().minute()));
-        break;
-    case IntervalHours:
-        timeSlotStart.setTime(QTime(timestamp.time().hour(), 0));
-        break;
-    case IntervalDays:
-        timeSlotStart.setTime(QTime(0, 0));
-        break;
+    int slotIdx = slotIndex(entry->timestamp());
+    if (slotIdx < 0 || slotIdx >= m_timeslots.count()) {
+        qWarning() << "Log entry" << entry->timestamp() << "out of range for bar series";
+        return;
     }
 
-//    qDebug() << "Item time:" << timeSlotStart;
-
-    TimeSlot first = m_timeslots.first();
-    TimeSlot last = m_timeslots.last();
-    long slotIdx = (timeSlotStart.toMSecsSinceEpoch() - first.datetime.toMSecsSinceEpoch()) / (m_interval * 1000);
-    qDebug() << "first" << first.datetime.toString();
-    qDebug() << "last" << last.datetime.toString();
-    qDebug() << "this" << timeSlotStart.toString();
-    qDebug() << "idx" << slotIdx;
-
-
-    m_timeslots[slotIdx].entries.append(entry);
-    m_set->replace(slotIdx, m_timeslots[slotIdx].value());
-//    qDebug() << "Adding entry" << entry->timestamp() << "timestlot" << timeSlotStart << "at" << slotIdx << "value" << m_timeslots[slotIdx].value();
-
-//    if (!m_timeslots.contains(timeSlotStart)) {
-//        TimeSlot timeslot;
-//        timeslot.startTime = timeSlotStart;
-
-
-//    }
-//    TimeSlot timeslot = m_timeslots.value(timeSlotStart);
-//    timeslot.entries.append(entry);
+    TimeSlot &timeslot = m_timeslots[slotIdx];
+    timeslot.sum += entry->value().toDouble();
+    timeslot.count++;
+    m_set->replace(slotIdx, timeslot.value());
+//    qDebug() << "Adding entry" << entry->timestamp() << "at" << slotIdx << "value" << timeslot.value();
 }
 
 qreal BarSeriesAdapter::TimeSlot::value() const
 {
-    qreal value = 0;
-    foreach (LogEntry *entry, entries) {
-        value += entry->value().toDouble();
-    }
-    if (entries.count() > 1) {
-       value /= entries.count();
+    if (count > 1) {
+        return sum / count;
     }
-    return value;
+    return sum;
 }
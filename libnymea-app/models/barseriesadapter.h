@@ -43,6 +43,9 @@ private:
     void update();
 
     void ensureSlots(const QDateTime &start, const QDateTime &end);
+    qint64 slotNumber(const QDateTime &dateTime) const;
+    int slotIndex(const QDateTime &dateTime) const;
+    QList<qreal> slotValues() const;
 
 private slots:
     void logEntryAdded(LogEntry *entry);
@@ -50,8 +53,8 @@ private slots:
 private:
     class TimeSlot {
     public:
-        QDateTime datetime;
-        QList<LogEntry*> entries;
+        qreal sum = 0;
+        int count = 0;
         qreal value() const;
     };
 
@@ -60,7 +63,9 @@ private:
     QtCharts::QBarSet *m_set = nullptr;
     Interval m_interval = IntervalMinutes;
 
-    QList<TimeSlot> m_timeslots;
+    // Slot i holds slot number m_firstSlot + i, see slotNumber()
+    QVector<TimeSlot> m_timeslots;
+    qint64 m_firstSlot = 0;
 };
 
 #endif // BARSERIESADAPTER_H
@@ -37,6 +37,9 @@
 #include "engine.h"
 #include "types/logentry.h"
 #include "logmanager.h"
+#include "tracerecorder.h"
+#include "stallwatchdog.h"
+#include "memorystats.h"
 
 #include "logging.h"
 NYMEA_LOGGING_CATEGORY(dcLogEngine, "LogEngine")
@@ -44,7 +47,7 @@ NYMEA_LOGGING_CATEGORY(dcLogEngine, "LogEngine")
 
 LogsModel::LogsModel(QObject *parent) : QAbstractListModel(parent)
 {
-
+    MemoryStats::registerModel(this, [this](){ return estimatedSize(); });
 }
 
 Engine *LogsModel::engine() const
@@ -293,6 +296,8 @@ LogEntry *LogsModel::findClosest(const QDateTime &dateTime)
 
 void LogsModel::logsReply(int /*commandId*/, const QVariantMap &data)
 {
+    TraceSpan span("logs", "LogsModel::logsReply");
+    StallActivity activity("model", QStringLiteral("LogsModel insert"));
     int offset = data.value("offset").toInt() + m_generatedEntries;
     int count = data.value("count").toInt();
 
@@ -466,3 +471,9 @@ void LogsModel::newLogEntryReceived(const QVariantMap &data)
     emit logEntryAdded(entry);
 
 }
+
+qint64 LogsModel::estimatedSize() const
+{
+    qint64 size = m_list.count() * (sizeof(LogEntry*) + MemoryStats::objectSize(sizeof(LogEntry)));
+    return size;
+}
@@ -106,6 +106,9 @@ public:
     Q_INVOKABLE LogEntry* get(int index) const;
     Q_INVOKABLE LogEntry* findClosest(const QDateTime &dateTime);
 
+    // bytes held by the fetched log entries
+    qint64 estimatedSize() const;
+
 
 signals:
     void engineChanged();
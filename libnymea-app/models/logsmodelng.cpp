@@ -37,13 +37,16 @@
 #include "engine.h"
 #include "types/logentry.h"
 #include "logmanager.h"
+#include "tracerecorder.h"
+#include "stallwatchdog.h"
+#include "memorystats.h"
 
 #include "logging.h"
 Q_DECLARE_LOGGING_CATEGORY(dcLogEngine)
 
 LogsModelNg::LogsModelNg(QObject *parent) : QAbstractListModel(parent)
 {
-
+    MemoryStats::registerModel(this, [this](){ return estimatedSize(); });
 }
 
 Engine *LogsModelNg::engine() const
@@ -170,6 +173,14 @@ void LogsModelNg::setTypeIds(const QStringList &typeIds)
         qDeleteAll(m_list);
         m_list.clear();
         endResetModel();
+        // Any request still in flight is for the old filter. Drop its reply when it arrives.
+        m_pendingFetchId = -1;
+        m_canFetchMore = true;
+        m_lastBlockSpan = 0;
+        if (m_busy) {
+            m_busy = false;
+            emit busyChanged();
+        }
         fetchMore();
     }
 }
@@ -218,16 +229,42 @@ QDateTime LogsModelNg::viewStartTime() const
 void LogsModelNg::setViewStartTime(const QDateTime &viewStartTime)
 {
     if (m_viewStartTime != viewStartTime) {
+        // Track the pan velocity. Samples further apart than a second mean the user stopped in between.
+        if (m_viewStartTime.isValid() && m_viewChangeTimer.isValid() && m_viewChangeTimer.elapsed() < 1000) {
+            qint64 elapsed = qMax(Q_INT64_C(1), m_viewChangeTimer.elapsed());
+            qreal velocity = static_cast<qreal>(viewStartTime.msecsTo(m_viewStartTime)) / elapsed;
+            m_panVelocity = 0.7 * m_panVelocity + 0.3 * velocity;
+        } else {
+            m_panVelocity = 0;
+        }
+        m_viewChangeTimer.start();
+
         m_viewStartTime = viewStartTime;
         emit viewStartTimeChanged();
         if (m_list.count() == 0 || m_list.last()->timestamp() > m_viewStartTime) {
             if (canFetchMore()) {
                 fetchMore();
             }
+        } else {
+            updatePrefetch();
         }
     }
 }
 
+int LogsModelNg::prefetchBlocks() const
+{
+    return m_prefetchBlocks;
+}
+
+void LogsModelNg::setPrefetchBlocks(int prefetchBlocks)
+{
+    if (m_prefetchBlocks != prefetchBlocks) {
+        m_prefetchBlocks = prefetchBlocks;
+        emit prefetchBlocksChanged();
+        updatePrefetch();
+    }
+}
+
 QVariant LogsModelNg::minValue() const
 {
 
@@ -249,7 +286,20 @@ LogEntry *LogsModelNg::get(int index) const
 
 void LogsModelNg::logsReply(int commandId, const QVariantMap &data)
 {
-    Q_UNUSED(commandId)
+    if (commandId != m_pendingFetchId) {
+        qCDebug(dcLogEngine()) << "Discarding outdated logs reply" << commandId;
+        return;
+    }
+    m_pendingFetchId = -1;
+    m_lastRoundTrip = m_fetchTimer.elapsed();
+    insertBlock(data);
+}
+
+void LogsModelNg::insertBlock(const QVariantMap &data)
+{
+    TraceSpan span("logs", "LogsModelNg::insertBlock");
+    StallActivity activity("model", QStringLiteral("LogsModelNg insert"));
+
     int offset = data.value("offset").toInt();
     int count = data.value("count").toInt();
 
@@ -278,11 +328,15 @@ void LogsModelNg::logsReply(int commandId, const QVariantMap &data)
     }
 
     if (newBlock.isEmpty()) {
-        m_busy = false;
-        emit busyChanged();
+        if (m_busy) {
+            m_busy = false;
+            emit busyChanged();
+        }
         return;
     }
 
+    m_lastBlockSpan = newBlock.last()->timestamp().msecsTo(newBlock.first()->timestamp());
+
     beginInsertRows(QModelIndex(), offset, offset + newBlock.count() - 1);
     QVariant newMin = m_minValue;
     QVariant newMax = m_maxValue;
@@ -368,11 +422,15 @@ void LogsModelNg::logsReply(int commandId, const QVariantMap &data)
         emit maxValueChanged();
     }
 
-    m_busy = false;
-    emit busyChanged();
+    if (m_busy) {
+        m_busy = false;
+        emit busyChanged();
+    }
 
     if (m_viewStartTime.isValid() && m_list.count() > 0 && m_list.last()->timestamp() > m_viewStartTime && canFetchMore()) {
         fetchMore();
+    } else {
+        updatePrefetch();
     }
 }
 
@@ -399,6 +457,16 @@ void LogsModelNg::fetchMore(const QModelIndex &parent)
     m_busy = true;
     emit busyChanged();
 
+    // A prefetch for this block is already on its way, just wait for it
+    if (m_pendingFetchId != -1) {
+        return;
+    }
+
+    requestBlock();
+}
+
+void LogsModelNg::requestBlock()
+{
     QVariantMap params;
     if (!m_thingId.isNull()) {
         QVariantList thingIds;
@@ -426,10 +494,42 @@ void LogsModelNg::fetchMore(const QModelIndex &parent)
 
 //    qDebug() << "Fetching logs:" << qUtf8Printable(QJsonDocument::fromVariant(params).toJson());
 
-    m_engine->jsonRpcClient()->sendCommand("Logging.GetLogEntries", params, this, "logsReply");
+    m_fetchTimer.start();
+    m_pendingFetchId = m_engine->jsonRpcClient()->sendCommand("Logging.GetLogEntries", params, this, "logsReply");
 //    qDebug() << "GetLogEntries called";
 }
 
+void LogsModelNg::updatePrefetch()
+{
+    if (!m_ready || !m_engine || m_pendingFetchId != -1 || !canFetchMore() || m_prefetchBlocks <= 0) {
+        return;
+    }
+    if (!m_viewStartTime.isValid() || m_list.isEmpty() || m_lastBlockSpan <= 0) {
+        return;
+    }
+    if ((!m_startTime.isNull() && m_endTime.isNull()) || (m_startTime.isNull() && !m_endTime.isNull())) {
+        return;
+    }
+
+    // Moving towards newer data, nothing to prefetch. When standing still, keep one block ahead,
+    // when panning back keep m_prefetchBlocks ahead or whatever the pan covers during two round trips.
+    if (m_panVelocity < 0) {
+        return;
+    }
+    qint64 lookAhead = m_lastBlockSpan;
+    if (m_panVelocity > 0) {
+        lookAhead = qMax(m_lastBlockSpan * m_prefetchBlocks, static_cast<qint64>(m_panVelocity * m_lastRoundTrip * 2));
+    }
+
+    qint64 loadedAhead = m_list.last()->timestamp().msecsTo(m_viewStartTime);
+    if (loadedAhead > lookAhead) {
+        return;
+    }
+
+    qCDebug(dcLogEngine()) << "Prefetching logs. Loaded ahead:" << loadedAhead << "ms, look ahead:" << lookAhead << "ms";
+    requestBlock();
+}
+
 bool LogsModelNg::canFetchMore(const QModelIndex &parent) const
 {
     Q_UNUSED(parent)
@@ -525,4 +625,9 @@ void LogsModelNg::newLogEntryReceived(const QVariantMap &data)
 
 }
 
-
+qint64 LogsModelNg::estimatedSize() const
+{
+    qint64 size = m_list.count() * (sizeof(LogEntry*) + MemoryStats::objectSize(sizeof(LogEntry)));
+    size += m_fetchedPeriods.count() * sizeof(QPair<QDateTime, bool>);
+    return size;
+}
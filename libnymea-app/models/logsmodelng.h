@@ -34,6 +34,7 @@
 #include <QObject>
 #include <QAbstractListModel>
 #include <QDateTime>
+#include <QElapsedTimer>
 #include <QLineSeries>
 #include <QUuid>
 #include <QQmlParserStatus>
@@ -58,6 +59,7 @@ class LogsModelNg : public QAbstractListModel, public QQmlParserStatus
 
     Q_PROPERTY(QtCharts::QXYSeries *graphSeries READ graphSeries WRITE setGraphSeries NOTIFY graphSeriesChanged)
     Q_PROPERTY(QDateTime viewStartTime READ viewStartTime WRITE setViewStartTime NOTIFY viewStartTimeChanged)
+    Q_PROPERTY(int prefetchBlocks READ prefetchBlocks WRITE setPrefetchBlocks NOTIFY prefetchBlocksChanged)
 
 public:
     enum Roles {
@@ -103,11 +105,17 @@ public:
     QDateTime viewStartTime() const;
     void setViewStartTime(const QDateTime &viewStartTime);
 
+    int prefetchBlocks() const;
+    void setPrefetchBlocks(int prefetchBlocks);
+
     QVariant minValue() const;
     QVariant maxValue() const;
 
     Q_INVOKABLE LogEntry *get(int index) const;
 
+    // bytes held by the fetched log entries
+    qint64 estimatedSize() const;
+
 protected:
     virtual void fetchMore(const QModelIndex &parent = QModelIndex()) override;
     virtual bool canFetchMore(const QModelIndex &parent = QModelIndex()) const override;
@@ -123,14 +131,19 @@ signals:
     void engineChanged();
     void graphSeriesChanged();
     void viewStartTimeChanged();
+    void prefetchBlocksChanged();
     void minValueChanged();
     void maxValueChanged();
 
 private slots:
     void newLogEntryReceived(const QVariantMap &data);
     void logsReply(int commandId, const QVariantMap &data);
+    void insertBlock(const QVariantMap &data);
 
 private:
+    void requestBlock();
+    void updatePrefetch();
+
     QList<LogEntry*> m_list;
 
     Engine *m_engine = nullptr;
@@ -147,6 +160,16 @@ private:
     QVariant m_maxValue;
     bool m_ready = false;
 
+    // Background prefetching while panning
+    // m_panVelocity is in ms of timeline per ms of wall clock, positive when moving back in history
+    int m_prefetchBlocks = 2;
+    int m_pendingFetchId = -1;
+    QElapsedTimer m_fetchTimer;
+    qint64 m_lastRoundTrip = 0;
+    qint64 m_lastBlockSpan = 0;
+    QElapsedTimer m_viewChangeTimer;
+    qreal m_panVelocity = 0;
+
     QtCharts::QXYSeries *m_graphSeries = nullptr;
 
     QList<QPair<QDateTime, bool> > m_fetchedPeriods;
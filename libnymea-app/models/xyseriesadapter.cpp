@@ -1,4 +1,5 @@
 #include "xyseriesadapter.h"
+#include "memorystats.h"
 
 #include <QDebug>
 
@@ -7,7 +8,7 @@ Q_DECLARE_LOGGING_CATEGORY(dcLogEngine)
 
 XYSeriesAdapter::XYSeriesAdapter(QObject *parent) : QObject(parent)
 {
-
+    MemoryStats::registerModel(this, [this](){ return estimatedSize(); });
 }
 
 LogsModel *XYSeriesAdapter::logsModel() const
@@ -50,36 +51,13 @@ void XYSeriesAdapter::setBaseSeries(QtCharts::QXYSeries *series)
         emit baseSeriesChanged();
 
         connect(m_baseSeries, &QtCharts::QXYSeries::pointAdded, this, [=](int index){
-            if (m_series->count() > index) {
-                qreal value = calculateSampleValue(index);
-                m_series->replace(index, m_series->at(index).x(), value);
-                if (value < m_minValue) {
-                    m_minValue = value;
-//                    qDebug() << "New min:" << m_minValue;
-                    emit minValueChanged();
-                }
-                if (value > m_maxValue) {
-                    m_maxValue = value;
-//                    qDebug() << "New max:" << m_maxValue;
-                    emit maxValueChanged();
-                }
-            }
+            updatePoints(index, index);
         });
         connect(m_baseSeries, &QtCharts::QXYSeries::pointReplaced, this, [=](int index){
-            if (m_series->count() > index) {
-                qreal value = calculateSampleValue(index);
-                m_series->replace(index, m_series->at(index).x(), value);
-                if (value < m_minValue) {
-                    m_minValue = value;
-//                    qDebug() << "New min:" << m_minValue;
-                    emit minValueChanged();
-                }
-                if (value > m_maxValue) {
-                    m_maxValue = value;
-//                    qDebug() << "New max:" << m_maxValue;
-                    emit maxValueChanged();
-                }
-            }
+            updatePoints(index, index);
+        });
+        connect(m_baseSeries, &QtCharts::QXYSeries::pointsReplaced, this, [=](){
+            updatePoints(0, m_buckets.count() - 1);
         });
     }
 }
@@ -140,29 +118,51 @@ void XYSeriesAdapter::ensureSamples(const QDateTime &from, const QDateTime &to)
         return;
     }
 
-    if (m_samples.isEmpty()) {
-        Sample *sample = new Sample();
-        sample->timestamp = from.addSecs(m_sampleRate);
-        m_newestSample = sample->timestamp;
+    qint64 sampleSize = static_cast<qint64>(m_sampleRate) * 1000;
+    qint64 fromMSecs = from.toMSecsSinceEpoch();
+    qint64 toMSecs = to.toMSecsSinceEpoch();
+
+    if (m_buckets.isEmpty()) {
+        m_newestSample = fromMSecs + sampleSize;
         m_oldestSample = m_newestSample;
-        m_samples.append(sample);
-        m_series->insert(0, QPointF(sample->timestamp.toMSecsSinceEpoch(), 0));
+        m_buckets.append(Bucket());
+        m_series->insert(0, QPointF(m_newestSample, 0));
     }
 
-    while (to > m_newestSample) {
-        Sample *sample = new Sample();
-        sample->timestamp = m_newestSample.addSecs(m_sampleRate);
-        m_newestSample = sample->timestamp;
-        m_samples.prepend(sample);
-        m_series->insert(0, QPointF(sample->timestamp.toMSecsSinceEpoch(), 0));
+    if (toMSecs > m_newestSample) {
+        int newBuckets = static_cast<int>((toMSecs - m_newestSample + sampleSize - 1) / sampleSize);
+
+        // New buckets start off with whatever the previously newest one ended with
+        Bucket bucket;
+        const Bucket &previous = m_buckets.first();
+        bucket.hasCarry = previous.count > 0 || previous.hasCarry;
+        bucket.carry = previous.count > 0 ? previous.lastValue : previous.carry;
+
+        m_buckets.insert(0, newBuckets, bucket);
+        m_newestSample += newBuckets * sampleSize;
+
+        // Shifting all indices, hand the whole series over in one go instead of inserting at the front point by point
+        QVector<QPointF> points;
+        points.reserve(m_buckets.count());
+        for (int i = 0; i < newBuckets; i++) {
+            points.append(QPointF(m_newestSample - i * sampleSize, 0));
+        }
+        points.append(m_series->pointsVector());
+        m_series->replace(points);
+        updatePoints(0, newBuckets - 1);
     }
 
-    while (from < m_oldestSample.addSecs(m_sampleRate)) {
-        Sample *sample = new Sample();
-        sample->timestamp = m_oldestSample.addSecs(-m_sampleRate);
-        m_oldestSample = sample->timestamp;
-        m_samples.append(sample);
-        m_series->append(sample->timestamp.toMSecsSinceEpoch(), 0);
+    if (fromMSecs < m_oldestSample + sampleSize) {
+        int newBuckets = static_cast<int>((m_oldestSample + sampleSize - fromMSecs + sampleSize - 1) / sampleSize);
+        m_buckets.resize(m_buckets.count() + newBuckets);
+
+        QList<QPointF> points;
+        points.reserve(newBuckets);
+        for (int i = 1; i <= newBuckets; i++) {
+            points.append(QPointF(m_oldestSample - i * sampleSize, 0));
+        }
+        m_oldestSample -= newBuckets * sampleSize;
+        m_series->append(points);
     }
 }
 
@@ -174,66 +174,55 @@ void XYSeriesAdapter::logEntryAdded(LogEntry *entry)
 
     ensureSamples(entry->timestamp(), entry->timestamp());
 
-    int idx = entry->timestamp().secsTo(m_newestSample) / m_sampleRate;
-    if (idx > m_samples.count()) {
+    qint64 timestamp = entry->timestamp().toMSecsSinceEpoch();
+    qint64 bucketIndex = (m_newestSample - timestamp) / (static_cast<qint64>(m_sampleRate) * 1000);
+    if (bucketIndex < 0 || bucketIndex >= m_buckets.count()) {
         qCWarning(dcLogEngine) << objectName() << "Overflowing integer size for XYSeriesAdapter!";
         return;
     }
+    int idx = static_cast<int>(bucketIndex);
 //    qCDebug(dcLogEngine()) << objectName() << "Inserting sample at:" << idx << entry->timestamp();
-    Sample *sample = m_samples.at(idx);
-    LogEntry *oldLast = nullptr;
-    // In theory we'd need to insert sorted, but only the last one actually matters for subsequent samples
-    // For the current sample we're calculating the median anyways, so just append/prepend t be a bit faster
-    if (sample->entries.count() > 0 && sample->entries.last()->timestamp() < entry->timestamp()) {
-        oldLast = sample->entries.last();
-        sample->entries.append(entry);
+    Bucket &bucket = m_buckets[idx];
+    qreal entryValue = entry->value().toDouble();
+    bucket.sum += entryValue;
+    if (bucket.count == 0) {
+        bucket.min = entryValue;
+        bucket.max = entryValue;
     } else {
-        sample->entries.prepend(entry);
-    }
-    LogEntry *newLast = sample->entries.last();
-
-    qreal value = calculateSampleValue(idx);
-    m_series->replace(idx, sample->timestamp.toMSecsSinceEpoch(), value);
-//    qWarning() << "sample value added" << idx << entry->timestamp().time().toString("hh:mm:ss") << value;
-
-    if (value < m_minValue) {
-        m_minValue = value;
-//        qDebug() << "New min:" << m_minValue;
-        emit minValueChanged();
+        bucket.min = qMin(bucket.min, entryValue);
+        bucket.max = qMax(bucket.max, entryValue);
     }
-    if (value > m_maxValue) {
-        m_maxValue = value;
-//        qDebug() << "New max:" << m_maxValue;
-        emit maxValueChanged();
+    bool newestChanged = bucket.count == 0 || timestamp >= bucket.lastTimestamp;
+    bucket.count++;
+    if (newestChanged) {
+        bucket.lastTimestamp = timestamp;
+        bucket.lastValue = entryValue;
     }
 
-    // check if we need to update more samples
-    for (int i = idx - 1; i >= 0; i--) {
-        Sample *nextSample = m_samples.at(i);
-        if (nextSample->startingPoint == oldLast) {
-            nextSample->startingPoint = newLast;
-            qreal value = calculateSampleValue(i);
-//            qWarning() << "Updating" << i << value;
-            m_series->replace(i, nextSample->timestamp.toMSecsSinceEpoch(), value);
-
-        } else {
-            break;
+    // If this became the newest value for this bucket, all the following empty buckets carry it on,
+    // up to and including the next one that has values of its own.
+    int first = idx;
+    if (newestChanged) {
+        for (int i = idx - 1; i >= 0; i--) {
+            Bucket &nextBucket = m_buckets[i];
+            nextBucket.hasCarry = true;
+            nextBucket.carry = entryValue;
+            first = i;
+            if (nextBucket.count > 0) {
+                break;
+            }
         }
     }
+    updatePoints(first, idx);
 }
 
 qreal XYSeriesAdapter::calculateSampleValue(int index)
 {
-    Sample *sample = m_samples.at(index);
-    qreal value = 0;
-    int count = 0;
-    if (sample->startingPoint) {
-        value = sample->startingPoint->value().toDouble();
-        count++;
-    }
-
-    foreach (LogEntry *entry, sample->entries) {
-        value += entry->value().toDouble();
+    const Bucket &bucket = m_buckets.at(index);
+    qreal value = bucket.sum;
+    int count = bucket.count;
+    if (bucket.hasCarry) {
+        value += bucket.carry;
         count++;
     }
 
@@ -251,3 +240,56 @@ qreal XYSeriesAdapter::calculateSampleValue(int index)
 
     return value;
 }
+
+void XYSeriesAdapter::updateMinMax(qreal value)
+{
+    if (value < m_minValue) {
+        m_minValue = value;
+//        qDebug() << "New min:" << m_minValue;
+        emit minValueChanged();
+    }
+    if (value > m_maxValue) {
+        m_maxValue = value;
+//        qDebug() << "New max:" << m_maxValue;
+        emit maxValueChanged();
+    }
+}
+
+void XYSeriesAdapter::updatePoints(int first, int last)
+{
+    if (!m_series) {
+        return;
+    }
+    last = qMin(last, qMin(m_buckets.count(), m_series->count()) - 1);
+    if (first < 0 || first > last) {
+        return;
+    }
+
+    // Every replace() call causes the chart to update. For more than a handful of points,
+    // hand over the complete series at once.
+    if (last - first < 8) {
+        for (int i = first; i <= last; i++) {
+            qreal value = calculateSampleValue(i);
+            m_series->replace(i, m_series->at(i).x(), value);
+            updateMinMax(value);
+        }
+        return;
+    }
+
+    QVector<QPointF> points = m_series->pointsVector();
+    for (int i = first; i <= last; i++) {
+        qreal value = calculateSampleValue(i);
+        points[i].setY(value);
+        updateMinMax(value);
+    }
+    m_series->replace(points);
+}
+
+qint64 XYSeriesAdapter::estimatedSize() const
+{
+    qint64 size = m_buckets.capacity() * sizeof(Bucket);
+    if (m_series) {
+        size += m_series->count() * sizeof(QPointF);
+    }
+    return size;
+}
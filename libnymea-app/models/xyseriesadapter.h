@@ -55,6 +55,9 @@ public:
 
     Q_INVOKABLE void ensureSamples(const QDateTime &from, const QDateTime &to);
 
+    // bytes held by the sample buckets and the points in the series
+    qint64 estimatedSize() const;
+
 signals:
     void xySeriesChanged();
     void logsModelChanged();
@@ -70,13 +73,22 @@ private slots:
 
 private:
     qreal calculateSampleValue(int index);
+    void updateMinMax(qreal value);
+    void updatePoints(int first, int last);
 
 private:
-    class Sample {
+    // Running aggregates for one sample bucket. A bucket ends at m_newestSample - index * m_sampleRate
+    // and covers the sampleRate seconds before that.
+    class Bucket {
     public:
-        QDateTime timestamp; // The timestamp where this sample *ends*
-        QList<LogEntry*> entries; // all log entries in this sample, that is, from timestamp - smaple size to timestamp
-        LogEntry *startingPoint = nullptr; // the starting point for the sample. Normally the last entry of the previous sample
+        qreal sum = 0;
+        int count = 0;
+        qreal min = 0;
+        qreal max = 0;
+        qint64 lastTimestamp = 0; // msecs since epoch of the newest entry in this bucket
+        qreal lastValue = 0;
+        bool hasCarry = false; // the newest value of the previous (older) buckets, the starting point for this bucket
+        qreal carry = 0;
     };
     LogsModel* m_model = nullptr;
     QtCharts::QXYSeries* m_series = nullptr;
@@ -85,9 +97,10 @@ private:
     bool m_smooth = true;
     bool m_inverted = false;
 
-    QVector<Sample*> m_samples;
-    QDateTime m_newestSample;
-    QDateTime m_oldestSample;
+    // Same order as the series, index 0 is the newest bucket
+    QVector<Bucket> m_buckets;
+    qint64 m_newestSample = 0; // msecs since epoch
+    qint64 m_oldestSample = 0;
 
     qreal m_maxValue = 0;
     qreal m_minValue = 0;
@@ -0,0 +1,314 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "stallwatchdog.h"
+
+#include <QCoreApplication>
+#include <QGuiApplication>
+#include <QSemaphore>
+#include <QSettings>
+#include <QThread>
+
+#include "logging.h"
+NYMEA_LOGGING_CATEGORY(dcStallWatchdog, "StallWatchdog")
+
+static const int pingInterval = 200;
+static const int maxStallEvents = 50;
+
+class StallWatchdogThread: public QThread
+{
+public:
+    StallWatchdogThread(StallWatchdog *watchdog): QThread(watchdog), m_watchdog(watchdog) {}
+
+    void stop() {
+        m_stop.release();
+        wait();
+    }
+
+protected:
+    void run() override {
+        while (!m_stop.tryAcquire(1, pingInterval)) {
+            m_watchdog->check();
+        }
+    }
+
+private:
+    StallWatchdog *m_watchdog;
+    QSemaphore m_stop;
+};
+
+StallEvents::StallEvents(QObject *parent):
+    QAbstractListModel(parent)
+{
+}
+
+int StallEvents::rowCount(const QModelIndex &parent) const
+{
+    Q_UNUSED(parent)
+    return m_events.count();
+}
+
+QVariant StallEvents::data(const QModelIndex &index, int role) const
+{
+    if (index.row() < 0 || index.row() >= m_events.count()) {
+        return QVariant();
+    }
+    const StallEvent &event = m_events.at(index.row());
+    switch (role) {
+    case RoleTimestamp:
+        return event.timestamp;
+    case RoleDuration:
+        return event.duration;
+    case RoleActivity:
+        return event.activity;
+    }
+    return QVariant();
+}
+
+QHash<int, QByteArray> StallEvents::roleNames() const
+{
+    QHash<int, QByteArray> roles;
+    roles.insert(RoleTimestamp, "timestamp");
+    roles.insert(RoleDuration, "duration");
+    roles.insert(RoleActivity, "activity");
+    return roles;
+}
+
+void StallEvents::addEvent(const QDateTime &timestamp, qint64 duration, const QString &activity)
+{
+    if (m_events.count() >= maxStallEvents) {
+        beginRemoveRows(QModelIndex(), m_events.count() - 1, m_events.count() - 1);
+        m_events.removeLast();
+        endRemoveRows();
+    }
+    beginInsertRows(QModelIndex(), 0, 0);
+    m_events.prepend({timestamp, duration, activity});
+    endInsertRows();
+    emit countChanged();
+}
+
+void StallEvents::clear()
+{
+    beginResetModel();
+    m_events.clear();
+    endResetModel();
+    emit countChanged();
+}
+
+std::atomic<bool> StallWatchdog::s_active(false);
+
+QObject *StallWatchdog::stallWatchdogProvider(QQmlEngine *engine, QJSEngine *scriptEngine)
+{
+    Q_UNUSED(engine)
+    Q_UNUSED(scriptEngine)
+    return instance();
+}
+
+StallWatchdog *StallWatchdog::instance()
+{
+    static StallWatchdog* thiz = nullptr;
+    if (!thiz) {
+        thiz = new StallWatchdog();
+    }
+    return thiz;
+}
+
+StallWatchdog::StallWatchdog(QObject *parent):
+    QObject(parent),
+    m_pingSent(-1),
+    m_stallReported(false),
+    m_threshold(1000)
+{
+    m_events = new StallEvents(this);
+    m_clock.start();
+
+    QSettings settings;
+    m_threshold.store(settings.value("StallWatchdogThreshold", 1000).toInt());
+    if (enabled()) {
+        start();
+    }
+    QGuiApplication *application = qobject_cast<QGuiApplication*>(QCoreApplication::instance());
+    if (application) {
+        connect(application, &QGuiApplication::applicationStateChanged, this, &StallWatchdog::onApplicationStateChanged);
+    }
+    qAddPostRoutine([](){
+        instance()->stop();
+    });
+}
+
+QString StallWatchdog::pushActivity(const char *kind, const QString &name)
+{
+    StallWatchdog *watchdog = instance();
+    QString activity = QString::fromLatin1(kind) + ' ' + name;
+    QMutexLocker locker(&watchdog->m_activityMutex);
+    QString previous = watchdog->m_activity;
+    watchdog->m_activity = previous.isEmpty() ? activity : previous + " > " + activity;
+    return previous;
+}
+
+void StallWatchdog::restoreActivity(const QString &previous)
+{
+    StallWatchdog *watchdog = instance();
+    QMutexLocker locker(&watchdog->m_activityMutex);
+    watchdog->m_activity = previous;
+}
+
+bool StallWatchdog::enabled() const
+{
+    // Off by default unless the hidden developer options are shown
+    QSettings settings;
+    return settings.value("StallWatchdogEnabled", settings.value("showHiddenOptions", false)).toBool();
+}
+
+void StallWatchdog::setEnabled(bool enabled)
+{
+    if (enabled == this->enabled()) {
+        return;
+    }
+    QSettings settings;
+    settings.setValue("StallWatchdogEnabled", enabled);
+    if (enabled) {
+        if (!m_suspended) {
+            start();
+        }
+    } else {
+        stop();
+    }
+    emit enabledChanged();
+}
+
+int StallWatchdog::threshold() const
+{
+    return m_threshold.load();
+}
+
+void StallWatchdog::setThreshold(int threshold)
+{
+    if (m_threshold.load() == threshold) {
+        return;
+    }
+    m_threshold.store(threshold);
+    QSettings settings;
+    settings.setValue("StallWatchdogThreshold", threshold);
+    emit thresholdChanged();
+}
+
+StallEvents *StallWatchdog::events() const
+{
+    return m_events;
+}
+
+void StallWatchdog::pong()
+{
+    qint64 sent = m_pingSent.load();
+    if (sent < 0) {
+        return;
+    }
+    qint64 duration = m_clock.elapsed() - sent;
+    bool reported = m_stallReported.exchange(false);
+    if (duration >= m_threshold.load()) {
+        QString activity;
+        {
+            QMutexLocker locker(&m_activityMutex);
+            if (reported) {
+                activity = m_stallActivity;
+            }
+            m_stallActivity.clear();
+        }
+        qCWarning(dcStallWatchdog()).nospace() << "Main thread stalled for " << duration << " ms" << (activity.isEmpty() ? "" : " while handling: ") << qUtf8Printable(activity);
+        m_events->addEvent(QDateTime::currentDateTime().addMSecs(-duration), duration, activity);
+        emit stallDetected(duration, activity);
+    }
+    m_pingSent.store(-1);
+}
+
+void StallWatchdog::onApplicationStateChanged(Qt::ApplicationState state)
+{
+    bool suspended = state != Qt::ApplicationActive;
+    if (suspended == m_suspended) {
+        return;
+    }
+    m_suspended = suspended;
+    if (m_suspended) {
+        qCDebug(dcStallWatchdog()) << "Application not active. Pausing.";
+        stop();
+    } else if (enabled()) {
+        // start() begins from a fresh baseline, the time spent in the background doesn't count
+        qCDebug(dcStallWatchdog()) << "Application active again. Resuming.";
+        start();
+    }
+}
+
+void StallWatchdog::start()
+{
+    if (m_thread) {
+        return;
+    }
+    m_pingSent.store(-1);
+    m_stallReported.store(false);
+    m_thread = new StallWatchdogThread(this);
+    m_thread->start(QThread::HighPriority);
+    s_active.store(true, std::memory_order_relaxed);
+}
+
+void StallWatchdog::stop()
+{
+    if (!m_thread) {
+        return;
+    }
+    s_active.store(false, std::memory_order_relaxed);
+    m_thread->stop();
+    delete m_thread;
+    m_thread = nullptr;
+    QMutexLocker locker(&m_activityMutex);
+    m_activity.clear();
+    m_stallActivity.clear();
+}
+
+void StallWatchdog::check()
+{
+    qint64 now = m_clock.elapsed();
+    qint64 sent = m_pingSent.load();
+    if (sent < 0) {
+        m_pingSent.store(now);
+        QMetaObject::invokeMethod(this, "pong", Qt::QueuedConnection);
+        return;
+    }
+    if (now - sent >= m_threshold.load() && !m_stallReported.exchange(true)) {
+        // Still blocked, so this is what the main thread is stuck in
+        QString activity;
+        {
+            QMutexLocker locker(&m_activityMutex);
+            activity = m_activity;
+            m_stallActivity = activity;
+        }
+        qCWarning(dcStallWatchdog()).nospace() << "Main thread blocked for " << now - sent << " ms" << (activity.isEmpty() ? "" : " while handling: ") << qUtf8Printable(activity);
+    }
+}
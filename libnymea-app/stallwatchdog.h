@@ -0,0 +1,169 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef STALLWATCHDOG_H
+#define STALLWATCHDOG_H
+
+#include <QObject>
+#include <QAbstractListModel>
+#include <QElapsedTimer>
+#include <QDateTime>
+#include <QMutex>
+
+#include <atomic>
+
+class QQmlEngine;
+class QJSEngine;
+class StallWatchdogThread;
+
+class StallEvents: public QAbstractListModel
+{
+    Q_OBJECT
+    Q_PROPERTY(int count READ rowCount NOTIFY countChanged)
+
+public:
+    enum Roles {
+        RoleTimestamp,
+        RoleDuration,
+        RoleActivity
+    };
+    Q_ENUM(Roles)
+
+    explicit StallEvents(QObject *parent = nullptr);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role) const override;
+    QHash<int, QByteArray> roleNames() const override;
+
+    void addEvent(const QDateTime &timestamp, qint64 duration, const QString &activity);
+    Q_INVOKABLE void clear();
+
+signals:
+    void countChanged();
+
+private:
+    struct StallEvent {
+        QDateTime timestamp;
+        qint64 duration;
+        QString activity;
+    };
+    // Newest first
+    QList<StallEvent> m_events;
+};
+
+// Pings the main event loop from a separate thread. If a ping isn't answered within the
+// threshold, the main thread is considered stalled and the activity it was busy with at
+// that moment is reported to the log and kept in a short history.
+class StallWatchdog : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(bool enabled READ enabled WRITE setEnabled NOTIFY enabledChanged)
+    Q_PROPERTY(int threshold READ threshold WRITE setThreshold NOTIFY thresholdChanged)
+    Q_PROPERTY(StallEvents* events READ events CONSTANT)
+
+public:
+    static QObject* stallWatchdogProvider(QQmlEngine *engine, QJSEngine *scriptEngine);
+    static StallWatchdog* instance();
+
+    static bool active() { return s_active.load(std::memory_order_relaxed); }
+    // Main thread only. pushActivity() appends to the current activity and returns the
+    // previous one, to be handed back to restoreActivity() when done.
+    static QString pushActivity(const char *kind, const QString &name);
+    static void restoreActivity(const QString &previous);
+
+    bool enabled() const;
+    void setEnabled(bool enabled);
+
+    // ms
+    int threshold() const;
+    void setThreshold(int threshold);
+
+    StallEvents *events() const;
+
+signals:
+    void enabledChanged();
+    void thresholdChanged();
+    void stallDetected(qint64 duration, const QString &activity);
+
+private slots:
+    void pong();
+    void onApplicationStateChanged(Qt::ApplicationState state);
+
+private:
+    friend class StallWatchdogThread;
+    explicit StallWatchdog(QObject *parent = nullptr);
+
+    void start();
+    void stop();
+    // Called from the watchdog thread
+    void check();
+
+    static std::atomic<bool> s_active;
+
+    StallWatchdogThread *m_thread = nullptr;
+    // In the background the event loop doesn't run on purpose, don't ping it then
+    bool m_suspended = false;
+    StallEvents *m_events = nullptr;
+    QElapsedTimer m_clock;
+    std::atomic<qint64> m_pingSent;
+    std::atomic<bool> m_stallReported;
+    std::atomic<int> m_threshold;
+
+    QMutex m_activityMutex;
+    QString m_activity;
+    QString m_stallActivity;
+};
+
+// Marks what the main thread is busy with for the lifetime of a scope. Nested activities
+// are reported as a chain, e.g. "reply Integrations.GetThings > model ThingsProxy".
+class StallActivity
+{
+public:
+    StallActivity(const char *kind, const QString &name):
+        m_set(StallWatchdog::active())
+    {
+        if (m_set) {
+            m_previous = StallWatchdog::pushActivity(kind, name);
+        }
+    }
+    ~StallActivity()
+    {
+        if (m_set) {
+            StallWatchdog::restoreActivity(m_previous);
+        }
+    }
+
+private:
+    Q_DISABLE_COPY(StallActivity)
+    bool m_set;
+    QString m_previous;
+};
+
+#endif // STALLWATCHDOG_H
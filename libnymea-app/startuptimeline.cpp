@@ -0,0 +1,178 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "startuptimeline.h"
+
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+#include "logging.h"
+NYMEA_LOGGING_CATEGORY(dcStartupTimeline, "StartupTimeline")
+
+namespace {
+// Started during static initialization of the library, which is as close to process
+// start as we can get portably.
+struct ProcessClock {
+    ProcessClock() { timer.start(); }
+    QElapsedTimer timer;
+};
+static ProcessClock processClock;
+}
+
+StartupTimeline::StartupTimeline(QObject *parent):
+    QAbstractListModel(parent)
+{
+}
+
+QObject *StartupTimeline::startupTimelineProvider(QQmlEngine *engine, QJSEngine *scriptEngine)
+{
+    Q_UNUSED(engine)
+    Q_UNUSED(scriptEngine)
+    return instance();
+}
+
+StartupTimeline *StartupTimeline::instance()
+{
+    static StartupTimeline* thiz = nullptr;
+    if (!thiz) {
+        thiz = new StartupTimeline();
+    }
+    return thiz;
+}
+
+void StartupTimeline::mark(const QString &name)
+{
+    instance()->addMilestone(name);
+}
+
+void StartupTimeline::finish(const QString &name)
+{
+    StartupTimeline *timeline = instance();
+    if (timeline->m_complete) {
+        return;
+    }
+    timeline->addMilestone(name);
+    timeline->m_complete = true;
+
+    qCInfo(dcStartupTimeline()) << "Startup took" << timeline->totalTime() << "ms";
+    qint64 previous = 0;
+    foreach (const Milestone &milestone, timeline->m_milestones) {
+        qCInfo(dcStartupTimeline()).nospace().noquote() << "  " << QString::number(milestone.elapsed).rightJustified(6) << " ms (+" << (milestone.elapsed - previous) << ") " << milestone.name;
+        previous = milestone.elapsed;
+    }
+
+    emit timeline->completeChanged();
+    emit timeline->finished();
+}
+
+int StartupTimeline::rowCount(const QModelIndex &parent) const
+{
+    Q_UNUSED(parent)
+    return m_milestones.count();
+}
+
+QVariant StartupTimeline::data(const QModelIndex &index, int role) const
+{
+    if (index.row() < 0 || index.row() >= m_milestones.count()) {
+        return QVariant();
+    }
+    const Milestone &milestone = m_milestones.at(index.row());
+    switch (role) {
+    case RoleName:
+        return milestone.name;
+    case RoleElapsed:
+        return milestone.elapsed;
+    case RoleDelta:
+        return index.row() == 0 ? milestone.elapsed : milestone.elapsed - m_milestones.at(index.row() - 1).elapsed;
+    }
+    return QVariant();
+}
+
+QHash<int, QByteArray> StartupTimeline::roleNames() const
+{
+    QHash<int, QByteArray> roles;
+    roles.insert(RoleName, "name");
+    roles.insert(RoleElapsed, "elapsed");
+    roles.insert(RoleDelta, "delta");
+    return roles;
+}
+
+bool StartupTimeline::complete() const
+{
+    return m_complete;
+}
+
+qint64 StartupTimeline::totalTime() const
+{
+    return m_milestones.isEmpty() ? 0 : m_milestones.last().elapsed;
+}
+
+void StartupTimeline::markMilestone(const QString &name)
+{
+    addMilestone(name);
+}
+
+QString StartupTimeline::toJson() const
+{
+    QJsonArray milestones;
+    qint64 previous = 0;
+    foreach (const Milestone &milestone, m_milestones) {
+        QJsonObject entry;
+        entry.insert("name", milestone.name);
+        entry.insert("elapsed", milestone.elapsed);
+        entry.insert("delta", milestone.elapsed - previous);
+        milestones.append(entry);
+        previous = milestone.elapsed;
+    }
+    QJsonObject timeline;
+    timeline.insert("complete", m_complete);
+    timeline.insert("totalTime", totalTime());
+    timeline.insert("milestones", milestones);
+    return QString::fromUtf8(QJsonDocument(timeline).toJson());
+}
+
+void StartupTimeline::addMilestone(const QString &name)
+{
+    if (m_complete) {
+        return;
+    }
+    foreach (const Milestone &milestone, m_milestones) {
+        if (milestone.name == name) {
+            return;
+        }
+    }
+    qint64 elapsed = processClock.timer.elapsed();
+    qCDebug(dcStartupTimeline()) << "Milestone" << name << "at" << elapsed << "ms";
+    beginInsertRows(QModelIndex(), m_milestones.count(), m_milestones.count());
+    m_milestones.append({name, elapsed});
+    endInsertRows();
+    emit countChanged();
+}
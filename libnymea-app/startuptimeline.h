@@ -0,0 +1,94 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef STARTUPTIMELINE_H
+#define STARTUPTIMELINE_H
+
+#include <QAbstractListModel>
+#include <QElapsedTimer>
+
+class QQmlEngine;
+class QJSEngine;
+
+// Named milestones from process start until the first thing list is loaded. Each
+// milestone is recorded once, with its time since process start on a monotonic clock.
+// Once finished, the breakdown is logged and further marks are ignored.
+class StartupTimeline : public QAbstractListModel
+{
+    Q_OBJECT
+    Q_PROPERTY(int count READ rowCount NOTIFY countChanged)
+    Q_PROPERTY(bool complete READ complete NOTIFY completeChanged)
+    Q_PROPERTY(qint64 totalTime READ totalTime NOTIFY countChanged)
+
+public:
+    enum Roles {
+        RoleName,
+        RoleElapsed,
+        RoleDelta
+    };
+    Q_ENUM(Roles)
+
+    static QObject* startupTimelineProvider(QQmlEngine *engine, QJSEngine *scriptEngine);
+    static StartupTimeline* instance();
+
+    // Main thread only
+    static void mark(const QString &name);
+    static void finish(const QString &name);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role) const override;
+    QHash<int, QByteArray> roleNames() const override;
+
+    bool complete() const;
+    // ms since process start of the latest milestone
+    qint64 totalTime() const;
+
+    Q_INVOKABLE void markMilestone(const QString &name);
+    Q_INVOKABLE QString toJson() const;
+
+signals:
+    void countChanged();
+    void completeChanged();
+    void finished();
+
+private:
+    explicit StartupTimeline(QObject *parent = nullptr);
+
+    void addMilestone(const QString &name);
+
+    struct Milestone {
+        QString name;
+        qint64 elapsed;
+    };
+    QList<Milestone> m_milestones;
+    bool m_complete = false;
+};
+
+#endif // STARTUPTIMELINE_H
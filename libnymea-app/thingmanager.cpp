@@ -35,6 +35,8 @@
 #include "thinggroup.h"
 #include "types/interface.h"
 #include "types/ioconnections.h"
+#include "tracerecorder.h"
+#include "startuptimeline.h"
 
 #include <QMetaEnum>
 #include <QFile>
@@ -234,6 +236,8 @@ void ThingManager::getVendorsResponse(int /*commandId*/, const QVariantMap &para
 //    qDebug() << "Got GetSupportedVendors response" << params;
     if (params.keys().contains("vendors")) {
         QVariantList vendorList = params.value("vendors").toList();
+        TraceSpan span("things", "unpackVendors");
+        span.setArgument("count", vendorList.count());
         foreach (QVariant vendorVariant, vendorList) {
             Vendor *vendor = unpackVendor(vendorVariant.toMap());
             m_vendors->addVendor(vendor);
@@ -244,8 +248,11 @@ void ThingManager::getVendorsResponse(int /*commandId*/, const QVariantMap &para
 
 void ThingManager::getThingClassesResponse(int /*commandId*/, const QVariantMap &params)
 {
+    StartupTimeline::mark("Thing classes received");
     if (params.keys().contains("thingClasses")) {
         QVariantList thingClassList = params.value("thingClasses").toList();
+        TraceSpan span("things", "unpackThingClasses");
+        span.setArgument("count", thingClassList.count());
         foreach (QVariant thingClassVariant, thingClassList) {
             ThingClass *thingClass = unpackThingClass(thingClassVariant.toMap());
             m_thingClasses->addThingClass(thingClass);
@@ -259,6 +266,8 @@ void ThingManager::getPluginsResponse(int /*commandId*/, const QVariantMap &para
 //    qDebug() << "received plugins";
     if (params.keys().contains("plugins")) {
         QVariantList pluginList = params.value("plugins").toList();
+        TraceSpan span("things", "unpackPlugins");
+        span.setArgument("count", pluginList.count());
         foreach (QVariant pluginVariant, pluginList) {
             Plugin *plugin = unpackPlugin(pluginVariant.toMap(), plugins());
             m_plugins->addPlugin(plugin);
@@ -300,9 +309,12 @@ void ThingManager::getPluginConfigResponse(int /*commandId*/, const QVariantMap
 void ThingManager::getThingsResponse(int /*commandId*/, const QVariantMap &params)
 {
 //    qCritical() << "Things received:" << qUtf8Printable(QJsonDocument::fromVariant(params).toJson(QJsonDocument::Indented));
+    StartupTimeline::mark("Things received");
     if (params.keys().contains("things")) {
         QVariantList thingsList = params.value("things").toList();
         QList<Thing*> newThings;
+        TraceSpan loadSpan("things", "loadThings");
+        loadSpan.setArgument("count", thingsList.count());
         foreach (QVariant thingVariant, thingsList) {
             Thing *thing = unpackThing(this, thingVariant.toMap(), m_thingClasses);
             if (!thing) {
@@ -332,11 +344,14 @@ void ThingManager::getThingsResponse(int /*commandId*/, const QVariantMap &param
             }
             newThings.append(thing);
         }
+        TraceSpan addSpan("things", "addThings");
         things()->addThings(newThings);
     }
-    qDebug() << "Initializing thing manager took" << m_connectionBenchmark.msecsTo(QDateTime::currentDateTime()) << "ms";
+    qDebug() << "Initializing thing manager took" << m_connectionBenchmark.msecsTo(QDateTime::currentDateTime()) << "ms" << "First states available" << m_jsonClient->msecsSinceConnected() << "ms after the transport connected";
     m_fetchingData = false;
     emit fetchingDataChanged();
+    // Views bound to the things are populated synchronously by now
+    StartupTimeline::finish("Things loaded");
 
     m_jsonClient->sendCommand("Integrations.GetIOConnections", this, "getIOConnectionsResponse");
 
@@ -716,6 +731,7 @@ void ThingManager::executeBrowserItemActionResponse(int commandId, const QVarian
 void ThingManager::getIOConnectionsResponse(int /*commandId*/, const QVariantMap &params)
 {
 //    qDebug() << "Get IO connections response" << qUtf8Printable(QJsonDocument::fromVariant(params).toJson());
+    TraceSpan span("things", "unpackIOConnections");
 
     foreach (const QVariant &connectionVariant, params.value("ioConnections").toList()) {
         QVariantMap connectionMap = connectionVariant.toMap();
@@ -30,12 +30,14 @@
 
 #include "things.h"
 #include "engine.h"
+#include "memorystats.h"
 
 #include <QDebug>
 
 Things::Things(QObject *parent) :
     QAbstractListModel(parent)
 {
+    MemoryStats::registerModel(this, [this](){ return estimatedSize(); });
 }
 
 QList<Thing *> Things::devices()
@@ -169,3 +171,16 @@ QHash<int, QByteArray> Things::roleNames() const
     roles[RoleBaseInterface] = "baseInterface";
     return roles;
 }
+
+qint64 Things::estimatedSize() const
+{
+    qint64 size = m_things.count() * sizeof(Thing*);
+    foreach (Thing *thing, m_things) {
+        if (thing->parent() != this) {
+            continue;
+        }
+        size += MemoryStats::objectSize(sizeof(Thing));
+        size += thing->states()->rowCount() * (sizeof(State*) + MemoryStats::objectSize(sizeof(State)));
+    }
+    return size;
+}
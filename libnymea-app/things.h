@@ -73,6 +73,9 @@ public:
 
     void clearModel();
 
+    // bytes held by the things this model owns, including their states
+    qint64 estimatedSize() const;
+
 protected:
     QHash<int, QByteArray> roleNames() const override;
 
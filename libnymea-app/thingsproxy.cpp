@@ -32,6 +32,8 @@
 #include "engine.h"
 #include "tagsmanager.h"
 #include "types/tag.h"
+#include "tracerecorder.h"
+#include "stallwatchdog.h"
 
 ThingsProxy::ThingsProxy(QObject *parent) :
     QSortFilterProxyModel(parent)
@@ -62,6 +64,7 @@ void ThingsProxy::setEngine(Engine *engine)
             setSourceModel(m_engine->thingManager()->things());
 
             setSortRole(Things::RoleName);
+            TraceSpan span("proxy", "ThingsProxy::sort");
             sort(0, sortOrder());
             connect(sourceModel(), SIGNAL(countChanged()), this, SIGNAL(countChanged()));
             connect(sourceModel(), &QAbstractItemModel::dataChanged, this, [this]() {
@@ -99,6 +102,7 @@ void ThingsProxy::setParentProxy(ThingsProxy *parentProxy)
         });
 
         if (m_engine) {
+            TraceSpan span("proxy", "ThingsProxy::invalidateFilter");
             invalidateFilter();
         }
 
@@ -525,6 +529,8 @@ int ThingsProxy::indexOf(Thing *thing) const
 
 void ThingsProxy::invalidateFilterInternal()
 {
+    TraceSpan span("proxy", "ThingsProxy::invalidateFilter");
+    StallActivity activity("model", QStringLiteral("ThingsProxy filter"));
     int oldCount = rowCount();
     invalidateFilter();
     if (oldCount != rowCount()) {
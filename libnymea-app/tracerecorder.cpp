@@ -0,0 +1,236 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "tracerecorder.h"
+#include "applogcontroller.h"
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSettings>
+#include <QFile>
+#include <QThread>
+
+#include "logging.h"
+NYMEA_LOGGING_CATEGORY(dcTrace, "Trace")
+
+// Enough for several minutes of a busy session. Once full, new events are dropped so the
+// beginning of a recording, which usually is the interesting part, stays intact.
+static const int maxEvents = 250000;
+
+std::atomic<bool> TraceRecorder::s_active(false);
+
+static QElapsedTimer &traceClock()
+{
+    static QElapsedTimer clock;
+    if (!clock.isValid()) {
+        clock.start();
+    }
+    return clock;
+}
+
+QObject *TraceRecorder::traceRecorderProvider(QQmlEngine *engine, QJSEngine *scriptEngine)
+{
+    Q_UNUSED(engine)
+    Q_UNUSED(scriptEngine)
+    return instance();
+}
+
+TraceRecorder *TraceRecorder::instance()
+{
+    static TraceRecorder* thiz = nullptr;
+    if (!thiz) {
+        thiz = new TraceRecorder();
+    }
+    return thiz;
+}
+
+qint64 TraceRecorder::now()
+{
+    return traceClock().nsecsElapsed() / 1000;
+}
+
+TraceRecorder::TraceRecorder(QObject *parent) : QObject(parent)
+{
+    traceClock();
+    QSettings settings;
+    s_active.store(settings.value("TracingEnabled", false).toBool(), std::memory_order_relaxed);
+    if (active()) {
+        qCInfo(dcTrace()) << "Recording a performance trace. It can be exported and disabled in the developer options.";
+    }
+}
+
+bool TraceRecorder::enabled() const
+{
+    return active();
+}
+
+void TraceRecorder::setEnabled(bool enabled)
+{
+    if (enabled == active()) {
+        return;
+    }
+    s_active.store(enabled, std::memory_order_relaxed);
+    QSettings settings;
+    settings.setValue("TracingEnabled", enabled);
+    emit enabledChanged();
+}
+
+int TraceRecorder::eventCount() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_events.count();
+}
+
+void TraceRecorder::addComplete(const char *category, const QString &name, qint64 start, qint64 duration, const char *argName, qint64 argValue)
+{
+    addEvent({'X', category, name, start, duration, 0, 0, argName, argValue});
+}
+
+void TraceRecorder::addAsyncBegin(const char *category, const QString &name, qint64 id)
+{
+    addEvent({'b', category, name, now(), 0, id, 0, nullptr, 0});
+}
+
+void TraceRecorder::addAsyncEnd(const char *category, const QString &name, qint64 id)
+{
+    addEvent({'e', category, name, now(), 0, id, 0, nullptr, 0});
+}
+
+QString TraceRecorder::exportTrace()
+{
+    QVector<TraceEvent> events;
+    QVector<QString> threadNames;
+    int droppedEvents;
+    {
+        QMutexLocker locker(&m_mutex);
+        events = m_events;
+        threadNames = m_threadNames;
+        droppedEvents = m_droppedEvents;
+    }
+
+    QJsonArray traceEvents;
+    const qint64 pid = QCoreApplication::applicationPid();
+    for (int i = 0; i < threadNames.count(); i++) {
+        QJsonObject meta;
+        meta.insert("ph", "M");
+        meta.insert("name", "thread_name");
+        meta.insert("pid", pid);
+        meta.insert("tid", i);
+        meta.insert("args", QJsonObject{{"name", threadNames.at(i)}});
+        traceEvents.append(meta);
+    }
+    foreach (const TraceEvent &event, events) {
+        QJsonObject object;
+        object.insert("ph", QString(QLatin1Char(event.phase)));
+        object.insert("cat", QString::fromLatin1(event.category));
+        object.insert("name", event.name);
+        object.insert("ts", event.timestamp);
+        object.insert("pid", pid);
+        object.insert("tid", event.threadId);
+        if (event.phase == 'X') {
+            object.insert("dur", event.duration);
+        } else {
+            object.insert("id", event.id);
+        }
+        if (event.argName) {
+            object.insert("args", QJsonObject{{QString::fromLatin1(event.argName), event.argValue}});
+        }
+        traceEvents.append(object);
+    }
+
+    QJsonObject trace;
+    trace.insert("traceEvents", traceEvents);
+    trace.insert("displayTimeUnit", "ms");
+    trace.insert("otherData", QJsonObject{
+                     {"application", QCoreApplication::applicationName()},
+                     {"version", QCoreApplication::applicationVersion()},
+                     {"droppedEvents", droppedEvents}
+                 });
+
+    QString fileName = AppLogController::instance()->logPath() + "/" + QCoreApplication::applicationName() + "-trace.json";
+    QFile f(fileName);
+    if (!f.open(QFile::WriteOnly | QFile::Truncate)) {
+        qCWarning(dcTrace()) << "Unable to open trace file" << fileName << f.errorString();
+        return QString();
+    }
+    f.write(QJsonDocument(trace).toJson(QJsonDocument::Compact));
+    f.close();
+    qCInfo(dcTrace()) << "Exported" << events.count() << "trace events to" << fileName << "Dropped:" << droppedEvents;
+    return fileName;
+}
+
+void TraceRecorder::clear()
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        m_events.clear();
+        m_droppedEvents = 0;
+    }
+    emit eventCountChanged();
+}
+
+void TraceRecorder::addEvent(TraceEvent event)
+{
+    QMutexLocker locker(&m_mutex);
+    if (m_events.count() >= maxEvents) {
+        m_droppedEvents++;
+        return;
+    }
+
+    quintptr thread = reinterpret_cast<quintptr>(QThread::currentThreadId());
+    int threadId = m_threadIds.value(thread, -1);
+    if (threadId < 0) {
+        threadId = m_threadNames.count();
+        m_threadIds.insert(thread, threadId);
+        QThread *current = QThread::currentThread();
+        QString threadName = current->objectName();
+        if (threadName.isEmpty()) {
+            threadName = qApp && current == qApp->thread() ? QStringLiteral("main") : QString("thread %1").arg(threadId);
+        }
+        m_threadNames.append(threadName);
+    }
+    event.threadId = threadId;
+    m_events.append(event);
+
+    // Bound the property notifications to one per event loop pass
+    if (!m_countUpdatePending) {
+        m_countUpdatePending = true;
+        QMetaObject::invokeMethod(this, [this](){
+            {
+                QMutexLocker locker(&m_mutex);
+                m_countUpdatePending = false;
+            }
+            emit eventCountChanged();
+        }, Qt::QueuedConnection);
+    }
+}
@@ -0,0 +1,138 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef TRACERECORDER_H
+#define TRACERECORDER_H
+
+#include <QObject>
+#include <QMutex>
+#include <QHash>
+#include <QVector>
+
+#include <atomic>
+
+class QQmlEngine;
+class QJSEngine;
+
+// Collects timing spans and writes them in the Chrome trace event format, to be opened in
+// chrome://tracing, ui.perfetto.dev or speedscope. While recording is off, instrumented code
+// pays for a single relaxed atomic load.
+class TraceRecorder : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(bool enabled READ enabled WRITE setEnabled NOTIFY enabledChanged)
+    Q_PROPERTY(int eventCount READ eventCount NOTIFY eventCountChanged)
+
+public:
+    static QObject* traceRecorderProvider(QQmlEngine *engine, QJSEngine *scriptEngine);
+    static TraceRecorder* instance();
+
+    static bool active() { return s_active.load(std::memory_order_relaxed); }
+    // Microseconds on a monotonic clock
+    static qint64 now();
+
+    bool enabled() const;
+    void setEnabled(bool enabled);
+
+    int eventCount() const;
+
+    void addComplete(const char *category, const QString &name, qint64 start, qint64 duration, const char *argName = nullptr, qint64 argValue = 0);
+    void addAsyncBegin(const char *category, const QString &name, qint64 id);
+    void addAsyncEnd(const char *category, const QString &name, qint64 id);
+
+    // Writes the recorded events to a file and returns its path, or an empty string on failure
+    Q_INVOKABLE QString exportTrace();
+    Q_INVOKABLE void clear();
+
+signals:
+    void enabledChanged();
+    void eventCountChanged();
+
+private:
+    explicit TraceRecorder(QObject *parent = nullptr);
+
+    struct TraceEvent {
+        char phase;
+        const char *category;
+        QString name;
+        qint64 timestamp;
+        qint64 duration;
+        qint64 id;
+        int threadId;
+        const char *argName;
+        qint64 argValue;
+    };
+    void addEvent(TraceEvent event);
+
+    static std::atomic<bool> s_active;
+
+    mutable QMutex m_mutex;
+    QVector<TraceEvent> m_events;
+    QHash<quintptr, int> m_threadIds;
+    QVector<QString> m_threadNames;
+    int m_droppedEvents = 0;
+    bool m_countUpdatePending = false;
+};
+
+// Records the lifetime of a scope as a complete event:
+//     TraceSpan span("things", "unpackThings");
+class TraceSpan
+{
+public:
+    TraceSpan(const char *category, const char *name):
+        m_category(category),
+        m_name(name),
+        m_start(TraceRecorder::active() ? TraceRecorder::now() : -1)
+    {
+    }
+    ~TraceSpan()
+    {
+        if (m_start >= 0) {
+            TraceRecorder::instance()->addComplete(m_category, QString::fromLatin1(m_name), m_start, TraceRecorder::now() - m_start, m_argName, m_argValue);
+        }
+    }
+
+    // Attaches a value (e.g. an item count) that shows up with the span in the viewer
+    void setArgument(const char *name, qint64 value)
+    {
+        m_argName = name;
+        m_argValue = value;
+    }
+
+private:
+    Q_DISABLE_COPY(TraceSpan)
+    const char *m_category;
+    const char *m_name;
+    qint64 m_start;
+    const char *m_argName = nullptr;
+    qint64 m_argValue = 0;
+};
+
+#endif // TRACERECORDER_H
@@ -35,8 +35,9 @@
 #include <QUuid>
 
 #include "paramtypes.h"
+#include "instancecounter.h"
 
-class ActionType : public QObject
+class ActionType : public QObject, private InstanceCounter<InstanceCounters::TypeActionType>
 {
     Q_OBJECT
     Q_PROPERTY(QUuid id READ id CONSTANT)
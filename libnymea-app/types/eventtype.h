@@ -35,8 +35,9 @@
 #include <QUuid>
 
 #include "paramtypes.h"
+#include "instancecounter.h"
 
-class EventType : public QObject
+class EventType : public QObject, private InstanceCounter<InstanceCounters::TypeEventType>
 {
     Q_OBJECT
     Q_PROPERTY(QUuid id READ id CONSTANT)
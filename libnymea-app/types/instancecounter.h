@@ -0,0 +1,73 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef INSTANCECOUNTER_H
+#define INSTANCECOUNTER_H
+
+#include <atomic>
+
+// Live instance counts of the objects that make up most of the app's memory. Classes
+// opt in by inheriting InstanceCounter<Type> privately next to QObject.
+class InstanceCounters
+{
+public:
+    enum Type {
+        TypeThing,
+        TypeState,
+        TypeLogEntry,
+        TypeEnergyLogEntry,
+        TypeRule,
+        TypeTag,
+        TypeThingClass,
+        TypeStateType,
+        TypeEventType,
+        TypeActionType,
+        TypeParamType,
+        TypeCount
+    };
+
+    static int count(Type type) { return s_counts[type].load(std::memory_order_relaxed); }
+    static const char *typeName(Type type);
+
+private:
+    template <Type T> friend class InstanceCounter;
+    static std::atomic<int> s_counts[TypeCount];
+};
+
+template <InstanceCounters::Type T>
+class InstanceCounter
+{
+protected:
+    InstanceCounter() { InstanceCounters::s_counts[T].fetch_add(1, std::memory_order_relaxed); }
+    InstanceCounter(const InstanceCounter &) { InstanceCounters::s_counts[T].fetch_add(1, std::memory_order_relaxed); }
+    ~InstanceCounter() { InstanceCounters::s_counts[T].fetch_sub(1, std::memory_order_relaxed); }
+};
+
+#endif // INSTANCECOUNTER_H
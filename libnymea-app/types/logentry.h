@@ -36,7 +36,9 @@
 #include <QDateTime>
 #include <QUuid>
 
-class LogEntry : public QObject
+#include "instancecounter.h"
+
+class LogEntry : public QObject, private InstanceCounter<InstanceCounters::TypeLogEntry>
 {
     Q_OBJECT
     Q_PROPERTY(QVariant value READ value CONSTANT)
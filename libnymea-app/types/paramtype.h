@@ -37,8 +37,9 @@
 #include <QUuid>
 
 #include "types.h"
+#include "instancecounter.h"
 
-class ParamType : public QObject
+class ParamType : public QObject, private InstanceCounter<InstanceCounters::TypeParamType>
 {
     Q_OBJECT
     Q_PROPERTY(QUuid id READ id CONSTANT)
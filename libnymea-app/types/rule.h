@@ -34,12 +34,14 @@
 #include <QObject>
 #include <QUuid>
 
+#include "instancecounter.h"
+
 class EventDescriptors;
 class RuleActions;
 class StateEvaluator;
 class TimeDescriptor;
 
-class Rule : public QObject
+class Rule : public QObject, private InstanceCounter<InstanceCounters::TypeRule>
 {
     Q_OBJECT
     Q_PROPERTY(QUuid id READ id CONSTANT)
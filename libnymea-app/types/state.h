@@ -35,7 +35,9 @@
 #include <QObject>
 #include <QVariant>
 
-class State : public QObject
+#include "instancecounter.h"
+
+class State : public QObject, private InstanceCounter<InstanceCounters::TypeState>
 {
     Q_OBJECT
     Q_PROPERTY(QUuid thingId READ thingId CONSTANT)
@@ -36,8 +36,9 @@
 #include <QUuid>
 
 #include "types.h"
+#include "instancecounter.h"
 
-class StateType : public QObject
+class StateType : public QObject, private InstanceCounter<InstanceCounters::TypeStateType>
 {
     Q_OBJECT
     Q_PROPERTY(QUuid id READ id CONSTANT)
@@ -35,9 +35,11 @@
 #include <QUuid>
 #include <QLoggingCategory>
 
+#include "instancecounter.h"
+
 Q_DECLARE_LOGGING_CATEGORY(dcTags)
 
-class Tag : public QObject
+class Tag : public QObject, private InstanceCounter<InstanceCounters::TypeTag>
 {
     Q_OBJECT
     Q_PROPERTY(QUuid thingId READ thingId CONSTANT)
@@ -37,11 +37,12 @@
 #include "params.h"
 #include "states.h"
 #include "statesproxy.h"
+#include "instancecounter.h"
 
 class ThingClass;
 class ThingManager;
 
-class Thing : public QObject
+class Thing : public QObject, private InstanceCounter<InstanceCounters::TypeThing>
 {
     Q_OBJECT
     Q_PROPERTY(QUuid id READ id CONSTANT)
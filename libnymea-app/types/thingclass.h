@@ -40,8 +40,9 @@
 #include "statetypes.h"
 #include "eventtypes.h"
 #include "actiontypes.h"
+#include "instancecounter.h"
 
-class ThingClass : public QObject
+class ThingClass : public QObject, private InstanceCounter<InstanceCounters::TypeThingClass>
 {
     Q_OBJECT
 
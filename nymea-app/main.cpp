@@ -36,6 +36,8 @@
 #include <QSysInfo>
 #include <QCommandLineParser>
 #include <QCommandLineOption>
+#include <QFile>
+#include <QTimer>
 
 
 #include "libnymea-app-core.h"
@@ -78,6 +80,15 @@ int main(int argc, char *argv[])
                                      "qt.qml.connections.warning=false\n"
                                      );
     QCoreApplication::setAttribute(Qt::AA_EnableHighDpiScaling);
+
+    // Measuring the startup timeline doesn't need a screen. This has to be decided before
+    // the application is created, so look for the option before the parser runs.
+    for (int i = 1; i < argc; i++) {
+        if (qstrcmp(argv[i], "--startup-timeline") == 0 && !qEnvironmentVariableIsSet("QT_QPA_PLATFORM")) {
+            qputenv("QT_QPA_PLATFORM", "offscreen");
+        }
+    }
+
     QApplication application(argc, argv);
 
     application.setApplicationName(APPLICATION_NAME);
@@ -97,10 +108,22 @@ int main(int argc, char *argv[])
     parser.addOption(kioskOption);
     QCommandLineOption splashOption = QCommandLineOption({"p", "splash"}, "Show a splash screen on startup.");
     parser.addOption(splashOption);
+    QCommandLineOption startupTimelineOption = QCommandLineOption("startup-timeline", "Run without a window, connect to the host given with --connect, write the startup timeline as JSON to the given file (- for stdout) and exit.", "file");
+    parser.addOption(startupTimelineOption);
+    QCommandLineOption startupTimeoutOption = QCommandLineOption("startup-timeout", "Give up measuring the startup timeline after this many ms.", "ms", "60000");
+    parser.addOption(startupTimeoutOption);
     parser.process(application);
 
+    StartupTimeline::mark("Application created");
+
     // Initialize app log controller as early as possible, but after setting app name etc
     AppLogController::instance();
+    // Watch the main thread from the start, startup is where most of the heavy lifting happens
+    StallWatchdog::instance();
+    // Picks up a trace recording left enabled in the developer options
+    TraceRecorder::instance();
+    // Starts sampling live object counts into the log
+    MemoryStats::instance();
 
     qCDebug(dcApplication()) << "*** nymea:app starting ***" << QDateTime::currentDateTime().toString();
 
@@ -130,8 +153,10 @@ int main(int argc, char *argv[])
     }
     application.installTranslator(&overlayTranslator);
 #endif
+    StartupTimeline::mark("Translations loaded");
 
     registerQmlTypes();
+    StartupTimeline::mark("QML types registered");
 
     QQmlApplicationEngine *engine = new QQmlApplicationEngine();
 
@@ -159,6 +184,7 @@ int main(int argc, char *argv[])
         qCDebug(dcApplication()) << "Adding style font:" << fi.absoluteFilePath();
         QFontDatabase::addApplicationFont(fi.absoluteFilePath());
     }
+    StartupTimeline::mark("Fonts loaded");
 
     qmlRegisterSingletonType(QUrl("qrc:///styles/" + styleController.currentStyle() + "/Style.qml"), "Nymea", 1, 0, "Style" );
     qmlRegisterSingletonType(QUrl("qrc:///ui/Configuration.qml"), "Nymea", 1, 0, "Configuration");
@@ -205,7 +231,39 @@ int main(int argc, char *argv[])
 
     application.setWindowIcon(QIcon(QString(":/styles/%1/logo.svg").arg(styleController.currentStyle())));
 
+    if (parser.isSet(startupTimelineOption)) {
+        if (!parser.isSet(connectOption)) {
+            qCWarning(dcApplication()) << "--startup-timeline without --connect relies on the last used host being reachable";
+        }
+        QString timelineFile = parser.value(startupTimelineOption);
+        auto writeTimeline = [timelineFile]() {
+            QByteArray json = StartupTimeline::instance()->toJson().toUtf8();
+            QFile file;
+            bool opened;
+            if (timelineFile == "-") {
+                opened = file.open(stdout, QFile::WriteOnly);
+            } else {
+                file.setFileName(timelineFile);
+                opened = file.open(QFile::WriteOnly | QFile::Truncate);
+            }
+            if (!opened || file.write(json) != json.length()) {
+                qCWarning(dcApplication()) << "Cannot write startup timeline to" << timelineFile << file.errorString();
+                return false;
+            }
+            return true;
+        };
+        QObject::connect(StartupTimeline::instance(), &StartupTimeline::finished, &application, [&application, writeTimeline](){
+            application.exit(writeTimeline() ? 0 : 1);
+        });
+        QTimer::singleShot(parser.value(startupTimeoutOption).toInt(), &application, [&application, writeTimeline](){
+            qCWarning(dcApplication()) << "Startup did not complete in time";
+            writeTimeline();
+            application.exit(1);
+        });
+    }
+
     engine->load(QUrl(QLatin1String("qrc:/ui/Nymea.qml")));
+    StartupTimeline::mark("Main window loaded");
 
     return application.exec();
 }
@@ -62,6 +62,56 @@ SettingsPageBase {
         onClicked: pageStack.push(Qt.resolvedUrl("../appsettings/LoggingCategories.qml"))
     }
 
+    SwitchDelegate {
+        text: qsTr("Record performance trace")
+        checked: TraceRecorder.enabled
+        onCheckedChanged: TraceRecorder.enabled = checked
+        Layout.fillWidth: true
+    }
+
+    NymeaItemDelegate {
+        Layout.fillWidth: true
+        text: qsTr("Export performance trace")
+        subText: qsTr("%n event(s) recorded", "", TraceRecorder.eventCount)
+        visible: TraceRecorder.enabled || TraceRecorder.eventCount > 0
+        progressive: false
+        onClicked: {
+            var exportedFile = TraceRecorder.exportTrace()
+            if (exportedFile.length > 0) {
+                PlatformHelper.shareFile(exportedFile)
+            }
+        }
+    }
+
+    SettingsPageSectionHeader {
+        text: qsTr("Responsiveness")
+    }
+
+    SwitchDelegate {
+        text: qsTr("Detect user interface stalls")
+        checked: StallWatchdog.enabled
+        onCheckedChanged: StallWatchdog.enabled = checked
+        Layout.fillWidth: true
+    }
+
+    NymeaItemDelegate {
+        Layout.fillWidth: true
+        text: qsTr("Recorded stalls")
+        subText: qsTr("%n stall(s) longer than %1 ms", "", StallWatchdog.events.count).arg(StallWatchdog.threshold)
+        onClicked: pageStack.push(Qt.resolvedUrl("../appsettings/StallEventsPage.qml"))
+    }
+
+    SettingsPageSectionHeader {
+        text: qsTr("Memory")
+    }
+
+    NymeaItemDelegate {
+        Layout.fillWidth: true
+        text: qsTr("Memory usage")
+        subText: qsTr("Live objects and model sizes")
+        onClicked: pageStack.push(Qt.resolvedUrl("../appsettings/MemoryStatsPage.qml"))
+    }
+
     SettingsPageSectionHeader {
         text: qsTr("Advanced options")
         visible: settings.showHiddenOptions
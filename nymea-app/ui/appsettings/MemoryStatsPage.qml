@@ -0,0 +1,109 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+import QtQuick 2.9
+import QtQuick.Controls 2.2
+import QtQuick.Layouts 1.3
+import Nymea 1.0
+import "../components"
+
+SettingsPageBase {
+    id: root
+    title: qsTr("Memory usage")
+
+    header: NymeaHeader {
+        text: root.title
+        backButtonVisible: true
+        onBackPressed: pageStack.pop()
+
+        HeaderButton {
+            imageSource: "../images/save.svg"
+            text: qsTr("Write to application log")
+            onClicked: {
+                MemoryStats.logSample()
+                ToolTip.show(qsTr("Memory usage written to the application log"), 500)
+            }
+        }
+    }
+
+    Timer {
+        running: root.visible
+        interval: 2000
+        repeat: true
+        triggeredOnStart: true
+        onTriggered: MemoryStats.update()
+    }
+
+    NymeaItemDelegate {
+        Layout.fillWidth: true
+        progressive: false
+        text: qsTr("Resident memory")
+        subText: MemoryStats.residentSize > 0 ? qsTr("%1 MB").arg((MemoryStats.residentSize / 1024 / 1024).toFixed(1)) : qsTr("Not available on this platform")
+    }
+
+    NymeaItemDelegate {
+        Layout.fillWidth: true
+        progressive: false
+        text: qsTr("Counted objects")
+        subText: qsTr("approx. %1 kB").arg((MemoryStats.totalBytes / 1024).toFixed(0))
+    }
+
+    SettingsPageSectionHeader {
+        text: qsTr("Live objects")
+    }
+
+    Repeater {
+        model: MemoryStats
+        delegate: NymeaSwipeDelegate {
+            Layout.fillWidth: true
+            visible: model.kind === MemoryStats.KindInstances
+            progressive: false
+            prominentSubText: false
+            text: model.name
+            subText: qsTr("%1 instances, approx. %2 kB").arg(model.count).arg((model.bytes / 1024).toFixed(1))
+        }
+    }
+
+    SettingsPageSectionHeader {
+        text: qsTr("Models")
+    }
+
+    Repeater {
+        model: MemoryStats
+        delegate: NymeaSwipeDelegate {
+            Layout.fillWidth: true
+            visible: model.kind === MemoryStats.KindModel
+            progressive: false
+            prominentSubText: false
+            text: model.name
+            subText: qsTr("%1 open, approx. %2 kB").arg(model.count).arg((model.bytes / 1024).toFixed(1))
+        }
+    }
+}
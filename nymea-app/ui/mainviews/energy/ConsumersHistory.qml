@@ -29,22 +29,26 @@ Item {
         loadingInhibited: thingIds.length === 0
 
         onEntriesAdded: {
-            var thingValues = ({})
-            var timestamp = entries[0].timestamp
-            for (var i = 0; i < entries.length; i++) {
-                var entry = entries[i]
-                var thing = engine.thingManager.things.getThing(entries[i].thingId)
-                thingValues[entry.thingId] = entry.currentPower
-            }
+            // Entries are sorted by timestamp, add one point per timestamp
+            var start = 0
+            while (start < entries.length) {
+                var thingValues = ({})
+                var timestamp = entries[start].timestamp
+                var end = start
+                while (end < entries.length && entries[end].timestamp.getTime() === timestamp.getTime()) {
+                    thingValues[entries[end].thingId] = entries[end].currentPower
+                    end++
+                }
 
-            // Add them in the order of the chart (same as proxy), summing it up
-            var totalValue = 0;
-            for (var i = 0; i < consumers.count; i++) {
-                var consumer = consumers.get(i);
-                var value = thingValues.hasOwnProperty(consumer.id) ? thingValues[consumer.id] : 0
-                totalValue += thingValues.hasOwnProperty(consumer.id) ? thingValues[consumer.id] : 0;
-                var series = d.thingsSeriesMap[consumer.id];
-                series.upperSeries.append(timestamp, totalValue)
+                // Add them in the order of the chart (same as proxy), summing it up
+                var totalValue = 0;
+                for (var i = 0; i < consumers.count; i++) {
+                    var consumer = consumers.get(i);
+                    totalValue += thingValues.hasOwnProperty(consumer.id) ? thingValues[consumer.id] : 0;
+                    var series = d.thingsSeriesMap[consumer.id];
+                    series.upperSeries.append(timestamp, totalValue)
+                }
+                start = end
             }
         }
     }
@@ -54,12 +58,15 @@ Item {
         startTime: dateTimeAxis.min
         sampleRate: EnergyLogs.SampleRate15Mins
 
-        onEntryAdded: {
-            consumptionSeries.addEntry(entry)
+        onEntriesAdded: {
+            for (var i = 0; i < entries.length; i++) {
+                var entry = entries[i]
+                consumptionSeries.addEntry(entry)
 
-            if (dateTimeAxis.now < entry.timestamp) {
-                dateTimeAxis.now = entry.timestamp
-                zeroSeries.update(entry.timestamp)
+                if (dateTimeAxis.now < entry.timestamp) {
+                    dateTimeAxis.now = entry.timestamp
+                    zeroSeries.update(entry.timestamp)
+                }
             }
         }
     }
@@ -28,15 +28,18 @@ Item {
 
     Connections {
         target: powerBalanceLogs
-        onEntryAdded: {
-            consumptionSeries.addEntry(entry)
-            selfProductionSeries.addEntry(entry)
-            storageSeries.addEntry(entry)
-            acquisitionSeries.addEntry(entry)
-
-            if (dateTimeAxis.now < entry.timestamp) {
-                dateTimeAxis.now = entry.timestamp
-                zeroSeries.update(entry.timestamp)
+        onEntriesAdded: {
+            for (var i = 0; i < entries.length; i++) {
+                var entry = entries[i]
+                consumptionSeries.addEntry(entry)
+                selfProductionSeries.addEntry(entry)
+                storageSeries.addEntry(entry)
+                acquisitionSeries.addEntry(entry)
+
+                if (dateTimeAxis.now < entry.timestamp) {
+                    dateTimeAxis.now = entry.timestamp
+                    zeroSeries.update(entry.timestamp)
+                }
             }
         }
     }
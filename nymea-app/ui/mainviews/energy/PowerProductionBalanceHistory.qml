@@ -26,15 +26,18 @@ Item {
 
     Connections {
         target: powerBalanceLogs
-        onEntryAdded: {
-            productionSeries.addEntry(entry)
-            selfConsumptionSeries.addEntry(entry)
-            storageSeries.addEntry(entry)
-            acquisitionSeries.addEntry(entry)
-
-            if (dateTimeAxis.now < entry.timestamp) {
-                dateTimeAxis.now = entry.timestamp
-                zeroSeries.update(entry.timestamp)
+        onEntriesAdded: {
+            for (var i = 0; i < entries.length; i++) {
+                var entry = entries[i]
+                productionSeries.addEntry(entry)
+                selfConsumptionSeries.addEntry(entry)
+                storageSeries.addEntry(entry)
+                acquisitionSeries.addEntry(entry)
+
+                if (dateTimeAxis.now < entry.timestamp) {
+                    dateTimeAxis.now = entry.timestamp
+                    zeroSeries.update(entry.timestamp)
+                }
             }
         }
     }
@@ -52,6 +52,25 @@ SettingsPageBase {
             progressive: false
             prominentSubText: false
         }
+        NymeaSwipeDelegate {
+            Layout.fillWidth: true
+            text: qsTr("Round trip time:")
+            subText: {
+                var times = engine.jsonRpcClient.roundTripTimes
+                if (times.length === 0) {
+                    return qsTr("Unknown")
+                }
+                var min = times[0], max = times[0], sum = 0
+                for (var i = 0; i < times.length; i++) {
+                    min = Math.min(min, times[i])
+                    max = Math.max(max, times[i])
+                    sum += times[i]
+                }
+                return qsTr("%1 ms (min %2 ms, avg %3 ms, max %4 ms)").arg(engine.jsonRpcClient.roundTripTime).arg(min).arg(Math.round(sum / times.length)).arg(max)
+            }
+            progressive: false
+            prominentSubText: false
+        }
         NymeaSwipeDelegate {
             Layout.fillWidth: true
             text: qsTr("Server UUID:")
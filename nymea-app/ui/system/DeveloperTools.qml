@@ -115,4 +115,15 @@ SettingsPageBase {
         }
         onLinkActivated: Qt.openUrlExternally(link)
     }
+
+    SettingsPageSectionHeader {
+        text: qsTr("Diagnostics")
+    }
+
+    NymeaItemDelegate {
+        Layout.fillWidth: true
+        text: qsTr("Connection statistics")
+        subText: qsTr("Latency and payload size per request")
+        onClicked: pageStack.push(Qt.resolvedUrl("JsonRpcStatisticsPage.qml"))
+    }
 }
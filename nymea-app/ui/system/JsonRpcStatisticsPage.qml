@@ -0,0 +1,97 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+*
+* Copyright 2013 - 2020, nymea GmbH
+* Contact: contact@nymea.io
+*
+* This file is part of nymea.
+* This project including source code and documentation is protected by
+* copyright law, and remains the property of nymea GmbH. All rights, including
+* reproduction, publication, editing and translation, are reserved. The use of
+* this project is subject to the terms of a license agreement to be concluded
+* with nymea GmbH in accordance with the terms of use of nymea GmbH, available
+* under https://nymea.io/license
+*
+* GNU General Public License Usage
+* Alternatively, this project may be redistributed and/or modified under the
+* terms of the GNU General Public License as published by the Free Software
+* Foundation, GNU version 3. This project is distributed in the hope that it
+* will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+* of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with
+* this project. If not, see <https://www.gnu.org/licenses/>.
+*
+* For any further details and any questions please contact us under
+* contact@nymea.io or see our FAQ/Licensing Information on
+* https://nymea.io/license/faq
+*
+* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+import QtQuick 2.9
+import QtQuick.Controls 2.2
+import QtQuick.Layouts 1.3
+import Nymea 1.0
+import "../components"
+
+SettingsPageBase {
+    id: root
+    title: qsTr("Connection statistics")
+
+    readonly property JsonRpcStatistics statistics: engine.jsonRpcClient.statistics
+
+    header: NymeaHeader {
+        text: root.title
+        backButtonVisible: true
+        onBackPressed: pageStack.pop()
+
+        HeaderButton {
+            imageSource: "../images/save.svg"
+            text: qsTr("Write to application log")
+            onClicked: {
+                root.statistics.dumpToLog()
+                ToolTip.show(qsTr("Statistics written to the application log"), 500)
+            }
+        }
+        HeaderButton {
+            imageSource: "../images/edit-clear.svg"
+            text: qsTr("Reset")
+            onClicked: root.statistics.reset()
+        }
+    }
+
+    SettingsPageSectionHeader {
+        text: qsTr("Requests")
+    }
+
+    Repeater {
+        model: root.statistics
+        delegate: NymeaSwipeDelegate {
+            Layout.fillWidth: true
+            visible: model.type === JsonRpcStatistics.EntryTypeMethod
+            progressive: false
+            prominentSubText: false
+            text: model.name
+            subText: qsTr("%1 calls, %2 errors, p50 %3 ms, p95 %4 ms, p99 %5 ms, first byte p50 %6 ms, max response %7 kB")
+                .arg(model.count).arg(model.errors).arg(model.p50).arg(model.p95).arg(model.p99).arg(model.firstByteP50)
+                .arg((model.maxResponseBytes / 1024).toFixed(1))
+        }
+    }
+
+    SettingsPageSectionHeader {
+        text: qsTr("Notifications")
+    }
+
+    Repeater {
+        model: root.statistics
+        delegate: NymeaSwipeDelegate {
+            Layout.fillWidth: true
+            visible: model.type === JsonRpcStatistics.EntryTypeNotification
+            progressive: false
+            prominentSubText: false
+            text: model.name
+            subText: qsTr("%1 total, %2 per minute, %3 kB received")
+                .arg(model.count).arg(model.ratePerMinute).arg((model.responseBytes / 1024).toFixed(1))
+        }
+    }
+}
@@ -0,0 +1,16 @@
+TARGET = testbenchmarks
+
+include(../../shared.pri)
+include(../mockcore/mockcore.pri)
+INCLUDEPATH += $$top_srcdir/libnymea-app
+LIBS += -L$$top_builddir/libnymea-app/ -lnymea-app -lssl -lcrypto
+
+QT += testlib network gui bluetooth websockets charts quick
+CONFIG += testcase
+
+SOURCES += testbenchmarks.cpp
+
+# "make benchmark" runs the suite and keeps the results in a machine readable form next to the text log
+benchmark.commands = ./$$TARGET -o $$OUT_PWD/benchmarks.xml,xml -o -,txt
+benchmark.depends = $$TARGET
+QMAKE_EXTRA_TARGETS += benchmark
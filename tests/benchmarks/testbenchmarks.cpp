@@ -0,0 +1,381 @@
+#include <QtTest/QTest>
+#include <QJsonDocument>
+#include <QLoggingCategory>
+#include <QLineSeries>
+#include <QtMath>
+#include <QElapsedTimer>
+
+#include <algorithm>
+
+#include "engine.h"
+#include "thingmanager.h"
+#include "things.h"
+#include "thingsproxy.h"
+#include "tagsmanager.h"
+#include "jsonrpc/jsonrpcclient.h"
+#include "connection/nymeahost.h"
+#include "models/logsmodel.h"
+#include "models/logsmodelng.h"
+#include "models/xyseriesadapter.h"
+#include "types/logentry.h"
+#include "types/statetypes.h"
+#include "types/statetype.h"
+
+#include "mockcore.h"
+#include "mockinstallation.h"
+
+// Benchmarks for the paths that scale with the size of an installation. Fixtures come from
+// the mock core, so numbers are comparable between runs. "make benchmark" writes them to
+// benchmarks.xml as well.
+class TestBenchmarks: public QObject
+{
+    Q_OBJECT
+public:
+    TestBenchmarks(QObject* parent = nullptr);
+
+    Q_INVOKABLE void notificationReceived(const QVariantMap &data);
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void jsonRpcFraming_data();
+    void jsonRpcFraming();
+
+    void unpackThingClasses_data();
+    void unpackThingClasses();
+
+    void getThingsResponse_data();
+    void getThingsResponse();
+
+    void thingsProxy_data();
+    void thingsProxy();
+
+    void getThing();
+
+    void logsReply_data();
+    void logsReply();
+
+    void xySeriesAdapter_data();
+    void xySeriesAdapter();
+
+private:
+    void loadInstallation(ThingManager *thingManager, MockInstallation *installation, bool withThings = true);
+    Thing *findThingWithState(const QString &stateName) const;
+
+    MockInstallation *m_installation = nullptr;
+    Engine *m_engine = nullptr;
+    // Never connected. Calls sent through it go nowhere, which is all the fetch chain needs here.
+    JsonRpcClient *m_offlineClient = nullptr;
+    int m_notificationCount = 0;
+};
+
+TestBenchmarks::TestBenchmarks(QObject *parent): QObject(parent)
+{
+}
+
+void TestBenchmarks::notificationReceived(const QVariantMap &data)
+{
+    Q_UNUSED(data)
+    m_notificationCount++;
+}
+
+void TestBenchmarks::initTestCase()
+{
+    // Requests on the offline client and debug prints in the models would drown the results
+    QLoggingCategory::setFilterRules("NymeaConnection.warning=false\ndefault.debug=false");
+
+    MockInstallation::Options options;
+    options.thingClasses = 50;
+    options.things = 2000;
+    options.tags = 3000;
+    options.logEntries = 0;
+    m_installation = new MockInstallation(options);
+
+    m_offlineClient = new JsonRpcClient(this);
+    m_engine = new Engine(this);
+    loadInstallation(m_engine->thingManager(), m_installation);
+    QMetaObject::invokeMethod(m_engine->tagsManager(), "getTagsResponse", Qt::DirectConnection, Q_ARG(int, 0), Q_ARG(QVariantMap, QVariantMap{{"tags", m_installation->tags()}}));
+
+    QCOMPARE(m_engine->thingManager()->things()->rowCount(), options.things);
+}
+
+void TestBenchmarks::cleanupTestCase()
+{
+    delete m_installation;
+    m_installation = nullptr;
+}
+
+void TestBenchmarks::loadInstallation(ThingManager *thingManager, MockInstallation *installation, bool withThings)
+{
+    // Same entry points JsonRpcClient calls with the replies from the core
+    QMetaObject::invokeMethod(thingManager, "getThingClassesResponse", Qt::DirectConnection, Q_ARG(int, 0), Q_ARG(QVariantMap, QVariantMap{{"thingClasses", installation->thingClasses()}}));
+    if (withThings) {
+        QMetaObject::invokeMethod(thingManager, "getThingsResponse", Qt::DirectConnection, Q_ARG(int, 0), Q_ARG(QVariantMap, QVariantMap{{"things", installation->things()}}));
+    }
+}
+
+Thing *TestBenchmarks::findThingWithState(const QString &stateName) const
+{
+    Things *things = m_engine->thingManager()->things();
+    for (int i = 0; i < things->rowCount(); i++) {
+        if (things->get(i)->thingClass()->stateTypes()->findByName(stateName)) {
+            return things->get(i);
+        }
+    }
+    return nullptr;
+}
+
+void TestBenchmarks::jsonRpcFraming_data()
+{
+    QTest::addColumn<int>("chunkSize");
+
+    QTest::newRow("512 byte chunks") << 512;
+    QTest::newRow("16 KiB chunks") << 16384;
+}
+
+void TestBenchmarks::jsonRpcFraming()
+{
+    QFETCH(int, chunkSize);
+
+    MockCore core(m_installation);
+    QVERIFY(core.listen(0, 0));
+
+    NymeaHost host;
+    host.connections()->addConnection(new Connection(QUrl(QString("nymea://127.0.0.1:%1").arg(core.tcpPort())), Connection::BearerTypeLoopback, false, "mock"));
+
+    JsonRpcClient client;
+    client.setHeartbeatInterval(0);
+    client.registerNotificationHandler(this, "Integrations", "notificationReceived");
+    client.connectToHost(&host);
+    QTRY_VERIFY(client.connected());
+
+    // A burst of state changes as the transport would hand them over
+    const int messageCount = 1000;
+    QByteArray stream;
+    for (int i = 0; i < messageCount; i++) {
+        QVariantMap notification{
+            {"id", i},
+            {"notification", "Integrations.StateChanged"},
+            {"params", m_installation->randomStateChange()}
+        };
+        stream.append(QJsonDocument::fromVariant(notification).toJson(QJsonDocument::Compact) + '\n');
+    }
+    QList<QByteArray> chunks;
+    for (int i = 0; i < stream.size(); i += chunkSize) {
+        chunks.append(stream.mid(i, chunkSize));
+    }
+
+    QBENCHMARK {
+        m_notificationCount = 0;
+        foreach (const QByteArray &chunk, chunks) {
+            QMetaObject::invokeMethod(&client, "dataReceived", Qt::DirectConnection, Q_ARG(QByteArray, chunk));
+        }
+        // The client takes one message per event loop pass
+        for (int i = 0; m_notificationCount < messageCount && i < messageCount * 2; i++) {
+            QCoreApplication::sendPostedEvents();
+        }
+    }
+    QCOMPARE(m_notificationCount, messageCount);
+}
+
+void TestBenchmarks::unpackThingClasses_data()
+{
+    QTest::addColumn<int>("thingClassCount");
+
+    QTest::newRow("100 thing classes") << 100;
+    QTest::newRow("500 thing classes") << 500;
+}
+
+void TestBenchmarks::unpackThingClasses()
+{
+    QFETCH(int, thingClassCount);
+
+    MockInstallation::Options options;
+    options.thingClasses = thingClassCount;
+    options.extraStates = 10;
+    options.things = 0;
+    MockInstallation installation(options);
+    QVariantMap params{{"thingClasses", installation.thingClasses()}};
+
+    ThingManager thingManager(m_offlineClient);
+    QBENCHMARK {
+        thingManager.clear();
+        QMetaObject::invokeMethod(&thingManager, "getThingClassesResponse", Qt::DirectConnection, Q_ARG(int, 0), Q_ARG(QVariantMap, params));
+    }
+    QCOMPARE(thingManager.thingClasses()->rowCount(), thingClassCount);
+}
+
+void TestBenchmarks::getThingsResponse_data()
+{
+    QTest::addColumn<int>("thingCount");
+
+    QTest::newRow("100 things") << 100;
+    QTest::newRow("1000 things") << 1000;
+    QTest::newRow("5000 things") << 5000;
+}
+
+void TestBenchmarks::getThingsResponse()
+{
+    QFETCH(int, thingCount);
+
+    MockInstallation::Options options;
+    options.thingClasses = 50;
+    options.things = thingCount;
+    MockInstallation installation(options);
+    QVariantMap params{{"things", installation.things()}};
+
+    ThingManager thingManager(m_offlineClient);
+    loadInstallation(&thingManager, &installation, false);
+    QBENCHMARK {
+        thingManager.things()->clearModel();
+        QMetaObject::invokeMethod(&thingManager, "getThingsResponse", Qt::DirectConnection, Q_ARG(int, 0), Q_ARG(QVariantMap, params));
+    }
+    QCOMPARE(thingManager.things()->rowCount(), thingCount);
+}
+
+void TestBenchmarks::thingsProxy_data()
+{
+    QTest::addColumn<QString>("property");
+    QTest::addColumn<QVariant>("first");
+    QTest::addColumn<QVariant>("second");
+
+    QTest::newRow("name filter") << "nameFilter" << QVariant("#1") << QVariant("#2");
+    QTest::newRow("interface filter") << "shownInterfaces" << QVariant(QStringList{"temperaturesensor"}) << QVariant(QStringList{"powersocket"});
+    QTest::newRow("tag filter") << "filterTagId" << QVariant("group-Kitchen") << QVariant("group-Office");
+    QTest::newRow("sort by state") << "sortStateName" << QVariant("connected") << QVariant("value1");
+}
+
+void TestBenchmarks::thingsProxy()
+{
+    QFETCH(QString, property);
+    QFETCH(QVariant, first);
+    QFETCH(QVariant, second);
+
+    ThingsProxy proxy;
+    proxy.setEngine(m_engine);
+    QCOMPARE(proxy.rowCount(), m_engine->thingManager()->things()->rowCount());
+
+    // Flip between two values so every round filters or sorts the whole set again
+    bool flip = false;
+    QBENCHMARK {
+        proxy.setProperty(property.toUtf8().constData(), flip ? second : first);
+        flip = !flip;
+    }
+    QVERIFY(proxy.rowCount() > 0);
+}
+
+void TestBenchmarks::getThing()
+{
+    Things *things = m_engine->thingManager()->things();
+    QList<QUuid> thingIds;
+    for (int i = 0; i < things->rowCount(); i++) {
+        thingIds.append(things->get(i)->id());
+    }
+    // Lookups come in no particular order
+    std::reverse(thingIds.begin(), thingIds.end());
+
+    int found = 0;
+    QBENCHMARK {
+        found = 0;
+        foreach (const QUuid &thingId, thingIds) {
+            if (things->getThing(thingId)) {
+                found++;
+            }
+        }
+    }
+    QCOMPARE(found, thingIds.count());
+}
+
+void TestBenchmarks::logsReply_data()
+{
+    QTest::addColumn<QString>("stateName");
+
+    QTest::newRow("double state") << "temperature";
+    QTest::newRow("bool state") << "power";
+}
+
+void TestBenchmarks::logsReply()
+{
+    QFETCH(QString, stateName);
+
+    Thing *thing = findThingWithState(stateName);
+    QVERIFY(thing);
+    StateType *stateType = thing->thingClass()->stateTypes()->findByName(stateName);
+
+    // One block, newest first, like Logging.GetLogEntries returns it
+    const int blockSize = 1000;
+    QVariantList entries;
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+    for (int i = 0; i < blockSize; i++) {
+        QVariant value = stateType->type() == "Bool" ? QVariant(i % 10 < 5) : QVariant(20 + 5 * qSin(i / 60.0));
+        entries.append(QVariantMap{
+            {"timestamp", now - i * 60000},
+            {"thingId", thing->id()},
+            {"typeId", stateType->id()},
+            {"source", "LoggingSourceStates"},
+            {"eventType", "LoggingEventTypeTrigger"},
+            {"value", value}
+        });
+    }
+    QVariantMap params{{"offset", 0}, {"count", blockSize}, {"logEntries", entries}};
+
+    QBENCHMARK {
+        QtCharts::QLineSeries series;
+        LogsModelNg model;
+        model.setEngine(m_engine);
+        model.setThingId(thing->id());
+        model.setTypeIds({stateType->id().toString()});
+        model.setGraphSeries(&series);
+        // Left incomplete so the model doesn't request anything. The block goes straight to
+        // the handler logsReply hands it to once the command id matches.
+        QMetaObject::invokeMethod(&model, "insertBlock", Qt::DirectConnection, Q_ARG(QVariantMap, params));
+        QCOMPARE(model.rowCount(), blockSize);
+        QVERIFY(series.count() >= blockSize);
+    }
+}
+
+void TestBenchmarks::xySeriesAdapter_data()
+{
+    QTest::addColumn<XYSeriesAdapter::SampleRate>("sampleRate");
+
+    QTest::newRow("minute samples") << XYSeriesAdapter::SampleRateMinute;
+    QTest::newRow("hour samples") << XYSeriesAdapter::SampleRateHour;
+}
+
+void TestBenchmarks::xySeriesAdapter()
+{
+    QFETCH(XYSeriesAdapter::SampleRate, sampleRate);
+
+    // Entries already added to the adapter would only update samples it has. Every round gets
+    // a fresh set and only the emits are timed, so QBENCHMARK can't be used here.
+    const int rounds = 20;
+    qint64 elapsed = 0;
+    for (int round = 0; round < rounds; round++) {
+        // A day of temperature readings, one every 30 seconds
+        LogsModel model;
+        QList<LogEntry*> entries;
+        QDateTime now = QDateTime::currentDateTime();
+        for (int i = 0; i < 2880; i++) {
+            entries.append(new LogEntry(now.addSecs(-i * 30), 20 + 5 * qSin(i / 120.0), QUuid(), QUuid(), LogEntry::LoggingSourceStates, LogEntry::LoggingEventTypeTrigger, QString(), &model));
+        }
+
+        QtCharts::QLineSeries series;
+        XYSeriesAdapter adapter;
+        adapter.setSampleRate(sampleRate);
+        adapter.setXySeries(&series);
+        adapter.setLogsModel(&model);
+
+        QElapsedTimer timer;
+        timer.start();
+        foreach (LogEntry *entry, entries) {
+            emit model.logEntryAdded(entry);
+        }
+        elapsed += timer.nsecsElapsed();
+        QVERIFY(series.count() > 0);
+    }
+    QTest::setBenchmarkResult(elapsed / rounds / 1000000.0, QTest::WalltimeMilliseconds);
+}
+
+QTEST_MAIN(TestBenchmarks)
+#include "testbenchmarks.moc"
@@ -0,0 +1,79 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QTimer>
+
+#include "mockcore.h"
+#include "mockinstallation.h"
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication application(argc, argv);
+    application.setApplicationName("nymea-mockcore");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Serves a synthetic nymea:core installation over JSON-RPC for load and regression testing of nymea:app.\n"
+                                     "Connect the app to nymea://<host>:<port> or ws://<host>:<ws-port>.");
+    parser.addHelpOption();
+
+    MockInstallation::Options defaults;
+    MockCore::NetworkConditions defaultConditions;
+    MockCore::Storm defaultStorm;
+
+    QCommandLineOption portOption("port", "TCP port to listen on.", "port", "2222");
+    QCommandLineOption webSocketPortOption("ws-port", "WebSocket port to listen on.", "port", "4444");
+    QCommandLineOption thingClassesOption("thing-classes", "Number of thing classes.", "count", QString::number(defaults.thingClasses));
+    QCommandLineOption thingsOption("things", "Number of things.", "count", QString::number(defaults.things));
+    QCommandLineOption statesOption("extra-states", "Additional states per thing class.", "count", QString::number(defaults.extraStates));
+    QCommandLineOption rulesOption("rules", "Number of rules.", "count", QString::number(defaults.rules));
+    QCommandLineOption tagsOption("tags", "Number of tags.", "count", QString::number(defaults.tags));
+    QCommandLineOption logEntriesOption("log-entries", "Number of entries in the log history.", "count", QString::number(defaults.logEntries));
+    QCommandLineOption logDaysOption("log-days", "Days the log history spans.", "days", QString::number(defaults.logDays));
+    QCommandLineOption seedOption("seed", "Seed for generating the installation.", "seed", QString::number(defaults.seed));
+    QCommandLineOption latencyOption("latency", "Delay every reply and notification by this many ms.", "ms", QString::number(defaultConditions.latency));
+    QCommandLineOption bandwidthOption("bandwidth", "Limit each client to this many bytes per second. 0 is unlimited.", "bytes", QString::number(defaultConditions.bandwidth));
+    QCommandLineOption disconnectOption("disconnect-interval", "Drop all clients every n ms. 0 never does.", "ms", QString::number(defaultConditions.disconnectInterval));
+    QCommandLineOption stormRateOption("storm-rate", "State change notifications per second during a storm.", "rate", QString::number(defaultStorm.rate));
+    QCommandLineOption stormDurationOption("storm-duration", "Duration of a storm.", "ms", QString::number(defaultStorm.duration));
+    QCommandLineOption stormPauseOption("storm-pause", "Pause between storms. 0 runs a single one.", "ms", QString::number(defaultStorm.pause));
+    QCommandLineOption stormDelayOption("storm-delay", "Start the first storm after this many ms.", "ms", "5000");
+    parser.addOptions({portOption, webSocketPortOption, thingClassesOption, thingsOption, statesOption, rulesOption, tagsOption,
+                       logEntriesOption, logDaysOption, seedOption, latencyOption, bandwidthOption, disconnectOption,
+                       stormRateOption, stormDurationOption, stormPauseOption, stormDelayOption});
+    parser.process(application);
+
+    MockInstallation::Options options;
+    options.thingClasses = parser.value(thingClassesOption).toInt();
+    options.things = parser.value(thingsOption).toInt();
+    options.extraStates = parser.value(statesOption).toInt();
+    options.rules = parser.value(rulesOption).toInt();
+    options.tags = parser.value(tagsOption).toInt();
+    options.logEntries = parser.value(logEntriesOption).toInt();
+    options.logDays = parser.value(logDaysOption).toInt();
+    options.seed = parser.value(seedOption).toUInt();
+    MockInstallation installation(options);
+    qInfo() << "Generated installation with" << options.thingClasses << "thing classes," << options.things << "things," << options.rules << "rules," << options.tags << "tags and" << options.logEntries << "log entries";
+
+    MockCore core(&installation);
+
+    MockCore::NetworkConditions conditions;
+    conditions.latency = parser.value(latencyOption).toInt();
+    conditions.bandwidth = parser.value(bandwidthOption).toInt();
+    conditions.disconnectInterval = parser.value(disconnectOption).toInt();
+    core.setNetworkConditions(conditions);
+
+    MockCore::Storm storm;
+    storm.rate = parser.value(stormRateOption).toInt();
+    storm.duration = parser.value(stormDurationOption).toInt();
+    storm.pause = parser.value(stormPauseOption).toInt();
+    core.setStorm(storm);
+
+    if (!core.listen(parser.value(portOption).toUShort(), parser.value(webSocketPortOption).toUShort())) {
+        return 1;
+    }
+
+    if (storm.rate > 0) {
+        QTimer::singleShot(parser.value(stormDelayOption).toInt(), &core, &MockCore::startStorm);
+    }
+
+    return application.exec();
+}
@@ -0,0 +1,473 @@
+#include "mockcore.h"
+
+#include <QTcpSocket>
+#include <QWebSocket>
+#include <QJsonDocument>
+#include <QDateTime>
+#include <QLoggingCategory>
+
+Q_LOGGING_CATEGORY(dcMockCore, "MockCore")
+
+MockCore::MockCore(MockInstallation *installation, QObject *parent):
+    QObject(parent),
+    m_installation(installation),
+    m_webSocketServer("nymea mock core", QWebSocketServer::NonSecureMode)
+{
+    connect(&m_tcpServer, &QTcpServer::newConnection, this, &MockCore::onNewTcpConnection);
+    connect(&m_webSocketServer, &QWebSocketServer::newConnection, this, &MockCore::onNewWebSocketConnection);
+
+    connect(&m_disconnectTimer, &QTimer::timeout, this, &MockCore::dropClients);
+
+    m_stormTimer.setInterval(10);
+    connect(&m_stormTimer, &QTimer::timeout, this, &MockCore::stormTick);
+}
+
+bool MockCore::listen(quint16 tcpPort, quint16 webSocketPort)
+{
+    if (!m_tcpServer.listen(QHostAddress::Any, tcpPort)) {
+        qCWarning(dcMockCore()) << "Cannot listen on TCP port" << tcpPort << m_tcpServer.errorString();
+        return false;
+    }
+    if (!m_webSocketServer.listen(QHostAddress::Any, webSocketPort)) {
+        qCWarning(dcMockCore()) << "Cannot listen on WebSocket port" << webSocketPort << m_webSocketServer.errorString();
+        m_tcpServer.close();
+        return false;
+    }
+    qCInfo(dcMockCore()) << "Listening on" << QString("nymea://127.0.0.1:%1").arg(m_tcpServer.serverPort()) << "and" << QString("ws://127.0.0.1:%1").arg(m_webSocketServer.serverPort());
+    return true;
+}
+
+quint16 MockCore::tcpPort() const
+{
+    return m_tcpServer.serverPort();
+}
+
+quint16 MockCore::webSocketPort() const
+{
+    return m_webSocketServer.serverPort();
+}
+
+void MockCore::setNetworkConditions(const NetworkConditions &conditions)
+{
+    m_conditions = conditions;
+    if (m_conditions.disconnectInterval > 0) {
+        m_disconnectTimer.start(m_conditions.disconnectInterval);
+    } else {
+        m_disconnectTimer.stop();
+    }
+}
+
+MockCore::NetworkConditions MockCore::networkConditions() const
+{
+    return m_conditions;
+}
+
+void MockCore::setStorm(const Storm &storm)
+{
+    m_storm = storm;
+}
+
+void MockCore::startStorm()
+{
+    if (m_storm.rate <= 0) {
+        return;
+    }
+    qCInfo(dcMockCore()) << "Starting notification storm:" << m_storm.rate << "state changes per second for" << m_storm.duration << "ms";
+    m_stormSent = 0;
+    m_stormClock.start();
+    m_stormTimer.start();
+}
+
+void MockCore::stopStorm()
+{
+    m_stormTimer.stop();
+}
+
+int MockCore::clientCount() const
+{
+    return m_connections.count();
+}
+
+quint64 MockCore::requestCount() const
+{
+    return m_requestCount;
+}
+
+quint64 MockCore::notificationCount() const
+{
+    return m_notificationCount;
+}
+
+void MockCore::onNewTcpConnection()
+{
+    while (m_tcpServer.hasPendingConnections()) {
+        QTcpSocket *socket = m_tcpServer.nextPendingConnection();
+        qCInfo(dcMockCore()) << "New TCP client" << socket->peerAddress().toString();
+        addConnection(new MockConnection(socket, this));
+    }
+}
+
+void MockCore::onNewWebSocketConnection()
+{
+    while (m_webSocketServer.hasPendingConnections()) {
+        QWebSocket *socket = m_webSocketServer.nextPendingConnection();
+        qCInfo(dcMockCore()) << "New WebSocket client" << socket->peerAddress().toString();
+        addConnection(new MockConnection(socket, this));
+    }
+}
+
+void MockCore::stormTick()
+{
+    qint64 elapsed = m_stormClock.elapsed();
+    if (elapsed >= m_storm.duration) {
+        if (m_storm.pause <= 0) {
+            qCInfo(dcMockCore()) << "Notification storm finished after" << m_stormSent << "state changes";
+            stopStorm();
+            return;
+        }
+        if (elapsed < m_storm.duration + m_storm.pause) {
+            return;
+        }
+        qCInfo(dcMockCore()) << "Starting next notification storm round";
+        m_stormClock.restart();
+        m_stormSent = 0;
+        elapsed = 0;
+    }
+
+    // Catch up to where we should be, timers are not that precise
+    qint64 due = elapsed * m_storm.rate / 1000;
+    while (m_stormSent < due) {
+        QVariantMap change = m_installation->randomStateChange();
+        sendNotification("Integrations.StateChanged", change);
+        sendNotification("Logging.LogEntryAdded", {{"logEntry", m_installation->lastLogEntry()}});
+        m_stormSent++;
+    }
+}
+
+void MockCore::dropClients()
+{
+    if (m_connections.isEmpty()) {
+        return;
+    }
+    qCInfo(dcMockCore()) << "Dropping" << m_connections.count() << "clients";
+    foreach (MockConnection *connection, m_connections) {
+        connection->close();
+    }
+}
+
+void MockCore::addConnection(MockConnection *connection)
+{
+    m_connections.append(connection);
+    connect(connection, &MockConnection::disconnected, this, [this, connection](){
+        qCInfo(dcMockCore()) << "Client disconnected";
+        m_connections.removeAll(connection);
+        connection->deleteLater();
+        emit clientCountChanged(m_connections.count());
+    });
+    emit clientCountChanged(m_connections.count());
+}
+
+void MockCore::handleRequest(MockConnection *connection, const QVariantMap &request)
+{
+    m_requestCount++;
+    QString method = request.value("method").toString();
+    qCDebug(dcMockCore()) << "Request" << request.value("id").toInt() << method;
+
+    QString error;
+    QVariantMap params = processRequest(connection, method, request.value("params").toMap(), &error);
+
+    QVariantMap reply;
+    reply.insert("id", request.value("id"));
+    if (error.isEmpty()) {
+        reply.insert("status", "success");
+        reply.insert("params", params);
+    } else {
+        qCWarning(dcMockCore()) << "Request" << method << "failed:" << error;
+        reply.insert("status", "error");
+        reply.insert("error", error);
+    }
+    connection->send(reply);
+}
+
+QVariantMap MockCore::processRequest(MockConnection *connection, const QString &method, const QVariantMap &params, QString *error)
+{
+    if (method == "JSONRPC.Hello") {
+        return {
+            {"uuid", "{9c8e1a4e-1f1b-4a3c-8d0e-6d6f636b636f}"},
+            {"name", "nymea mock core"},
+            {"server", "nymea"},
+            {"version", "1.0.0-mock"},
+            {"protocol version", "5.5"},
+            {"locale", params.value("locale", "en_US")},
+            {"initialSetupRequired", false},
+            {"authenticationRequired", false},
+            {"pushButtonAuthAvailable", false},
+            {"experiences", QVariantList{QVariantMap{{"name", "Energy"}, {"version", "1.0"}}}}
+        };
+    }
+    if (method == "JSONRPC.Version") {
+        return {
+            {"version", "1.0.0-mock"},
+            {"protocol version", "5.5"},
+            {"qtVersion", qVersion()},
+            {"qtBuildVersion", QT_VERSION_STR}
+        };
+    }
+    if (method == "JSONRPC.SetNotificationStatus") {
+        if (params.contains("namespaces")) {
+            connection->setNotificationNamespaces(params.value("namespaces").toStringList());
+            return {{"namespaces", params.value("namespaces")}};
+        }
+        connection->setNotificationsEnabled(params.value("enabled").toBool());
+        return {{"enabled", params.value("enabled").toBool()}};
+    }
+    if (method == "JSONRPC.IsCloudConnected") {
+        return {{"connected", false}, {"cloudConnectionState", "CloudConnectionStateDisabled"}};
+    }
+
+    if (method == "Integrations.GetVendors") {
+        return {{"vendors", m_installation->vendors()}};
+    }
+    if (method == "Integrations.GetPlugins") {
+        return {{"plugins", m_installation->plugins()}};
+    }
+    if (method == "Integrations.GetPluginConfiguration") {
+        return {{"thingError", "ThingErrorNoError"}, {"configuration", QVariantList()}};
+    }
+    if (method == "Integrations.GetThingClasses") {
+        return {{"thingError", "ThingErrorNoError"}, {"thingClasses", m_installation->thingClasses()}};
+    }
+    if (method == "Integrations.GetThings") {
+        return {{"thingError", "ThingErrorNoError"}, {"things", m_installation->things()}};
+    }
+    if (method == "Integrations.GetIOConnections") {
+        return {{"ioConnections", QVariantList()}};
+    }
+    if (method == "Integrations.ExecuteAction") {
+        QUuid thingId = params.value("thingId").toUuid();
+        if (!m_installation->hasThing(thingId)) {
+            return {{"thingError", "ThingErrorThingNotFound"}};
+        }
+        // Actions in the mock set the state of the same id to the first param
+        QVariant value = params.value("params").toList().value(0).toMap().value("value");
+        QVariantMap change = m_installation->setState(thingId, params.value("actionTypeId").toUuid(), value);
+        if (change.isEmpty()) {
+            return {{"thingError", "ThingErrorActionTypeNotFound"}};
+        }
+        sendNotification("Integrations.StateChanged", change);
+        sendNotification("Logging.LogEntryAdded", {{"logEntry", m_installation->lastLogEntry()}});
+        return {{"thingError", "ThingErrorNoError"}};
+    }
+
+    if (method == "Rules.GetRules") {
+        return {{"ruleDescriptions", m_installation->ruleDescriptions()}};
+    }
+    if (method == "Rules.GetRuleDetails") {
+        QVariantMap rule = m_installation->ruleDetails(params.value("ruleId").toUuid());
+        if (rule.isEmpty()) {
+            return {{"ruleError", "RuleErrorRuleNotFound"}};
+        }
+        return {{"ruleError", "RuleErrorNoError"}, {"rule", rule}};
+    }
+
+    if (method == "Tags.GetTags") {
+        return {{"tagError", "TagErrorNoError"}, {"tags", m_installation->tags()}};
+    }
+
+    if (method == "Logging.GetLogEntries") {
+        return m_installation->logEntries(params);
+    }
+
+    if (method == "Energy.GetRootMeter") {
+        QUuid rootMeterId = m_installation->rootMeterId();
+        if (rootMeterId.isNull()) {
+            return QVariantMap();
+        }
+        return {{"rootMeterThingId", rootMeterId}};
+    }
+    if (method == "Energy.GetPowerBalance") {
+        QVariantMap balance = m_installation->powerBalance(QDateTime::currentSecsSinceEpoch());
+        return {
+            {"currentPowerConsumption", balance.value("consumption")},
+            {"currentPowerProduction", balance.value("production")},
+            {"currentPowerAcquisition", balance.value("acquisition")},
+            {"currentPowerStorage", balance.value("storage")},
+            {"totalConsumption", balance.value("totalConsumption")},
+            {"totalProduction", balance.value("totalProduction")},
+            {"totalAcquisition", balance.value("totalAcquisition")},
+            {"totalReturn", balance.value("totalReturn")}
+        };
+    }
+    if (method == "Energy.GetPowerBalanceLogs") {
+        return m_installation->powerBalanceLogs(params);
+    }
+    if (method == "Energy.GetThingPowerLogs") {
+        return m_installation->thingPowerLogs(params);
+    }
+
+    *error = QString("Invalid method \"%1\". The mock core does not implement it.").arg(method);
+    return QVariantMap();
+}
+
+void MockCore::sendNotification(const QString &notification, const QVariantMap &params)
+{
+    QVariantMap message;
+    message.insert("id", static_cast<qulonglong>(m_notificationCount++));
+    message.insert("notification", notification);
+    message.insert("params", params);
+
+    QString nameSpace = notification.left(notification.indexOf('.'));
+    foreach (MockConnection *connection, m_connections) {
+        if (connection->wantsNotifications(nameSpace)) {
+            connection->send(message);
+        }
+    }
+}
+
+MockConnection::MockConnection(QTcpSocket *socket, MockCore *core):
+    QObject(core),
+    m_core(core),
+    m_tcpSocket(socket)
+{
+    socket->setParent(this);
+    connect(socket, &QTcpSocket::readyRead, this, [this](){
+        received(m_tcpSocket->readAll());
+    });
+    connect(socket, &QTcpSocket::disconnected, this, &MockConnection::disconnected);
+
+    m_pumpTimer.setInterval(10);
+    connect(&m_pumpTimer, &QTimer::timeout, this, &MockConnection::pump);
+}
+
+MockConnection::MockConnection(QWebSocket *socket, MockCore *core):
+    QObject(core),
+    m_core(core),
+    m_webSocket(socket)
+{
+    socket->setParent(this);
+    connect(socket, &QWebSocket::textMessageReceived, this, [this](const QString &message){
+        received(message.toUtf8() + '\n');
+    });
+    connect(socket, &QWebSocket::binaryMessageReceived, this, [this](const QByteArray &message){
+        // The first byte tells whether the app sent JSON (0x01), CBOR (0x02) or compressed data (0x03).
+        // The mock core only speaks JSON.
+        if (message.startsWith('\x03')) {
+            received(qUncompress(message.mid(1)) + '\n');
+        } else if (message.startsWith('\x01')) {
+            received(message.mid(1) + '\n');
+        }
+    });
+    connect(socket, &QWebSocket::disconnected, this, &MockConnection::disconnected);
+
+    m_pumpTimer.setInterval(10);
+    connect(&m_pumpTimer, &QTimer::timeout, this, &MockConnection::pump);
+}
+
+void MockConnection::send(const QVariantMap &message)
+{
+    QByteArray data = QJsonDocument::fromVariant(message).toJson(QJsonDocument::Compact) + '\n';
+    int latency = m_core->networkConditions().latency;
+    if (latency > 0) {
+        QTimer::singleShot(latency, this, [this, data](){
+            enqueue(data);
+        });
+    } else {
+        enqueue(data);
+    }
+}
+
+void MockConnection::close()
+{
+    if (m_tcpSocket) {
+        m_tcpSocket->abort();
+    }
+    if (m_webSocket) {
+        m_webSocket->abort();
+    }
+}
+
+bool MockConnection::wantsNotifications(const QString &nameSpace) const
+{
+    return m_notificationsEnabled && (m_notificationNamespaces.isEmpty() || m_notificationNamespaces.contains(nameSpace));
+}
+
+void MockConnection::setNotificationNamespaces(const QStringList &namespaces)
+{
+    m_notificationNamespaces = namespaces;
+    m_notificationsEnabled = !namespaces.isEmpty();
+}
+
+void MockConnection::setNotificationsEnabled(bool enabled)
+{
+    m_notificationNamespaces.clear();
+    m_notificationsEnabled = enabled;
+}
+
+void MockConnection::received(const QByteArray &data)
+{
+    m_receiveBuffer.append(data);
+    int index = m_receiveBuffer.indexOf('\n');
+    while (index >= 0) {
+        QByteArray line = m_receiveBuffer.left(index).trimmed();
+        m_receiveBuffer.remove(0, index + 1);
+        index = m_receiveBuffer.indexOf('\n');
+        if (line.isEmpty()) {
+            continue;
+        }
+
+        QJsonParseError parseError;
+        QJsonDocument jsonDoc = QJsonDocument::fromJson(line, &parseError);
+        if (parseError.error != QJsonParseError::NoError) {
+            qCWarning(dcMockCore()) << "Cannot parse request:" << parseError.errorString() << line;
+            send({{"id", -1}, {"status", "error"}, {"error", "Failed to parse JSON data: " + parseError.errorString()}});
+            continue;
+        }
+        m_core->handleRequest(this, jsonDoc.toVariant().toMap());
+    }
+}
+
+void MockConnection::enqueue(const QByteArray &data)
+{
+    m_sendQueue.enqueue(data);
+    if (m_core->networkConditions().bandwidth > 0 && !m_pumpTimer.isActive()) {
+        m_pumpClock.start();
+        m_pumpTimer.start();
+    }
+    pump();
+}
+
+void MockConnection::pump()
+{
+    int bandwidth = m_core->networkConditions().bandwidth;
+    if (bandwidth > 0) {
+        // Allow bursts of up to 100 ms worth of data
+        m_budget = qMin(m_budget + m_pumpClock.restart() * bandwidth / 1000.0, bandwidth / 10.0 + 1);
+    }
+
+    while (!m_sendQueue.isEmpty() && (bandwidth <= 0 || m_budget > 0)) {
+        if (m_webSocket) {
+            QByteArray message = m_sendQueue.dequeue();
+            m_webSocket->sendTextMessage(QString::fromUtf8(message));
+            m_budget -= message.size();
+        } else if (m_tcpSocket) {
+            // TCP is a stream, so slow links hand out partial messages like a real one would
+            QByteArray &head = m_sendQueue.head();
+            int chunkSize = bandwidth > 0 ? qMin(head.size(), static_cast<int>(m_budget) + 1) : head.size();
+            m_tcpSocket->write(head.left(chunkSize));
+            head.remove(0, chunkSize);
+            m_budget -= chunkSize;
+            if (head.isEmpty()) {
+                m_sendQueue.dequeue();
+            }
+        } else {
+            m_sendQueue.clear();
+        }
+    }
+
+    if (bandwidth <= 0) {
+        m_budget = 0;
+    }
+    if (m_sendQueue.isEmpty()) {
+        m_pumpTimer.stop();
+    }
+}
@@ -0,0 +1,133 @@
+#ifndef MOCKCORE_H
+#define MOCKCORE_H
+
+#include <QObject>
+#include <QTimer>
+#include <QQueue>
+#include <QElapsedTimer>
+#include <QTcpServer>
+#include <QPointer>
+#include <QWebSocketServer>
+
+#include "mockinstallation.h"
+
+class QTcpSocket;
+class QWebSocket;
+
+class MockConnection;
+
+// Stand-in for nymea:core. Speaks newline delimited JSON-RPC over TCP and
+// WebSockets and serves a MockInstallation. Network conditions can be degraded
+// on purpose to see how the app copes.
+class MockCore : public QObject
+{
+    Q_OBJECT
+public:
+    struct NetworkConditions {
+        // Added to every reply and notification, in ms
+        int latency = 0;
+        // Bytes per second per client, 0 for unlimited
+        int bandwidth = 0;
+        // Drop all clients every n ms, 0 to never do so
+        int disconnectInterval = 0;
+    };
+
+    struct Storm {
+        // State change notifications per second
+        int rate = 0;
+        // How long a storm lasts and how long to wait before the next one, in ms. A pause of 0 runs it once.
+        int duration = 10000;
+        int pause = 0;
+    };
+
+    explicit MockCore(MockInstallation *installation, QObject *parent = nullptr);
+
+    bool listen(quint16 tcpPort, quint16 webSocketPort);
+    quint16 tcpPort() const;
+    quint16 webSocketPort() const;
+
+    void setNetworkConditions(const NetworkConditions &conditions);
+    NetworkConditions networkConditions() const;
+
+    void setStorm(const Storm &storm);
+    void startStorm();
+    void stopStorm();
+
+    int clientCount() const;
+    quint64 requestCount() const;
+    quint64 notificationCount() const;
+
+signals:
+    void clientCountChanged(int clientCount);
+
+private slots:
+    void onNewTcpConnection();
+    void onNewWebSocketConnection();
+    void stormTick();
+    void dropClients();
+
+private:
+    friend class MockConnection;
+
+    void addConnection(MockConnection *connection);
+    void handleRequest(MockConnection *connection, const QVariantMap &request);
+    QVariantMap processRequest(MockConnection *connection, const QString &method, const QVariantMap &params, QString *error);
+    void sendNotification(const QString &notification, const QVariantMap &params);
+
+    MockInstallation *m_installation = nullptr;
+    QTcpServer m_tcpServer;
+    QWebSocketServer m_webSocketServer;
+    QList<MockConnection*> m_connections;
+
+    NetworkConditions m_conditions;
+    QTimer m_disconnectTimer;
+
+    Storm m_storm;
+    QTimer m_stormTimer;
+    QElapsedTimer m_stormClock;
+    qint64 m_stormSent = 0;
+
+    quint64 m_requestCount = 0;
+    quint64 m_notificationCount = 0;
+};
+
+// One client. Outgoing data goes through a queue so latency and bandwidth limits
+// apply to replies and notifications alike.
+class MockConnection : public QObject
+{
+    Q_OBJECT
+public:
+    MockConnection(QTcpSocket *socket, MockCore *core);
+    MockConnection(QWebSocket *socket, MockCore *core);
+
+    void send(const QVariantMap &message);
+    void close();
+
+    bool wantsNotifications(const QString &nameSpace) const;
+    void setNotificationNamespaces(const QStringList &namespaces);
+    void setNotificationsEnabled(bool enabled);
+
+signals:
+    void disconnected();
+
+private:
+    void received(const QByteArray &data);
+    void enqueue(const QByteArray &data);
+    void pump();
+
+    MockCore *m_core = nullptr;
+    QPointer<QTcpSocket> m_tcpSocket;
+    QPointer<QWebSocket> m_webSocket;
+    QByteArray m_receiveBuffer;
+
+    // Whole messages for WebSockets, they can't be split across frames
+    QQueue<QByteArray> m_sendQueue;
+    QTimer m_pumpTimer;
+    QElapsedTimer m_pumpClock;
+    double m_budget = 0;
+
+    bool m_notificationsEnabled = false;
+    QStringList m_notificationNamespaces;
+};
+
+#endif // MOCKCORE_H
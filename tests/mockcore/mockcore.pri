@@ -0,0 +1,11 @@
+QT += network websockets
+
+INCLUDEPATH += $${PWD}
+
+HEADERS += \
+    $${PWD}/mockcore.h \
+    $${PWD}/mockinstallation.h
+
+SOURCES += \
+    $${PWD}/mockcore.cpp \
+    $${PWD}/mockinstallation.cpp
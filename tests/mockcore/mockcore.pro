@@ -0,0 +1,11 @@
+TEMPLATE = app
+TARGET = nymea-mockcore
+
+include(../../shared.pri)
+include(mockcore.pri)
+
+QT -= gui
+CONFIG += console
+CONFIG -= app_bundle
+
+SOURCES += main.cpp
@@ -0,0 +1,672 @@
+#include "mockinstallation.h"
+
+#include <QDateTime>
+#include <QSet>
+#include <QtMath>
+
+#include <limits>
+
+namespace {
+
+struct ThingClassTemplate {
+    const char *name;
+    QStringList interfaces;
+    QStringList states;
+};
+
+// name, type, unit, min, max, writable
+struct StateTemplate {
+    const char *name;
+    const char *type;
+    const char *unit;
+    double minValue;
+    double maxValue;
+    bool writable;
+};
+
+const StateTemplate stateTemplates[] = {
+    {"connected", "Bool", "UnitNone", 0, 0, false},
+    {"power", "Bool", "UnitNone", 0, 0, true},
+    {"currentPower", "Double", "UnitWatt", 0, 3600, false},
+    {"totalEnergyConsumed", "Double", "UnitKiloWattHour", 0, 100000, false},
+    {"totalEnergyProduced", "Double", "UnitKiloWattHour", 0, 100000, false},
+    {"temperature", "Double", "UnitDegreeCelsius", -20, 40, false},
+    {"humidity", "Double", "UnitPercentage", 0, 100, false},
+    {"brightness", "Int", "UnitPercentage", 0, 100, true},
+};
+
+const StateTemplate *findStateTemplate(const QString &name)
+{
+    for (const StateTemplate &stateTemplate : stateTemplates) {
+        if (name == stateTemplate.name) {
+            return &stateTemplate;
+        }
+    }
+    return nullptr;
+}
+
+const QList<ThingClassTemplate> &thingClassTemplates()
+{
+    static const QList<ThingClassTemplate> templates = {
+        {"Smart plug", {"powersocket", "smartmeterconsumer", "connectable"}, {"connected", "power", "currentPower", "totalEnergyConsumed"}},
+        {"Thermometer", {"temperaturesensor", "humiditysensor", "connectable"}, {"connected", "temperature", "humidity"}},
+        {"Dimmable light", {"dimmablelight", "connectable"}, {"connected", "power", "brightness"}},
+        {"Energy meter", {"energymeter", "connectable"}, {"connected", "currentPower", "totalEnergyConsumed", "totalEnergyProduced"}},
+    };
+    return templates;
+}
+
+const QStringList rooms = {"Living room", "Kitchen", "Bedroom", "Bathroom", "Office", "Garage", "Garden"};
+
+// Totals are counted from here so they grow steadily instead of starting at 0 on every run
+const qint64 totalsEpoch = 1577836800; // 2020-01-01
+
+}
+
+MockInstallation::MockInstallation(const Options &options):
+    m_options(options),
+    m_random(options.seed)
+{
+    int vendorCount = qMax(1, m_options.thingClasses / 5);
+    for (int i = 0; i < vendorCount; i++) {
+        m_vendors.append(qMakePair(createUuid(), QString("Vendor %1").arg(i + 1)));
+        m_plugins.append(qMakePair(createUuid(), QString("Plugin %1").arg(i + 1)));
+    }
+
+    for (int i = 0; i < m_options.thingClasses; i++) {
+        const ThingClassTemplate &classTemplate = thingClassTemplates().at(i % thingClassTemplates().count());
+        ThingClass thingClass;
+        thingClass.id = createUuid();
+        thingClass.vendorId = m_vendors.at(i % vendorCount).first;
+        thingClass.pluginId = m_plugins.at(i % vendorCount).first;
+        thingClass.hostParamTypeId = createUuid();
+        thingClass.name = QString("%1 %2").arg(classTemplate.name).arg(i / thingClassTemplates().count() + 1);
+        thingClass.interfaces = classTemplate.interfaces;
+        foreach (const QString &stateName, classTemplate.states) {
+            const StateTemplate *stateTemplate = findStateTemplate(stateName);
+            StateType stateType;
+            stateType.id = createUuid();
+            stateType.name = stateName;
+            stateType.type = stateTemplate->type;
+            stateType.unit = stateTemplate->unit;
+            stateType.minValue = stateTemplate->minValue;
+            stateType.maxValue = stateTemplate->maxValue;
+            stateType.writable = stateTemplate->writable;
+            stateType.defaultValue = stateType.type == "Bool" ? QVariant(false) : QVariant(0);
+            thingClass.stateTypes.append(stateType);
+        }
+        for (int j = 0; j < m_options.extraStates; j++) {
+            StateType stateType;
+            stateType.id = createUuid();
+            stateType.name = QString("value%1").arg(j + 1);
+            stateType.type = "Double";
+            stateType.unit = "UnitNone";
+            stateType.minValue = -1000;
+            stateType.maxValue = 1000;
+            stateType.defaultValue = 0;
+            thingClass.stateTypes.append(stateType);
+        }
+        m_thingClasses.append(thingClass);
+    }
+
+    for (int i = 0; i < m_options.things && !m_thingClasses.isEmpty(); i++) {
+        Thing thing;
+        thing.id = createUuid();
+        thing.thingClass = i % m_thingClasses.count();
+        const ThingClass &thingClass = m_thingClasses.at(thing.thingClass);
+        thing.name = QString("%1 #%2").arg(thingClass.name).arg(i + 1);
+        thing.host = QString("10.0.%1.%2").arg(i / 250).arg(i % 250 + 1);
+        foreach (const StateType &stateType, thingClass.stateTypes) {
+            thing.stateValues.append(randomValue(stateType));
+        }
+        if (thingClass.interfaces.contains("smartmeterconsumer") || thingClass.interfaces.contains("energymeter")) {
+            m_energyThings.append(i);
+        }
+        m_thingIndex.insert(thing.id, i);
+        m_things.append(thing);
+    }
+
+    for (int i = 0; i < m_options.rules && !m_things.isEmpty(); i++) {
+        Rule rule;
+        rule.id = createUuid();
+        rule.name = QString("Rule %1").arg(i + 1);
+        rule.thing = m_random.bounded(m_things.count());
+        rule.stateType = m_random.bounded(m_thingClasses.at(m_things.at(rule.thing).thingClass).stateTypes.count());
+        rule.enabled = m_random.bounded(10) > 0;
+        rule.active = m_random.bounded(2) == 1;
+        m_rules.append(rule);
+    }
+
+    for (int i = 0; i < m_options.tags && !m_things.isEmpty(); i++) {
+        Tag tag;
+        tag.thing = i % m_things.count();
+        if (i < m_things.count()) {
+            tag.tagId = "group-" + rooms.at(m_random.bounded(rooms.count()));
+            tag.value = "1";
+        } else {
+            tag.tagId = "favorites";
+            tag.value = QString::number(i - m_things.count());
+        }
+        m_tags.append(tag);
+    }
+
+    if (!m_things.isEmpty()) {
+        qint64 end = QDateTime::currentMSecsSinceEpoch();
+        qint64 start = end - static_cast<qint64>(m_options.logDays) * 24 * 60 * 60 * 1000;
+        qint64 step = m_options.logEntries > 0 ? (end - start) / m_options.logEntries : 0;
+        m_logEntries.reserve(m_options.logEntries);
+        for (int i = 0; i < m_options.logEntries; i++) {
+            LogEntry entry;
+            entry.timestamp = start + i * step + static_cast<qint64>(m_random.bounded(static_cast<quint32>(qMax<qint64>(1, step))));
+            entry.thing = m_random.bounded(m_things.count());
+            const ThingClass &thingClass = m_thingClasses.at(m_things.at(entry.thing).thingClass);
+            entry.stateType = m_random.bounded(thingClass.stateTypes.count());
+            entry.value = randomValue(thingClass.stateTypes.at(entry.stateType));
+            m_logEntries.append(entry);
+        }
+    }
+}
+
+MockInstallation::Options MockInstallation::options() const
+{
+    return m_options;
+}
+
+QVariantList MockInstallation::vendors() const
+{
+    QVariantList ret;
+    for (const QPair<QUuid, QString> &vendor : m_vendors) {
+        ret.append(QVariantMap{
+            {"id", vendor.first},
+            {"name", vendor.second.toLower().remove(' ')},
+            {"displayName", vendor.second}
+        });
+    }
+    return ret;
+}
+
+QVariantList MockInstallation::plugins() const
+{
+    QVariantList ret;
+    for (const QPair<QUuid, QString> &plugin : m_plugins) {
+        ret.append(QVariantMap{
+            {"id", plugin.first},
+            {"name", plugin.second.toLower().remove(' ')},
+            {"displayName", plugin.second},
+            {"paramTypes", QVariantList()}
+        });
+    }
+    return ret;
+}
+
+QVariantList MockInstallation::thingClasses() const
+{
+    QVariantList ret;
+    for (const ThingClass &thingClass : m_thingClasses) {
+        QVariantList stateTypes;
+        QVariantList eventTypes;
+        QVariantList actionTypes;
+        for (int i = 0; i < thingClass.stateTypes.count(); i++) {
+            const StateType &stateType = thingClass.stateTypes.at(i);
+            QVariantMap packed = packStateType(stateType, i);
+            stateTypes.append(packed);
+
+            // Like in nymea:core, every state has a matching event and writable ones an action
+            QVariantMap paramType{
+                {"id", stateType.id},
+                {"name", stateType.name},
+                {"displayName", packed.value("displayName")},
+                {"type", stateType.type},
+                {"index", 0},
+                {"defaultValue", stateType.defaultValue}
+            };
+            eventTypes.append(QVariantMap{
+                {"id", stateType.id},
+                {"name", stateType.name},
+                {"displayName", packed.value("displayName").toString() + " changed"},
+                {"index", i},
+                {"paramTypes", QVariantList{paramType}}
+            });
+            if (stateType.writable) {
+                actionTypes.append(QVariantMap{
+                    {"id", stateType.id},
+                    {"name", stateType.name},
+                    {"displayName", "Set " + packed.value("displayName").toString()},
+                    {"index", actionTypes.count()},
+                    {"paramTypes", QVariantList{paramType}}
+                });
+            }
+        }
+
+        QVariantList paramTypes{QVariantMap{
+            {"id", thingClass.hostParamTypeId},
+            {"name", "host"},
+            {"displayName", "Host address"},
+            {"type", "String"},
+            {"index", 0},
+            {"defaultValue", QString()},
+            {"inputType", "InputTypeIPv4Address"}
+        }};
+
+        ret.append(QVariantMap{
+            {"id", thingClass.id},
+            {"vendorId", thingClass.vendorId},
+            {"pluginId", thingClass.pluginId},
+            {"name", thingClass.name.toLower().remove(' ')},
+            {"displayName", thingClass.name},
+            {"browsable", false},
+            {"createMethods", QStringList{"CreateMethodUser", "CreateMethodDiscovery"}},
+            {"setupMethod", "SetupMethodJustAdd"},
+            {"interfaces", thingClass.interfaces},
+            {"providedInterfaces", QStringList()},
+            {"paramTypes", paramTypes},
+            {"settingsTypes", QVariantList()},
+            {"discoveryParamTypes", QVariantList()},
+            {"stateTypes", stateTypes},
+            {"eventTypes", eventTypes},
+            {"actionTypes", actionTypes},
+            {"browserItemActionTypes", QVariantList()}
+        });
+    }
+    return ret;
+}
+
+QVariantList MockInstallation::things() const
+{
+    QVariantList ret;
+    for (const Thing &thing : m_things) {
+        const ThingClass &thingClass = m_thingClasses.at(thing.thingClass);
+        QVariantList states;
+        for (int i = 0; i < thingClass.stateTypes.count(); i++) {
+            states.append(QVariantMap{
+                {"stateTypeId", thingClass.stateTypes.at(i).id},
+                {"value", thing.stateValues.at(i)}
+            });
+        }
+        ret.append(QVariantMap{
+            {"id", thing.id},
+            {"thingClassId", thingClass.id},
+            {"name", thing.name},
+            {"setupStatus", "ThingSetupStatusComplete"},
+            {"params", QVariantList{QVariantMap{{"paramTypeId", thingClass.hostParamTypeId}, {"value", thing.host}}}},
+            {"settings", QVariantList()},
+            {"states", states}
+        });
+    }
+    return ret;
+}
+
+QVariantList MockInstallation::ruleDescriptions() const
+{
+    QVariantList ret;
+    for (const Rule &rule : m_rules) {
+        ret.append(QVariantMap{
+            {"id", rule.id},
+            {"name", rule.name},
+            {"enabled", rule.enabled},
+            {"active", rule.active},
+            {"executable", true}
+        });
+    }
+    return ret;
+}
+
+QVariantMap MockInstallation::ruleDetails(const QUuid &ruleId) const
+{
+    for (const Rule &rule : m_rules) {
+        if (rule.id != ruleId) {
+            continue;
+        }
+        const Thing &thing = m_things.at(rule.thing);
+        const ThingClass &thingClass = m_thingClasses.at(thing.thingClass);
+        const StateType &stateType = thingClass.stateTypes.at(rule.stateType);
+
+        QVariantMap stateDescriptor{
+            {"thingId", thing.id},
+            {"stateTypeId", stateType.id},
+            {"operator", stateType.type == "Bool" ? "ValueOperatorEquals" : "ValueOperatorGreater"},
+            {"value", stateType.type == "Bool" ? QVariant(true) : QVariant((stateType.minValue + stateType.maxValue) / 2)}
+        };
+
+        // Switch the first writable state of some other thing
+        QVariantList actions;
+        for (int i = 0; i < m_things.count() && actions.isEmpty(); i++) {
+            const Thing &target = m_things.at((rule.thing + i + 1) % m_things.count());
+            for (const StateType &targetStateType : m_thingClasses.at(target.thingClass).stateTypes) {
+                if (targetStateType.writable) {
+                    actions.append(QVariantMap{
+                        {"thingId", target.id},
+                        {"actionTypeId", targetStateType.id},
+                        {"ruleActionParams", QVariantList{QVariantMap{{"paramTypeId", targetStateType.id}, {"value", targetStateType.type == "Bool" ? QVariant(true) : QVariant(50)}}}}
+                    });
+                    break;
+                }
+            }
+        }
+
+        return QVariantMap{
+            {"id", rule.id},
+            {"name", rule.name},
+            {"enabled", rule.enabled},
+            {"active", rule.active},
+            {"executable", true},
+            {"eventDescriptors", QVariantList()},
+            {"actions", actions},
+            {"exitActions", QVariantList()},
+            {"timeDescriptor", QVariantMap()},
+            {"stateEvaluator", QVariantMap{{"stateDescriptor", stateDescriptor}, {"operator", "StateOperatorAnd"}}}
+        };
+    }
+    return QVariantMap();
+}
+
+QVariantList MockInstallation::tags() const
+{
+    QVariantList ret;
+    for (const Tag &tag : m_tags) {
+        ret.append(QVariantMap{
+            {"thingId", m_things.at(tag.thing).id},
+            {"tagId", tag.tagId},
+            {"value", tag.value}
+        });
+    }
+    return ret;
+}
+
+QVariantMap MockInstallation::logEntries(const QVariantMap &params) const
+{
+    QSet<int> thingFilter;
+    foreach (const QVariant &thingId, params.value("thingIds").toList()) {
+        thingFilter.insert(thingIndex(thingId.toUuid()));
+    }
+    QSet<QUuid> typeFilter;
+    foreach (const QVariant &typeId, params.value("typeIds").toList()) {
+        typeFilter.insert(typeId.toUuid());
+    }
+    QList<QPair<qint64, qint64>> timeFilters;
+    foreach (const QVariant &timeFilter, params.value("timeFilters").toList()) {
+        QVariantMap filterMap = timeFilter.toMap();
+        qint64 start = filterMap.contains("startDate") ? filterMap.value("startDate").toLongLong() * 1000 : 0;
+        qint64 end = filterMap.contains("endDate") ? filterMap.value("endDate").toLongLong() * 1000 : std::numeric_limits<qint64>::max();
+        timeFilters.append(qMakePair(start, end));
+    }
+    int offset = params.value("offset").toInt();
+    int limit = params.contains("limit") ? params.value("limit").toInt() : -1;
+
+    QVariantList entries;
+    int matched = 0;
+    // Newest first, like nymea:core
+    for (int i = m_logEntries.count() - 1; i >= 0; i--) {
+        if (limit >= 0 && entries.count() >= limit) {
+            break;
+        }
+        const LogEntry &entry = m_logEntries.at(i);
+        if (!thingFilter.isEmpty() && !thingFilter.contains(entry.thing)) {
+            continue;
+        }
+        if (!typeFilter.isEmpty() && !typeFilter.contains(m_thingClasses.at(m_things.at(entry.thing).thingClass).stateTypes.at(entry.stateType).id)) {
+            continue;
+        }
+        if (!timeFilters.isEmpty()) {
+            bool inRange = false;
+            for (const QPair<qint64, qint64> &range : timeFilters) {
+                inRange |= entry.timestamp >= range.first && entry.timestamp <= range.second;
+            }
+            if (!inRange) {
+                continue;
+            }
+        }
+        if (matched++ < offset) {
+            continue;
+        }
+        entries.append(packLogEntry(entry));
+    }
+
+    return QVariantMap{
+        {"loggingError", "LoggingErrorNoError"},
+        {"offset", offset},
+        {"count", entries.count()},
+        {"logEntries", entries}
+    };
+}
+
+QUuid MockInstallation::rootMeterId() const
+{
+    for (int index : m_energyThings) {
+        if (m_thingClasses.at(m_things.at(index).thingClass).interfaces.contains("energymeter")) {
+            return m_things.at(index).id;
+        }
+    }
+    return QUuid();
+}
+
+QVariantMap MockInstallation::powerBalance(qint64 timestamp) const
+{
+    // A daily load curve and some PV around noon
+    double dayPhase = 2 * M_PI * (timestamp % 86400) / 86400.0;
+    double consumption = 800 + 400 * qSin(dayPhase - M_PI / 2);
+    double production = qMax(0.0, -3000 * qCos(dayPhase));
+    double storage = qBound(-1000.0, (production - consumption) / 2, 1000.0);
+    double acquisition = consumption - production + storage;
+    double hours = (timestamp - totalsEpoch) / 3600.0;
+    return QVariantMap{
+        {"timestamp", timestamp},
+        {"consumption", consumption},
+        {"production", production},
+        {"acquisition", acquisition},
+        {"storage", storage},
+        {"totalConsumption", hours * 0.8},
+        {"totalProduction", hours * 0.95},
+        {"totalAcquisition", hours * 0.4},
+        {"totalReturn", hours * 0.55}
+    };
+}
+
+QVariantMap MockInstallation::powerBalanceLogs(const QVariantMap &params) const
+{
+    QVariantList entries;
+    foreach (qint64 timestamp, sampleTimestamps(params, sampleRate(params))) {
+        entries.append(powerBalance(timestamp));
+    }
+    return QVariantMap{
+        {"energyError", "EnergyErrorNoError"},
+        {"powerBalanceLogEntries", entries}
+    };
+}
+
+QVariantMap MockInstallation::thingPowerLogs(const QVariantMap &params) const
+{
+    QList<int> thingIndexes;
+    foreach (const QVariant &thingId, params.value("thingIds").toList()) {
+        int index = thingIndex(thingId.toUuid());
+        if (index >= 0) {
+            thingIndexes.append(index);
+        }
+    }
+    if (thingIndexes.isEmpty()) {
+        thingIndexes = m_energyThings.toList();
+    }
+
+    QVariantList entries;
+    foreach (qint64 timestamp, sampleTimestamps(params, sampleRate(params))) {
+        foreach (int index, thingIndexes) {
+            entries.append(powerSample(m_things.at(index).id, timestamp));
+        }
+    }
+    QVariantMap ret{
+        {"energyError", "EnergyErrorNoError"},
+        {"thingPowerLogEntries", entries}
+    };
+    if (params.value("includeCurrent").toBool()) {
+        QVariantList currentEntries;
+        qint64 now = QDateTime::currentSecsSinceEpoch();
+        foreach (int index, thingIndexes) {
+            currentEntries.append(powerSample(m_things.at(index).id, now));
+        }
+        ret.insert("currentEntries", currentEntries);
+    }
+    return ret;
+}
+
+QVariantMap MockInstallation::setState(const QUuid &thingId, const QUuid &stateTypeId, const QVariant &value)
+{
+    int index = thingIndex(thingId);
+    if (index < 0) {
+        return QVariantMap();
+    }
+    Thing &thing = m_things[index];
+    const ThingClass &thingClass = m_thingClasses.at(thing.thingClass);
+    for (int i = 0; i < thingClass.stateTypes.count(); i++) {
+        if (thingClass.stateTypes.at(i).id == stateTypeId) {
+            thing.stateValues[i] = value;
+            LogEntry entry;
+            entry.timestamp = QDateTime::currentMSecsSinceEpoch();
+            entry.thing = index;
+            entry.stateType = i;
+            entry.value = value;
+            m_logEntries.append(entry);
+            return QVariantMap{
+                {"thingId", thing.id},
+                {"stateTypeId", stateTypeId},
+                {"value", value}
+            };
+        }
+    }
+    return QVariantMap();
+}
+
+QVariantMap MockInstallation::randomStateChange()
+{
+    if (m_things.isEmpty()) {
+        return QVariantMap();
+    }
+    const Thing &thing = m_things.at(m_random.bounded(m_things.count()));
+    const ThingClass &thingClass = m_thingClasses.at(thing.thingClass);
+    const StateType &stateType = thingClass.stateTypes.at(m_random.bounded(thingClass.stateTypes.count()));
+    return setState(thing.id, stateType.id, randomValue(stateType));
+}
+
+QVariantMap MockInstallation::lastLogEntry() const
+{
+    if (m_logEntries.isEmpty()) {
+        return QVariantMap();
+    }
+    return packLogEntry(m_logEntries.last());
+}
+
+bool MockInstallation::hasThing(const QUuid &thingId) const
+{
+    return m_thingIndex.contains(thingId);
+}
+
+QUuid MockInstallation::createUuid()
+{
+    QByteArray bytes(16, 0);
+    for (int i = 0; i < 16; i++) {
+        bytes[i] = static_cast<char>(m_random.bounded(256));
+    }
+    // Version 4, RFC 4122 variant
+    bytes[6] = static_cast<char>((bytes.at(6) & 0x0f) | 0x40);
+    bytes[8] = static_cast<char>((bytes.at(8) & 0x3f) | 0x80);
+    return QUuid::fromRfc4122(bytes);
+}
+
+QVariant MockInstallation::randomValue(const StateType &stateType)
+{
+    if (stateType.type == "Bool") {
+        return m_random.bounded(2) == 1;
+    }
+    if (stateType.type == "Int") {
+        return static_cast<int>(stateType.minValue) + m_random.bounded(static_cast<int>(stateType.maxValue - stateType.minValue) + 1);
+    }
+    return qRound((stateType.minValue + m_random.generateDouble() * (stateType.maxValue - stateType.minValue)) * 100) / 100.0;
+}
+
+QVariantMap MockInstallation::packStateType(const StateType &stateType, int index) const
+{
+    QString displayName = stateType.name.left(1).toUpper() + stateType.name.mid(1);
+    QVariantMap ret{
+        {"id", stateType.id},
+        {"name", stateType.name},
+        {"displayName", displayName},
+        {"index", index},
+        {"type", stateType.type},
+        {"unit", stateType.unit},
+        {"defaultValue", stateType.defaultValue},
+        {"ioType", "IOTypeNone"}
+    };
+    if (stateType.type != "Bool") {
+        ret.insert("minValue", stateType.minValue);
+        ret.insert("maxValue", stateType.maxValue);
+    }
+    return ret;
+}
+
+QVariantMap MockInstallation::packLogEntry(const LogEntry &entry) const
+{
+    return QVariantMap{
+        {"timestamp", entry.timestamp},
+        {"thingId", m_things.at(entry.thing).id},
+        {"typeId", m_thingClasses.at(m_things.at(entry.thing).thingClass).stateTypes.at(entry.stateType).id},
+        {"source", "LoggingSourceStates"},
+        {"eventType", "LoggingEventTypeTrigger"},
+        {"loggingLevel", "LoggingLevelInfo"},
+        {"value", entry.value}
+    };
+}
+
+QVariantMap MockInstallation::powerSample(const QUuid &thingId, qint64 timestamp) const
+{
+    // Each thing gets its own base load and phase, derived from its id
+    uint hash = qHash(thingId);
+    double base = 50 + hash % 1000;
+    double phase = (hash % 360) * M_PI / 180;
+    double currentPower = base * (1 + qSin(2 * M_PI * (timestamp % 86400) / 86400.0 + phase)) / 2;
+    double hours = (timestamp - totalsEpoch) / 3600.0;
+    return QVariantMap{
+        {"timestamp", timestamp},
+        {"thingId", thingId},
+        {"currentPower", currentPower},
+        {"totalConsumption", hours * base / 2000},
+        {"totalProduction", 0}
+    };
+}
+
+QVector<qint64> MockInstallation::sampleTimestamps(const QVariantMap &params, int sampleRate) const
+{
+    const int maxSamples = 10000;
+    qint64 step = static_cast<qint64>(sampleRate) * 60;
+    qint64 to = params.contains("to") ? params.value("to").toLongLong() : QDateTime::currentSecsSinceEpoch();
+    qint64 from = params.contains("from") ? params.value("from").toLongLong() : to - 100 * step;
+    from = qMax(from, to - maxSamples * step);
+    // Align to the sample rate like the core does for everything up to a day
+    if (step <= 86400) {
+        from = (from + step - 1) / step * step;
+    }
+
+    QVector<qint64> ret;
+    for (qint64 timestamp = from; timestamp <= to; timestamp += step) {
+        ret.append(timestamp);
+    }
+    return ret;
+}
+
+int MockInstallation::sampleRate(const QVariantMap &params) const
+{
+    static const QHash<QString, int> sampleRates = {
+        {"SampleRate1Min", 1},
+        {"SampleRate15Mins", 15},
+        {"SampleRate1Hour", 60},
+        {"SampleRate3Hours", 180},
+        {"SampleRate1Day", 1440},
+        {"SampleRate1Week", 10080},
+        {"SampleRate1Month", 43200},
+        {"SampleRate1Year", 525600}
+    };
+    return sampleRates.value(params.value("sampleRate").toString(), 15);
+}
+
+int MockInstallation::thingIndex(const QUuid &thingId) const
+{
+    return m_thingIndex.value(thingId, -1);
+}
@@ -0,0 +1,123 @@
+#ifndef MOCKINSTALLATION_H
+#define MOCKINSTALLATION_H
+
+#include <QUuid>
+#include <QVector>
+#include <QVariantMap>
+#include <QRandomGenerator>
+
+// A synthetic nymea:core setup. Everything is derived from the seed, so two
+// installations created with the same options hand out identical replies.
+class MockInstallation
+{
+public:
+    struct Options {
+        int thingClasses = 20;
+        int things = 100;
+        int extraStates = 5;
+        int rules = 20;
+        int tags = 50;
+        int logEntries = 10000;
+        int logDays = 7;
+        quint32 seed = 1;
+    };
+
+    explicit MockInstallation(const Options &options = Options());
+
+    Options options() const;
+
+    QVariantList vendors() const;
+    QVariantList plugins() const;
+    QVariantList thingClasses() const;
+    QVariantList things() const;
+    QVariantList ruleDescriptions() const;
+    QVariantMap ruleDetails(const QUuid &ruleId) const;
+    QVariantList tags() const;
+
+    QVariantMap logEntries(const QVariantMap &params) const;
+
+    QUuid rootMeterId() const;
+    QVariantMap powerBalance(qint64 timestamp) const;
+    QVariantMap powerBalanceLogs(const QVariantMap &params) const;
+    QVariantMap thingPowerLogs(const QVariantMap &params) const;
+
+    // Sets a state to a new value and returns the Integrations.StateChanged params
+    QVariantMap setState(const QUuid &thingId, const QUuid &stateTypeId, const QVariant &value);
+    // Picks a random state, changes it and records a log entry for it
+    QVariantMap randomStateChange();
+    QVariantMap lastLogEntry() const;
+
+    bool hasThing(const QUuid &thingId) const;
+
+private:
+    struct StateType {
+        QUuid id;
+        QString name;
+        QString type;
+        QString unit;
+        QVariant defaultValue;
+        double minValue = 0;
+        double maxValue = 0;
+        bool writable = false;
+    };
+    struct ThingClass {
+        QUuid id;
+        QUuid vendorId;
+        QUuid pluginId;
+        QUuid hostParamTypeId;
+        QString name;
+        QStringList interfaces;
+        QVector<StateType> stateTypes;
+    };
+    struct Thing {
+        QUuid id;
+        int thingClass = 0;
+        QString name;
+        QString host;
+        QVariantList stateValues;
+    };
+    struct Rule {
+        QUuid id;
+        QString name;
+        int thing = 0;
+        int stateType = 0;
+        bool enabled = true;
+        bool active = false;
+    };
+    struct Tag {
+        int thing = 0;
+        QString tagId;
+        QString value;
+    };
+    struct LogEntry {
+        qint64 timestamp = 0;
+        int thing = 0;
+        int stateType = 0;
+        QVariant value;
+    };
+
+    QUuid createUuid();
+    QVariant randomValue(const StateType &stateType);
+    QVariantMap packStateType(const StateType &stateType, int index) const;
+    QVariantMap packLogEntry(const LogEntry &entry) const;
+    QVariantMap powerSample(const QUuid &thingId, qint64 timestamp) const;
+    QVector<qint64> sampleTimestamps(const QVariantMap &params, int sampleRate) const;
+    int sampleRate(const QVariantMap &params) const;
+    int thingIndex(const QUuid &thingId) const;
+
+    Options m_options;
+    QRandomGenerator m_random;
+
+    QVector<QPair<QUuid, QString>> m_vendors;
+    QVector<QPair<QUuid, QString>> m_plugins;
+    QVector<ThingClass> m_thingClasses;
+    QVector<Thing> m_things;
+    QHash<QUuid, int> m_thingIndex;
+    QVector<Rule> m_rules;
+    QVector<Tag> m_tags;
+    // Sorted by timestamp, oldest first
+    QVector<LogEntry> m_logEntries;
+    QVector<int> m_energyThings;
+};
+
+#endif // MOCKINSTALLATION_H
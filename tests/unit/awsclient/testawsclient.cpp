@@ -0,0 +1,276 @@
+#include <QtTest/QTest>
+#include <QSignalSpy>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QJsonDocument>
+#include <QDateTime>
+#include <QSettings>
+#include <QTimer>
+#include <QPointer>
+
+#include "connection/awsclient.h"
+
+// Minimal stand-in for the AWS endpoints speaking HTTP/1.1 with keep-alive. Cognito
+// calls are told apart by their X-Amz-Target, everything else by the first path segment.
+class StandInAws: public QTcpServer
+{
+    Q_OBJECT
+public:
+    StandInAws(QObject *parent = nullptr): QTcpServer(parent)
+    {
+        connect(this, &QTcpServer::newConnection, this, [this](){
+            QTcpSocket *socket = nextPendingConnection();
+            connections++;
+            connect(socket, &QTcpSocket::readyRead, this, [this, socket](){
+                m_buffers[socket].append(socket->readAll());
+                processBuffer(socket);
+            });
+            connect(socket, &QTcpSocket::disconnected, this, [this, socket](){
+                m_buffers.remove(socket);
+                socket->deleteLater();
+            });
+        });
+    }
+
+    // Lifetime of the tokens handed out, in seconds
+    int expiresIn = 3600;
+    // How long the replies are held back, in ms
+    int credentialsDelay = 0;
+    int apiDelay = 0;
+
+    int connections = 0;
+    int inFlight = 0;
+    int maxInFlight = 0;
+    // "> name" when a request arrives, "< name" when its reply goes out
+    QStringList events;
+
+    int count(const QString &event) const { return events.count(event); }
+
+signals:
+    void requestReceived(const QString &name);
+
+private:
+    void processBuffer(QTcpSocket *socket)
+    {
+        QByteArray &buffer = m_buffers[socket];
+        while (true) {
+            int headerEnd = buffer.indexOf("\r\n\r\n");
+            if (headerEnd < 0) {
+                return;
+            }
+            QList<QByteArray> lines = buffer.left(headerEnd).split('\n');
+            QList<QByteArray> requestLine = lines.takeFirst().trimmed().split(' ');
+            QHash<QByteArray, QByteArray> headers;
+            foreach (const QByteArray &line, lines) {
+                int colon = line.indexOf(':');
+                headers.insert(line.left(colon).trimmed().toLower(), line.mid(colon + 1).trimmed());
+            }
+            int contentLength = headers.value("content-length").toInt();
+            if (buffer.length() < headerEnd + 4 + contentLength) {
+                return;
+            }
+            buffer.remove(0, headerEnd + 4 + contentLength);
+
+            QString name;
+            if (headers.contains("x-amz-target")) {
+                name = QString(headers.value("x-amz-target")).split('.').last();
+            } else {
+                name = requestLine.value(0) + " /" + QString(requestLine.value(1)).split('/', QString::SkipEmptyParts).value(0);
+            }
+            handleRequest(socket, name);
+        }
+    }
+
+    void handleRequest(QTcpSocket *socket, const QString &name)
+    {
+        events.append("> " + name);
+        inFlight++;
+        maxInFlight = qMax(maxInFlight, inFlight);
+        emit requestReceived(name);
+
+        QVariantMap reply;
+        int delay = apiDelay;
+        if (name == "InitiateAuth") {
+            QVariantMap payload;
+            payload.insert("cognito:username", "test-user-id");
+            QByteArray idToken = QByteArray("{}").toBase64() + "." + QJsonDocument::fromVariant(payload).toJson(QJsonDocument::Compact).toBase64() + ".signature";
+            QVariantMap authenticationResult;
+            authenticationResult.insert("AccessToken", "access-token");
+            authenticationResult.insert("ExpiresIn", expiresIn);
+            authenticationResult.insert("IdToken", idToken);
+            authenticationResult.insert("RefreshToken", "refresh-token");
+            reply.insert("AuthenticationResult", authenticationResult);
+            delay = 0;
+        } else if (name == "GetId") {
+            reply.insert("IdentityId", "eu-west-1:test-identity");
+            delay = 0;
+        } else if (name == "GetCredentialsForIdentity") {
+            QVariantMap credentials;
+            credentials.insert("AccessKeyId", "access-key-id");
+            credentials.insert("SecretKey", "secret-key");
+            credentials.insert("SessionToken", "session-token");
+            credentials.insert("Expiration", QDateTime::currentDateTime().addSecs(expiresIn).toSecsSinceEpoch());
+            reply.insert("Credentials", credentials);
+            delay = credentialsDelay;
+        } else if (name == "GET /users") {
+            QVariantMap device;
+            device.insert("deviceId", "test-core");
+            device.insert("name", "Test core");
+            device.insert("online", true);
+            reply.insert("devices", QVariantList() << device);
+        } else if (name == "POST /topics") {
+            reply.insert("message", "OK");
+        }
+
+        QByteArray body = QJsonDocument::fromVariant(reply).toJson(QJsonDocument::Compact);
+        QPointer<QTcpSocket> socketPointer(socket);
+        QTimer::singleShot(delay, this, [this, socketPointer, name, body](){
+            events.append("< " + name);
+            inFlight--;
+            if (socketPointer.isNull()) {
+                return;
+            }
+            QByteArray response = "HTTP/1.1 200 OK\r\n"
+                                  "Content-Type: application/json\r\n"
+                                  "Connection: keep-alive\r\n"
+                                  "Content-Length: " + QByteArray::number(body.length()) + "\r\n"
+                                  "\r\n" + body;
+            socketPointer->write(response);
+        });
+    }
+
+    QHash<QTcpSocket*, QByteArray> m_buffers;
+};
+
+class TestAWSClient: public QObject
+{
+    Q_OBJECT
+public:
+    TestAWSClient(QObject *parent = nullptr);
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void queuedCallsReleasedConcurrently();
+    void connectionReuse();
+    void proactiveRefresh();
+
+private:
+    StandInAws *m_server = nullptr;
+};
+
+TestAWSClient::TestAWSClient(QObject *parent): QObject(parent)
+{
+}
+
+void TestAWSClient::initTestCase()
+{
+    QCoreApplication::setOrganizationName("nymea-tests");
+    QCoreApplication::setApplicationName("testawsclient");
+
+    // A stored login whose tokens have run out. The client has to refresh them before anything goes out.
+    QSettings settings;
+    settings.clear();
+    settings.beginGroup("cloud");
+    settings.setValue("username", "test@example.com");
+    settings.setValue("userId", "test-user-id");
+    settings.setValue("password", "secret");
+    settings.setValue("accessTokenExpiry", QDateTime::currentDateTime().addSecs(-60));
+    settings.setValue("sessionTokenExpiry", QDateTime::currentDateTime().addSecs(-60));
+    settings.endGroup();
+
+    m_server = new StandInAws(this);
+    QVERIFY(m_server->listen(QHostAddress::LocalHost));
+
+    AWSClient::instance()->setEndpointOverride(QUrl(QString("http://127.0.0.1:%1").arg(m_server->serverPort())));
+    AWSClient::instance()->setConfig("Testing");
+    QVERIFY(AWSClient::instance()->isLoggedIn());
+    QVERIFY(AWSClient::instance()->tokensExpired());
+}
+
+void TestAWSClient::cleanupTestCase()
+{
+    QSettings settings;
+    settings.clear();
+}
+
+void TestAWSClient::queuedCallsReleasedConcurrently()
+{
+    AWSClient *client = AWSClient::instance();
+    m_server->credentialsDelay = 500;
+    m_server->apiDelay = 200;
+
+    QObject sender;
+    QList<bool> mqttResults;
+    QSignalSpy devicesSpy(client, &AWSClient::devicesFetched);
+
+    client->fetchDevices();
+    client->registerPushNotificationEndpoint("registration", "Test device", "test-device-id", "Test", "Model");
+    QVERIFY(client->postToMQTT("test-core", "1234", &sender, [&mqttResults](bool success){ mqttResults.append(success); }));
+
+    QTRY_COMPARE(devicesSpy.count(), 1);
+    QTRY_COMPARE(mqttResults, QList<bool>() << true);
+    QCOMPARE(m_server->count("> InitiateAuth"), 1);
+
+    // The API gateway only needs the ID token, those calls must not wait for the AWS credentials
+    int credentialsReplied = m_server->events.indexOf("< GetCredentialsForIdentity");
+    QVERIFY(credentialsReplied > 0);
+    QVERIFY(m_server->events.contains("> GET /users"));
+    QVERIFY(m_server->events.contains("> POST /notifications"));
+    QVERIFY(m_server->events.indexOf("> GET /users") < credentialsReplied);
+    QVERIFY(m_server->events.indexOf("> POST /notifications") < credentialsReplied);
+    // Posting to MQTT has to be signed with them though
+    QVERIFY(m_server->events.indexOf("> POST /topics") > credentialsReplied);
+
+    QVERIFY2(m_server->maxInFlight >= 2, qPrintable(QString("Only %1 requests in flight at once").arg(m_server->maxInFlight)));
+    QVERIFY(!client->tokensExpired());
+
+    m_server->credentialsDelay = 0;
+    m_server->apiDelay = 0;
+}
+
+void TestAWSClient::connectionReuse()
+{
+    AWSClient *client = AWSClient::instance();
+    QSignalSpy devicesSpy(client, &AWSClient::devicesFetched);
+
+    client->fetchDevices();
+    QTRY_COMPARE(devicesSpy.count(), 1);
+    int connections = m_server->connections;
+
+    for (int i = 2; i <= 3; i++) {
+        client->fetchDevices();
+        QTRY_COMPARE(devicesSpy.count(), i);
+    }
+    QCOMPARE(m_server->connections, connections);
+    QCOMPARE(client->awsDevices()->rowCount(), 1);
+}
+
+void TestAWSClient::proactiveRefresh()
+{
+    AWSClient *client = AWSClient::instance();
+    m_server->expiresIn = 20;
+    QSignalSpy loginSpy(client, &AWSClient::loginResult);
+
+    QVERIFY(client->login("test@example.com", "secret"));
+    QTRY_COMPARE(loginSpy.count(), 1);
+    int logins = m_server->count("> InitiateAuth");
+
+    // Nothing asks for the tokens, the client has to refresh them on its own before they run out
+    bool expiredOnRefresh = true;
+    connect(m_server, &StandInAws::requestReceived, this, [&expiredOnRefresh, client](const QString &name){
+        if (name == "InitiateAuth") {
+            expiredOnRefresh = client->tokensExpired();
+        }
+    });
+    QTRY_COMPARE_WITH_TIMEOUT(m_server->count("> InitiateAuth"), logins + 1, 15000);
+    QVERIFY(!expiredOnRefresh);
+    QTRY_COMPARE(loginSpy.count(), 2);
+    QVERIFY(!client->tokensExpired());
+
+    disconnect(m_server, &StandInAws::requestReceived, this, nullptr);
+}
+
+#include "testawsclient.moc"
+QTEST_MAIN(TestAWSClient)
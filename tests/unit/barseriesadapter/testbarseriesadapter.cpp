@@ -0,0 +1,75 @@
+#include <QtTest/QTest>
+#include <QBarSeries>
+#include <QBarSet>
+
+#include <time.h>
+
+#include "models/barseriesadapter.h"
+#include "models/logsmodel.h"
+#include "types/logentry.h"
+
+class TestBarSeriesAdapter: public QObject
+{
+    Q_OBJECT
+public:
+    TestBarSeriesAdapter(QObject *parent = nullptr);
+
+private slots:
+    void initTestCase();
+
+    void daysAcrossDstChange_data();
+    void daysAcrossDstChange();
+};
+
+TestBarSeriesAdapter::TestBarSeriesAdapter(QObject *parent): QObject(parent)
+{
+}
+
+void TestBarSeriesAdapter::initTestCase()
+{
+    // A zone with DST, so days around the changes are 23 and 25 hours long
+    qputenv("TZ", "Europe/Berlin");
+    tzset();
+}
+
+void TestBarSeriesAdapter::daysAcrossDstChange_data()
+{
+    QTest::addColumn<QDate>("firstDay");
+
+    QTest::newRow("spring forward") << QDate(2021, 3, 24);
+    QTest::newRow("fall back") << QDate(2021, 10, 27);
+}
+
+void TestBarSeriesAdapter::daysAcrossDstChange()
+{
+    QFETCH(QDate, firstDay);
+    const int days = 9;
+
+    LogsModel model;
+    model.setStartTime(QDateTime(firstDay, QTime(0, 0)));
+    model.setEndTime(QDateTime(firstDay.addDays(days - 1), QTime(23, 0)));
+    QVERIFY(model.startTime().offsetFromUtc() != model.endTime().offsetFromUtc());
+
+    QtCharts::QBarSeries series;
+    BarSeriesAdapter adapter;
+    adapter.setInterval(BarSeriesAdapter::IntervalDays);
+    adapter.setBarSeries(&series);
+    adapter.setLogsModel(&model);
+
+    // One entry shortly after midnight and one late in the evening of each day, both valued with the day number
+    for (int i = 0; i < days; i++) {
+        QDate day = firstDay.addDays(i);
+        emit model.logEntryAdded(new LogEntry(QDateTime(day, QTime(0, 30)), i + 1, QUuid(), QUuid(), LogEntry::LoggingSourceStates, LogEntry::LoggingEventTypeTrigger, QString(), &model));
+        emit model.logEntryAdded(new LogEntry(QDateTime(day, QTime(23, 30)), i + 1, QUuid(), QUuid(), LogEntry::LoggingSourceStates, LogEntry::LoggingEventTypeTrigger, QString(), &model));
+    }
+
+    QCOMPARE(series.count(), 1);
+    QtCharts::QBarSet *set = series.barSets().first();
+    QCOMPARE(set->count(), days);
+    for (int i = 0; i < days; i++) {
+        QCOMPARE(set->at(i), static_cast<qreal>(i + 1));
+    }
+}
+
+QTEST_MAIN(TestBarSeriesAdapter)
+#include "testbarseriesadapter.moc"
@@ -0,0 +1,10 @@
+TARGET = testjsonrpc
+
+include(../../../shared.pri)
+INCLUDEPATH += $$top_srcdir/libnymea-app
+LIBS += -L$$top_builddir/libnymea-app/ -lnymea-app -lssl -lcrypto
+
+QT += testlib network gui bluetooth websockets charts quick
+CONFIG += testcase
+
+SOURCES += testjsonrpc.cpp
@@ -0,0 +1,536 @@
+#include <QtTest/QTest>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QWebSocketServer>
+#include <QWebSocket>
+#include <QSignalSpy>
+#include <QElapsedTimer>
+#include <QJsonDocument>
+#include <QCborValue>
+#include <QCborStreamReader>
+#include <QSet>
+#include <QUuid>
+#include <QSettings>
+
+#include "jsonrpc/jsonrpcclient.h"
+#include "jsonrpc/jsonrpcstatistics.h"
+#include "connection/nymeahost.h"
+#include "connection/websockettransport.h"
+
+// Minimal stand-in for nymea:core speaking JSON-RPC over TCP. Replies to Hello
+// and echoes the params of any other call.
+class StandInServer: public QTcpServer
+{
+    Q_OBJECT
+public:
+    StandInServer(bool cborSupported, QObject *parent = nullptr): QTcpServer(parent), m_cborSupported(cborSupported)
+    {
+        connect(this, &QTcpServer::newConnection, this, [this](){
+            QTcpSocket *socket = nextPendingConnection();
+            m_sockets.append(socket);
+            connect(socket, &QTcpSocket::readyRead, this, [this, socket](){
+                m_buffers[socket].append(socket->readAll());
+                processBuffer(socket);
+            });
+        });
+    }
+
+    bool authenticationRequired = false;
+
+    int jsonRequests = 0;
+    int cborRequests = 0;
+    // Methods in the order they arrived, per encoding
+    QStringList jsonMethods;
+    QStringList cborMethods;
+
+    // Pushes raw data, e.g. notifications, to all clients
+    void broadcast(const QByteArray &data)
+    {
+        foreach (QTcpSocket *socket, m_sockets) {
+            socket->write(data);
+        }
+    }
+
+private:
+    void processBuffer(QTcpSocket *socket)
+    {
+        QByteArray &buffer = m_buffers[socket];
+        while (!buffer.isEmpty()) {
+            QVariantMap request;
+            if (buffer.startsWith('{')) {
+                int end = buffer.indexOf('\n');
+                if (end < 0) {
+                    return;
+                }
+                request = QJsonDocument::fromJson(buffer.left(end)).toVariant().toMap();
+                buffer.remove(0, end + 1);
+                jsonRequests++;
+                jsonMethods.append(request.value("method").toString());
+            } else {
+                QCborStreamReader reader(buffer);
+                QCborValue value = QCborValue::fromCbor(reader);
+                if (reader.lastError() != QCborError::NoError) {
+                    return;
+                }
+                buffer.remove(0, static_cast<int>(reader.currentOffset()));
+                request = value.toMap().toVariantMap();
+                cborRequests++;
+                cborMethods.append(request.value("method").toString());
+                // The client switched, so do we.
+                m_cborSockets.insert(socket);
+            }
+            handleRequest(socket, request);
+        }
+    }
+
+    void handleRequest(QTcpSocket *socket, const QVariantMap &request)
+    {
+        QVariantMap params;
+        if (request.value("method").toString() == "JSONRPC.Hello") {
+            params.insert("uuid", "{5f6d0f26-2a0e-4f4b-9c8e-5b7e3a0d1c11}");
+            params.insert("name", "stand-in");
+            params.insert("version", "0.0.0");
+            params.insert("protocol version", "5.5");
+            params.insert("initialSetupRequired", false);
+            params.insert("authenticationRequired", authenticationRequired);
+            params.insert("pushButtonAuthAvailable", false);
+            if (m_cborSupported && request.value("params").toMap().value("encodings").toStringList().contains("cbor")) {
+                params.insert("encoding", "cbor");
+            }
+        } else if (request.value("method").toString() == "JSONRPC.Authenticate") {
+            params.insert("success", true);
+            params.insert("token", "stand-in-token");
+            params.insert("username", request.value("params").toMap().value("username"));
+        } else {
+            params = request.value("params").toMap();
+        }
+
+        QVariantMap reply;
+        reply.insert("id", request.value("id"));
+        reply.insert("status", "success");
+        reply.insert("params", params);
+        if (m_cborSockets.contains(socket)) {
+            socket->write(QCborValue::fromVariant(reply).toCbor());
+        } else {
+            socket->write(QJsonDocument::fromVariant(reply).toJson(QJsonDocument::Compact) + "\n");
+        }
+    }
+
+    bool m_cborSupported = false;
+    QList<QTcpSocket*> m_sockets;
+    QHash<QTcpSocket*, QByteArray> m_buffers;
+    QSet<QTcpSocket*> m_cborSockets;
+};
+
+// Binary websocket frames start with a byte telling what follows: JSON, CBOR or qCompress()ed data
+static QByteArray encodeFrame(const QByteArray &payload, bool compress)
+{
+    if (compress) {
+        return '\x03' + qCompress(payload);
+    }
+    return (payload.startsWith('{') ? '\x01' : '\x02') + payload;
+}
+
+static QByteArray decodeFrame(const QByteArray &frame)
+{
+    if (frame.startsWith('\x03')) {
+        return qUncompress(frame.mid(1));
+    }
+    return frame.mid(1);
+}
+
+// Stand-in for nymea:core on a websocket. Takes text and binary frames, replies to Hello
+// and echoes the params of any other call. Replies go out as binary frames, large ones compressed.
+class StandInWebSocketServer: public QWebSocketServer
+{
+    Q_OBJECT
+public:
+    StandInWebSocketServer(QObject *parent = nullptr): QWebSocketServer("stand-in", QWebSocketServer::NonSecureMode, parent)
+    {
+        connect(this, &QWebSocketServer::newConnection, this, [this](){
+            QWebSocket *socket = nextPendingConnection();
+            connect(socket, &QWebSocket::textMessageReceived, this, [this, socket](const QString &message){
+                textFrames++;
+                handleRequest(socket, QJsonDocument::fromJson(message.toUtf8()).toVariant().toMap());
+            });
+            connect(socket, &QWebSocket::binaryMessageReceived, this, [this, socket](const QByteArray &message){
+                frameTypes.append(message.at(0));
+                QByteArray data = decodeFrame(message);
+                QVariantMap request;
+                if (data.startsWith('{')) {
+                    request = QJsonDocument::fromJson(data).toVariant().toMap();
+                } else {
+                    request = QCborValue::fromCbor(data).toMap().toVariantMap();
+                }
+                handleRequest(socket, request);
+            });
+        });
+    }
+
+    int textFrames = 0;
+    QList<char> frameTypes;
+
+private:
+    void handleRequest(QWebSocket *socket, const QVariantMap &request)
+    {
+        QVariantMap params;
+        if (request.value("method").toString() == "JSONRPC.Hello") {
+            params.insert("uuid", "{5f6d0f26-2a0e-4f4b-9c8e-5b7e3a0d1c11}");
+            params.insert("name", "stand-in");
+            params.insert("version", "0.0.0");
+            params.insert("protocol version", "5.5");
+            params.insert("initialSetupRequired", false);
+            params.insert("authenticationRequired", authenticationRequired);
+            params.insert("pushButtonAuthAvailable", false);
+        } else {
+            params = request.value("params").toMap();
+        }
+
+        QVariantMap reply;
+        reply.insert("id", request.value("id"));
+        reply.insert("status", "success");
+        reply.insert("params", params);
+        QByteArray data = QJsonDocument::fromVariant(reply).toJson(QJsonDocument::Compact);
+        socket->sendBinaryMessage(encodeFrame(data, data.size() > 4096));
+    }
+};
+
+class TestJsonRpc: public QObject
+{
+    Q_OBJECT
+public:
+    TestJsonRpc(QObject* parent = nullptr);
+
+    Q_INVOKABLE void echoReply(int commandId, const QVariantMap &params);
+    Q_INVOKABLE void notificationReceived(const QVariantMap &data);
+
+private slots:
+    void encodingNegotiation_data();
+    void encodingNegotiation();
+
+    void authenticateWithCbor();
+
+    void webSocketFraming_data();
+    void webSocketFraming();
+
+    void webSocketRoundTrip();
+
+    void decodeBenchmark_data();
+    void decodeBenchmark();
+
+    void receivePathBenchmark_data();
+    void receivePathBenchmark();
+
+private:
+    QVariantMap m_echoParams;
+    int m_echoCount = 0;
+    int m_notificationCount = 0;
+};
+
+TestJsonRpc::TestJsonRpc(QObject *parent): QObject(parent)
+{
+}
+
+void TestJsonRpc::echoReply(int commandId, const QVariantMap &params)
+{
+    Q_UNUSED(commandId)
+    m_echoParams = params;
+    m_echoCount++;
+}
+
+void TestJsonRpc::notificationReceived(const QVariantMap &data)
+{
+    Q_UNUSED(data)
+    m_notificationCount++;
+}
+
+void TestJsonRpc::encodingNegotiation_data()
+{
+    QTest::addColumn<bool>("serverSupportsCbor");
+
+    QTest::newRow("cbor") << true;
+    QTest::newRow("json fallback") << false;
+}
+
+void TestJsonRpc::encodingNegotiation()
+{
+    QFETCH(bool, serverSupportsCbor);
+
+    StandInServer server(serverSupportsCbor);
+    QVERIFY(server.listen(QHostAddress::LocalHost));
+
+    NymeaHost host;
+    host.connections()->addConnection(new Connection(QUrl(QString("nymea://127.0.0.1:%1").arg(server.serverPort())), Connection::BearerTypeLoopback, false, "stand-in"));
+
+    JsonRpcClient client;
+    client.setHeartbeatInterval(0);
+    client.connectToHost(&host);
+    QTRY_VERIFY(client.connected());
+
+    QVariantMap params;
+    params.insert("int", 42);
+    params.insert("string", "grüße");
+    params.insert("list", QVariantList{1, 2.5, "three"});
+    params.insert("map", QVariantMap{{"nested", true}});
+
+    m_echoCount = 0;
+    client.sendCommand("Test.Echo", params, this, "echoReply");
+    QTRY_COMPARE(m_echoCount, 1);
+
+    // The callback contract is the same regardless of the encoding
+    QCOMPARE(m_echoParams.value("int").toInt(), 42);
+    QCOMPARE(m_echoParams.value("string").toString(), QString("grüße"));
+    QCOMPARE(m_echoParams.value("list").toList().count(), 3);
+    QCOMPARE(m_echoParams.value("list").toList().at(1).toDouble(), 2.5);
+    QCOMPARE(m_echoParams.value("list").toList().at(2).toString(), QString("three"));
+    QCOMPARE(m_echoParams.value("map").toMap().value("nested").toBool(), true);
+
+    // Each call ends up in the per method statistics
+    JsonRpcStatistics *statistics = client.statistics();
+    int echoRow = -1;
+    for (int i = 0; i < statistics->rowCount(); i++) {
+        if (statistics->data(statistics->index(i), JsonRpcStatistics::RoleName).toString() == "Test.Echo") {
+            echoRow = i;
+        }
+    }
+    QVERIFY(echoRow >= 0);
+    QModelIndex echoIndex = statistics->index(echoRow);
+    QCOMPARE(statistics->data(echoIndex, JsonRpcStatistics::RoleCount).toInt(), 1);
+    QVERIFY(statistics->data(echoIndex, JsonRpcStatistics::RoleP50).toLongLong() >= 0);
+    QVERIFY(statistics->data(echoIndex, JsonRpcStatistics::RoleRequestBytes).toLongLong() > 0);
+    QVERIFY(statistics->data(echoIndex, JsonRpcStatistics::RoleResponseBytes).toLongLong() > 0);
+
+    // Only the Hello goes as JSON when CBOR is agreed on
+    if (serverSupportsCbor) {
+        QCOMPARE(server.jsonRequests, 1);
+        QVERIFY(server.cborRequests >= 2);
+    } else {
+        QCOMPARE(server.cborRequests, 0);
+    }
+}
+
+void TestJsonRpc::authenticateWithCbor()
+{
+    StandInServer server(true);
+    server.authenticationRequired = true;
+    QVERIFY(server.listen(QHostAddress::LocalHost));
+
+    // No token stored from an earlier run
+    QSettings settings;
+    settings.beginGroup("jsonTokens");
+    settings.remove("{5f6d0f26-2a0e-4f4b-9c8e-5b7e3a0d1c11}");
+    settings.endGroup();
+
+    NymeaHost host;
+    host.connections()->addConnection(new Connection(QUrl(QString("nymea://127.0.0.1:%1").arg(server.serverPort())), Connection::BearerTypeLoopback, false, "stand-in"));
+
+    JsonRpcClient client;
+    client.setHeartbeatInterval(0);
+    client.connectToHost(&host);
+    QTRY_VERIFY(client.authenticationRequired());
+
+    client.authenticate("user", "secret", "testjsonrpc");
+    QTRY_VERIFY(client.authenticated());
+
+    // Authentication runs right after CBOR has been agreed on and must use it
+    QCOMPARE(server.jsonMethods, QStringList{"JSONRPC.Hello"});
+    QCOMPARE(server.cborMethods.value(0), QString("JSONRPC.Authenticate"));
+
+    settings.beginGroup("jsonTokens");
+    settings.remove("{5f6d0f26-2a0e-4f4b-9c8e-5b7e3a0d1c11}");
+    settings.endGroup();
+}
+
+void TestJsonRpc::webSocketFraming_data()
+{
+    QTest::addColumn<QByteArray>("payload");
+    QTest::addColumn<char>("frameType");
+
+    QVariantMap small{{"id", 1}, {"status", "success"}, {"params", QVariantMap{{"value", 21.5}}}};
+    QVariantMap large{{"id", 2}, {"status", "success"}, {"params", QVariantMap{{"value", QString(8000, 'x')}}}};
+
+    QTest::newRow("json") << QJsonDocument::fromVariant(small).toJson(QJsonDocument::Compact) << '\x01';
+    QTest::newRow("cbor") << QCborValue::fromVariant(small).toCbor() << '\x02';
+    QTest::newRow("compressed json") << QJsonDocument::fromVariant(large).toJson(QJsonDocument::Compact) << '\x03';
+    QTest::newRow("compressed cbor") << QCborValue::fromVariant(large).toCbor() << '\x03';
+}
+
+void TestJsonRpc::webSocketFraming()
+{
+    QFETCH(QByteArray, payload);
+    QFETCH(char, frameType);
+
+    QWebSocketServer server("stand-in", QWebSocketServer::NonSecureMode);
+    QVERIFY(server.listen(QHostAddress::LocalHost));
+    QList<QByteArray> received;
+    connect(&server, &QWebSocketServer::newConnection, this, [&server, &received, payload, frameType](){
+        QWebSocket *socket = server.nextPendingConnection();
+        connect(socket, &QWebSocket::binaryMessageReceived, socket, [&received](const QByteArray &message){
+            received.append(message);
+        });
+        // A binary frame from the server puts the transport into binary mode
+        socket->sendBinaryMessage(encodeFrame(payload, frameType == '\x03'));
+    });
+
+    WebsocketTransport transport;
+    QSignalSpy dataSpy(&transport, &WebsocketTransport::dataReady);
+    transport.connect(QUrl(QString("ws://127.0.0.1:%1").arg(server.serverPort())));
+    QTRY_COMPARE(dataSpy.count(), 1);
+    QCOMPARE(dataSpy.first().first().toByteArray(), payload);
+    QVERIFY(transport.isBinarySafe());
+
+    transport.sendData(payload);
+    QTRY_COMPARE(received.count(), 1);
+    QCOMPARE(received.first().at(0), frameType);
+    QCOMPARE(decodeFrame(received.first()), payload);
+
+    transport.disconnect();
+}
+
+void TestJsonRpc::webSocketRoundTrip()
+{
+    StandInWebSocketServer server;
+    QVERIFY(server.listen(QHostAddress::LocalHost));
+
+    NymeaHost host;
+    host.connections()->addConnection(new Connection(QUrl(QString("ws://127.0.0.1:%1").arg(server.serverPort())), Connection::BearerTypeLoopback, false, "stand-in"));
+
+    JsonRpcClient client;
+    client.setHeartbeatInterval(0);
+    client.connectToHost(&host);
+    QTRY_VERIFY(client.connected());
+
+    // Small enough to go as is and large enough to be compressed, in both directions
+    foreach (int size, QList<int>{16, 8000}) {
+        QVariantMap params;
+        params.insert("string", QString(size, 'x'));
+        params.insert("list", QVariantList{1, 2.5, "three"});
+
+        m_echoCount = 0;
+        client.sendCommand("Test.Echo", params, this, "echoReply");
+        QTRY_COMPARE(m_echoCount, 1);
+        QCOMPARE(m_echoParams.value("string").toString(), QString(size, 'x'));
+        QCOMPARE(m_echoParams.value("list").toList().at(1).toDouble(), 2.5);
+    }
+
+    // The Hello goes out before the server switched to binary frames, everything after it follows the server
+    QCOMPARE(server.textFrames, 1);
+    QVERIFY(server.frameTypes.contains('\x01'));
+    QVERIFY(server.frameTypes.contains('\x03'));
+}
+
+static QVariantMap benchmarkPayload()
+{
+    // Roughly shaped like a GetThingClasses reply
+    QVariantList thingClasses;
+    for (int i = 0; i < 200; i++) {
+        QVariantList stateTypes;
+        for (int j = 0; j < 10; j++) {
+            stateTypes.append(QVariantMap{
+                {"id", QUuid::createUuid().toString()},
+                {"name", QString("state%1").arg(j)},
+                {"displayName", QString("State number %1").arg(j)},
+                {"type", "Double"},
+                {"defaultValue", 0},
+                {"minValue", -100.5},
+                {"maxValue", 100.5},
+                {"index", j}
+            });
+        }
+        thingClasses.append(QVariantMap{
+            {"id", QUuid::createUuid().toString()},
+            {"name", QString("thingClass%1").arg(i)},
+            {"displayName", QString("Thing class number %1").arg(i)},
+            {"interfaces", QStringList{"power", "connectable", "smartmeter"}},
+            {"stateTypes", stateTypes}
+        });
+    }
+    return QVariantMap{{"id", 1}, {"status", "success"}, {"params", QVariantMap{{"thingClasses", thingClasses}}}};
+}
+
+void TestJsonRpc::decodeBenchmark_data()
+{
+    QTest::addColumn<bool>("cbor");
+    QTest::addColumn<QByteArray>("data");
+
+    QVariantMap payload = benchmarkPayload();
+    QByteArray json = QJsonDocument::fromVariant(payload).toJson(QJsonDocument::Compact) + "\n";
+    QByteArray cbor = QCborValue::fromVariant(payload).toCbor();
+    qInfo() << "Bytes on the wire: JSON:" << json.size() << "CBOR:" << cbor.size();
+
+    QTest::newRow("json") << false << json;
+    QTest::newRow("cbor") << true << cbor;
+}
+
+void TestJsonRpc::decodeBenchmark()
+{
+    QFETCH(bool, cbor);
+    QFETCH(QByteArray, data);
+
+    QVariantMap result;
+    if (cbor) {
+        QBENCHMARK {
+            QCborStreamReader reader(data);
+            result = QCborValue::fromCbor(reader).toMap().toVariantMap();
+        }
+    } else {
+        QBENCHMARK {
+            result = QJsonDocument::fromJson(data).toVariant().toMap();
+        }
+    }
+    QCOMPARE(result.value("params").toMap().value("thingClasses").toList().count(), 200);
+}
+
+void TestJsonRpc::receivePathBenchmark_data()
+{
+    QTest::addColumn<bool>("singleWrite");
+
+    QTest::newRow("one write per notification") << false;
+    QTest::newRow("whole burst in one write") << true;
+}
+
+void TestJsonRpc::receivePathBenchmark()
+{
+    QFETCH(bool, singleWrite);
+
+    StandInServer server(false);
+    QVERIFY(server.listen(QHostAddress::LocalHost));
+
+    NymeaHost host;
+    host.connections()->addConnection(new Connection(QUrl(QString("nymea://127.0.0.1:%1").arg(server.serverPort())), Connection::BearerTypeLoopback, false, "stand-in"));
+
+    // TcpSocketTransport -> NymeaConnection -> JsonRpcClient, all sharing the client's receive buffer
+    JsonRpcClient client;
+    client.setHeartbeatInterval(0);
+    client.registerNotificationHandler(this, "Integrations", "notificationReceived");
+    client.connectToHost(&host);
+    QTRY_VERIFY(client.connected());
+
+    // A burst of small state change notifications
+    const int notificationCount = 1000;
+    QByteArray notification = QJsonDocument::fromVariant(QVariantMap{
+        {"notification", "Integrations.StateChanged"},
+        {"params", QVariantMap{{"thingId", QUuid::createUuid().toString()}, {"stateTypeId", QUuid::createUuid().toString()}, {"value", 21.5}}}
+    }).toJson(QJsonDocument::Compact) + "\n";
+    QByteArray burst = notification.repeated(notificationCount);
+
+    QBENCHMARK {
+        m_notificationCount = 0;
+        if (singleWrite) {
+            server.broadcast(burst);
+        } else {
+            for (int i = 0; i < notificationCount; i++) {
+                server.broadcast(notification);
+            }
+        }
+        QElapsedTimer timeout;
+        timeout.start();
+        while (m_notificationCount < notificationCount && timeout.elapsed() < 10000) {
+            QCoreApplication::processEvents();
+        }
+    }
+    QCOMPARE(m_notificationCount, notificationCount);
+}
+
+QTEST_MAIN(TestJsonRpc)
+#include "testjsonrpc.moc"
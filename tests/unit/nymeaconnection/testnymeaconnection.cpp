@@ -0,0 +1,214 @@
+#include <QtTest/QTest>
+#include <QSignalSpy>
+#include <QTcpServer>
+#include <QTcpSocket>
+
+#include "connection/nymeaconnection.h"
+#include "connection/nymeahost.h"
+#include "connection/tcpsockettransport.h"
+
+class TestNymeaConnection: public QObject
+{
+    Q_OBJECT
+public:
+    TestNymeaConnection(QObject* parent = nullptr);
+
+private slots:
+    void latencyRanking();
+    void handshakeTimeMeasured();
+    void upgradeToFasterTransport();
+    void noDowngrade();
+    void noDowngradeToPlaintext();
+    void probeFindsLiveEndpoint();
+
+private:
+    QUrl serverUrl(QTcpServer *server) const;
+};
+
+TestNymeaConnection::TestNymeaConnection(QObject *parent): QObject(parent)
+{
+}
+
+QUrl TestNymeaConnection::serverUrl(QTcpServer *server) const
+{
+    return QUrl(QString("nymea://127.0.0.1:%1").arg(server->serverPort()));
+}
+
+void TestNymeaConnection::latencyRanking()
+{
+    Connections connections;
+    Connection *slow = new Connection(QUrl("nymea://10.0.0.1:2222"), Connection::BearerTypeLan, false, "slow");
+    Connection *fast = new Connection(QUrl("nymea://10.0.0.2:2222"), Connection::BearerTypeLan, false, "fast");
+    Connection *cloud = new Connection(QUrl("cloud://abc"), Connection::BearerTypeCloud, true, "cloud");
+    connections.addConnection(slow);
+    connections.addConnection(fast);
+    connections.addConnection(cloud);
+
+    slow->setHandshakeTime(400);
+    fast->setHandshakeTime(5);
+    QCOMPARE(connections.bestMatch(Connection::BearerTypeLan), fast);
+
+    // Ongoing RTT samples take precedence over the handshake time
+    fast->addRoundTripSample(600);
+    QCOMPARE(fast->roundTripTime(), 600);
+    QCOMPARE(connections.bestMatch(Connection::BearerTypeLan), slow);
+
+    // Latency never makes a slow LAN link rank below the cloud
+    slow->addRoundTripSample(5000);
+    cloud->setHandshakeTime(1);
+    QVERIFY(slow->priority() > cloud->priority());
+
+    // A plaintext endpoint never outranks an encrypted one on the same bearer, however much faster it is
+    Connection *plain = new Connection(QUrl("nymea://10.0.0.3:2222"), Connection::BearerTypeWan, false, "plain");
+    Connection *secure = new Connection(QUrl("nymeas://10.0.0.3:2223"), Connection::BearerTypeWan, true, "secure");
+    connections.addConnection(plain);
+    connections.addConnection(secure);
+    plain->setHandshakeTime(1);
+    secure->setHandshakeTime(5000);
+    QCOMPARE(connections.bestMatch(Connection::BearerTypeWan), secure);
+}
+
+void TestNymeaConnection::handshakeTimeMeasured()
+{
+    QTcpServer server;
+    QVERIFY(server.listen(QHostAddress::LocalHost));
+
+    NymeaHost host;
+    Connection *connection = new Connection(serverUrl(&server), Connection::BearerTypeLoopback, false, "loopback");
+    host.connections()->addConnection(connection);
+    QCOMPARE(connection->handshakeTime(), -1);
+
+    NymeaConnection nymeaConnection;
+    nymeaConnection.registerTransport(new TcpSocketTransportFactory());
+    nymeaConnection.connectToHost(&host);
+
+    QTRY_VERIFY(nymeaConnection.connected());
+    QCOMPARE(nymeaConnection.currentConnection(), connection);
+    QVERIFY(connection->handshakeTime() >= 0);
+}
+
+void TestNymeaConnection::upgradeToFasterTransport()
+{
+    // Stand-ins for the cloud relay and the local interface of the same box
+    QTcpServer relay;
+    QVERIFY(relay.listen(QHostAddress::LocalHost));
+    QTcpServer local;
+    QVERIFY(local.listen(QHostAddress::LocalHost));
+
+    NymeaHost host;
+    Connection *relayConnection = new Connection(serverUrl(&relay), Connection::BearerTypeCloud, false, "relay");
+    host.connections()->addConnection(relayConnection);
+
+    NymeaConnection nymeaConnection;
+    nymeaConnection.registerTransport(new TcpSocketTransportFactory());
+    QSignalSpy upgradeSpy(&nymeaConnection, &NymeaConnection::transportUpgradeAvailable);
+    QSignalSpy connectedSpy(&nymeaConnection, &NymeaConnection::connectedChanged);
+    nymeaConnection.connectToHost(&host);
+
+    QTRY_VERIFY(nymeaConnection.connected());
+    QCOMPARE(nymeaConnection.currentConnection(), relayConnection);
+    QTRY_VERIFY(relay.hasPendingConnections());
+    QTcpSocket *relaySocket = relay.nextPendingConnection();
+
+    // The local path shows up, e.g. when the phone joins the home Wi-Fi
+    Connection *localConnection = new Connection(serverUrl(&local), Connection::BearerTypeLoopback, false, "local");
+    host.connections()->addConnection(localConnection);
+
+    QTRY_COMPARE(upgradeSpy.count(), 1);
+    QVERIFY(nymeaConnection.upgradeAvailable());
+    QVERIFY(localConnection->handshakeTime() >= 0);
+    // Nothing changes until the session layer decides to move over
+    QCOMPARE(nymeaConnection.currentConnection(), relayConnection);
+
+    QVERIFY(nymeaConnection.upgradeTransport());
+    QCOMPARE(nymeaConnection.currentConnection(), localConnection);
+    QVERIFY(nymeaConnection.connected());
+    QVERIFY(!nymeaConnection.upgradeAvailable());
+
+    // The session stays up the whole time and the relay link gets closed
+    QCOMPARE(connectedSpy.count(), 1);
+    QTRY_COMPARE(relaySocket->state(), QAbstractSocket::UnconnectedState);
+}
+
+void TestNymeaConnection::noDowngrade()
+{
+    QTcpServer local;
+    QVERIFY(local.listen(QHostAddress::LocalHost));
+    QTcpServer relay;
+    QVERIFY(relay.listen(QHostAddress::LocalHost));
+
+    NymeaHost host;
+    Connection *localConnection = new Connection(serverUrl(&local), Connection::BearerTypeLoopback, false, "local");
+    host.connections()->addConnection(localConnection);
+
+    NymeaConnection nymeaConnection;
+    nymeaConnection.registerTransport(new TcpSocketTransportFactory());
+    QSignalSpy upgradeSpy(&nymeaConnection, &NymeaConnection::transportUpgradeAvailable);
+    nymeaConnection.connectToHost(&host);
+    QTRY_VERIFY(nymeaConnection.connected());
+
+    host.connections()->addConnection(new Connection(serverUrl(&relay), Connection::BearerTypeCloud, false, "relay"));
+
+    QTest::qWait(200);
+    QVERIFY(!relay.hasPendingConnections());
+    QCOMPARE(upgradeSpy.count(), 0);
+    QCOMPARE(nymeaConnection.currentConnection(), localConnection);
+}
+
+void TestNymeaConnection::noDowngradeToPlaintext()
+{
+    // Both stand-ins speak plain TCP. Only the secure flag of the relay connection tells them
+    // apart, which is all the upgrade decision looks at.
+    QTcpServer relay;
+    QVERIFY(relay.listen(QHostAddress::LocalHost));
+    QTcpServer local;
+    QVERIFY(local.listen(QHostAddress::LocalHost));
+
+    NymeaHost host;
+    Connection *relayConnection = new Connection(serverUrl(&relay), Connection::BearerTypeCloud, true, "relay");
+    host.connections()->addConnection(relayConnection);
+
+    NymeaConnection nymeaConnection;
+    nymeaConnection.registerTransport(new TcpSocketTransportFactory());
+    QSignalSpy upgradeSpy(&nymeaConnection, &NymeaConnection::transportUpgradeAvailable);
+    nymeaConnection.connectToHost(&host);
+    QTRY_VERIFY(nymeaConnection.connected());
+
+    // A faster path, but unencrypted
+    host.connections()->addConnection(new Connection(serverUrl(&local), Connection::BearerTypeLoopback, false, "local"));
+
+    QTest::qWait(200);
+    QVERIFY(!local.hasPendingConnections());
+    QCOMPARE(upgradeSpy.count(), 0);
+    QCOMPARE(nymeaConnection.currentConnection(), relayConnection);
+}
+
+void TestNymeaConnection::probeFindsLiveEndpoint()
+{
+    // A cached address the box doesn't use anymore, and the one it has now
+    QTcpServer live;
+    QVERIFY(live.listen(QHostAddress::LocalHost));
+    QTcpServer stale;
+    QVERIFY(stale.listen(QHostAddress::LocalHost));
+    QUrl staleUrl = serverUrl(&stale);
+    stale.close();
+
+    NymeaHost host;
+    Connection *staleConnection = new Connection(staleUrl, Connection::BearerTypeLoopback, false, "stale");
+    Connection *liveConnection = new Connection(serverUrl(&live), Connection::BearerTypeLoopback, false, "live");
+    host.connections()->addConnection(staleConnection);
+    host.connections()->addConnection(liveConnection);
+    QCOMPARE(host.connections()->bestMatch(Connection::BearerTypeLoopback), staleConnection);
+
+    NymeaConnection nymeaConnection;
+    nymeaConnection.registerTransport(new TcpSocketTransportFactory());
+    nymeaConnection.connectToHost(&host);
+
+    QTRY_VERIFY(nymeaConnection.connected());
+    QCOMPARE(nymeaConnection.currentConnection(), liveConnection);
+    QVERIFY(liveConnection->online());
+    QVERIFY(!staleConnection->online());
+}
+
+QTEST_MAIN(TestNymeaConnection)
+#include "testnymeaconnection.moc"
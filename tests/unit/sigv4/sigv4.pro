@@ -1,10 +1,10 @@
 TARGET = testsigv4
 
-include(../../../config.pri)
-INCLUDEPATH += $$top_srcdir/libnymea-app-core
-LIBS += -L$$top_builddir/libnymea-app-core/ -lnymea-app-core
+include(../../../shared.pri)
+INCLUDEPATH += $$top_srcdir/libnymea-app
+LIBS += -L$$top_builddir/libnymea-app/ -lnymea-app -lssl -lcrypto
 
-QT += testlib network sql
+QT += testlib network gui bluetooth websockets charts quick
 CONFIG += testcase
 
 DEFINES += TESTDATADIR=\\\"$${PWD}\/aws-sig-v4-test-suite\\\"
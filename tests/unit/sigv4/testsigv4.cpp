@@ -1,4 +1,5 @@
 #include <QtTest/QTest>
+#include <QMessageAuthenticationCode>
 
 #include "connection/sigv4utils.h"
 
@@ -12,6 +13,11 @@ private slots:
     void canonicalRequest_data();
     void canonicalRequest();
 
+    void signatureKeyCache();
+
+    void benchmarkSignRequest_data();
+    void benchmarkSignRequest();
+
 private:
     QString m_region = "us-east-1";
     QString m_service = "service";
@@ -145,6 +151,66 @@ void TestSigV4::canonicalRequest()
 
 }
 
+void TestSigV4::signatureKeyCache()
+{
+    SigV4Utils::clearSignatureKeyCache();
+
+    QCryptographicHash::Algorithm sha256 = QCryptographicHash::Sha256;
+    QByteArray expectedKey = QMessageAuthenticationCode::hash("aws4_request",
+                             QMessageAuthenticationCode::hash(m_service.toUtf8(),
+                             QMessageAuthenticationCode::hash(m_region.toUtf8(),
+                             QMessageAuthenticationCode::hash("20150830", "AWS4" + m_secretAccessKey, sha256), sha256), sha256), sha256);
+
+    QCOMPARE(SigV4Utils::getSignatureKey(m_secretAccessKey, "20150830", m_region.toUtf8(), m_service.toUtf8()), expectedKey);
+    // Served from the cache
+    QCOMPARE(SigV4Utils::getSignatureKey(m_secretAccessKey, "20150830", m_region.toUtf8(), m_service.toUtf8()), expectedKey);
+
+    // Anything else in the scope needs a different key
+    QVERIFY(SigV4Utils::getSignatureKey("otherSecret", "20150830", m_region.toUtf8(), m_service.toUtf8()) != expectedKey);
+    QVERIFY(SigV4Utils::getSignatureKey(m_secretAccessKey, "20150830", "eu-west-1", m_service.toUtf8()) != expectedKey);
+    QVERIFY(SigV4Utils::getSignatureKey(m_secretAccessKey, "20150830", m_region.toUtf8(), "iotdata") != expectedKey);
+
+    // The next day
+    QByteArray nextDayKey = QMessageAuthenticationCode::hash("aws4_request",
+                            QMessageAuthenticationCode::hash(m_service.toUtf8(),
+                            QMessageAuthenticationCode::hash(m_region.toUtf8(),
+                            QMessageAuthenticationCode::hash("20150831", "AWS4" + m_secretAccessKey, sha256), sha256), sha256), sha256);
+    QCOMPARE(SigV4Utils::getSignatureKey(m_secretAccessKey, "20150831", m_region.toUtf8(), m_service.toUtf8()), nextDayKey);
+
+    // Requests still dated the previous day keep working
+    QCOMPARE(SigV4Utils::getSignatureKey(m_secretAccessKey, "20150830", m_region.toUtf8(), m_service.toUtf8()), expectedKey);
+}
+
+void TestSigV4::benchmarkSignRequest_data()
+{
+    QTest::addColumn<bool>("cached");
+
+    QTest::newRow("uncached key") << false;
+    QTest::newRow("cached key") << true;
+}
+
+void TestSigV4::benchmarkSignRequest()
+{
+    QFETCH(bool, cached);
+
+    // Shaped like the requests AWSClient posts to the MQTT endpoint
+    QNetworkRequest request(QUrl("https://a2addxakg5juii.iot.eu-west-1.amazonaws.com/topics/2e9fce36-7dd3-4fb4-8297-2c5dbb1d5c4e%2Feu-west-1%3A8f6eb2c0-5ab4-4c1a-8a4f-6e2f1cbbf1d9%2Fproxy?qos=1"));
+    request.setRawHeader("content-type", "application/json");
+    request.setRawHeader("host", "a2addxakg5juii.iot.eu-west-1.amazonaws.com");
+    request.setRawHeader("X-Amz-Date", "20150830T123600Z");
+    QByteArray sessionToken = QByteArray("AQoDYXdzEPT//////////wEXAMPLEtc764bNrC9SAPBSM22wDOk4x4HIZ8j4FZTwdQWLWsKWHGBuFqwAeMicRXmxfpSPfIeoIYRqTflfKD8YUuwthAx7mSEI").repeated(4);
+    QByteArray payload = "{\"nonce\":\"1598789760\",\"timestamp\":\"1598789760\",\"token\":\"eyJraWQiOiJ...\"}";
+
+    SigV4Utils::clearSignatureKeyCache();
+    QBENCHMARK {
+        if (!cached) {
+            SigV4Utils::clearSignatureKeyCache();
+        }
+        QNetworkRequest signedRequest = request;
+        SigV4Utils::signRequest(QNetworkAccessManager::PostOperation, signedRequest, "eu-west-1", "iotdata", m_accessKeyId, m_secretAccessKey, sessionToken, payload);
+    }
+}
+
 #include "testsigv4.moc"
 QTEST_MAIN(TestSigV4)
 
@@ -0,0 +1,86 @@
+#include <QtTest/QTest>
+#include <QUuid>
+
+#include "energy/thingpowerlogs.h"
+
+class TestThingPowerLogs: public QObject
+{
+    Q_OBJECT
+public:
+    TestThingPowerLogs(QObject *parent = nullptr);
+
+private slots:
+    void staggeredNotifications();
+
+private:
+    void notify(ThingPowerLogs *logs, const QUuid &thingId, const QDateTime &timestamp);
+};
+
+TestThingPowerLogs::TestThingPowerLogs(QObject *parent): QObject(parent)
+{
+}
+
+void TestThingPowerLogs::notify(ThingPowerLogs *logs, const QUuid &thingId, const QDateTime &timestamp)
+{
+    QVariantMap entry;
+    entry.insert("timestamp", timestamp.toSecsSinceEpoch());
+    entry.insert("thingId", thingId);
+    entry.insert("currentPower", 100);
+    entry.insert("totalConsumption", 1);
+    entry.insert("totalProduction", 0);
+    QVariantMap params;
+    params.insert("sampleRate", "SampleRate15Mins");
+    params.insert("thingPowerLogEntry", entry);
+    QVariantMap data;
+    data.insert("notification", "Energy.ThingPowerLogEntryAdded");
+    data.insert("params", params);
+    // Same entry point JsonRpcClient calls for Energy notifications
+    QMetaObject::invokeMethod(logs, "notificationReceivedInternal", Qt::DirectConnection, Q_ARG(QVariantMap, data));
+}
+
+void TestThingPowerLogs::staggeredNotifications()
+{
+    ThingPowerLogs logs;
+    QList<QUuid> thingIds{QUuid::createUuid(), QUuid::createUuid(), QUuid::createUuid()};
+
+    QList<QPair<QDateTime, int>> batches;
+    connect(&logs, &EnergyLogs::entriesAdded, this, [&batches](const QList<EnergyLogEntry*> &entries){
+        batches.append(qMakePair(entries.first()->timestamp(), entries.count()));
+    });
+
+    QDateTime timestamp = QDateTime::fromSecsSinceEpoch(QDateTime::currentSecsSinceEpoch() / 900 * 900);
+
+    // A run of batches arriving all at once shrinks the window to its minimum
+    for (int i = 0; i < 20; i++) {
+        timestamp = timestamp.addSecs(900);
+        foreach (const QUuid &thingId, thingIds) {
+            notify(&logs, thingId, timestamp);
+        }
+    }
+
+    // Now they trickle in, further apart than that window
+    QList<QDateTime> staggeredTimestamps;
+    for (int i = 0; i < 5; i++) {
+        timestamp = timestamp.addSecs(900);
+        staggeredTimestamps.append(timestamp);
+        foreach (const QUuid &thingId, thingIds) {
+            notify(&logs, thingId, timestamp);
+            QTest::qWait(150);
+        }
+    }
+    QTRY_COMPARE(logs.rowCount(), 25 * thingIds.count());
+
+    // After the first split the window grows again, later timestamps arrive as one batch each
+    foreach (const QDateTime &staggered, staggeredTimestamps.mid(2)) {
+        QList<int> sizes;
+        foreach (const auto &batch, batches) {
+            if (batch.first == staggered) {
+                sizes.append(batch.second);
+            }
+        }
+        QCOMPARE(sizes, QList<int>{thingIds.count()});
+    }
+}
+
+QTEST_MAIN(TestThingPowerLogs)
+#include "testthingpowerlogs.moc"
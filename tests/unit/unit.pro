@@ -1,4 +1,4 @@
 TEMPLATE = subdirs
 
-SUBDIRS += sigv4
+SUBDIRS += sigv4 nymeaconnection jsonrpc awsclient barseriesadapter thingpowerlogs
 